@@ -0,0 +1,125 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Atomic read-modify-write on 32-bit words with LDREX/STREX. These imply
+// no ordering of other accesses: add barriers (dmb) where needed.
+
+#ifdef HOST
+// Host build: compiler builtins, with the same (relaxed) ordering
+
+static inline void dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void dsb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void wfe(void)
+{
+}
+
+static inline void sev(void)
+{
+}
+
+static inline uint32_t atomic_fetch_add(volatile uint32_t *addr, uint32_t val)
+{
+    return __atomic_fetch_add(addr, val, __ATOMIC_RELAXED);
+}
+
+static inline bool atomic_cas(volatile uint32_t *addr, uint32_t old, uint32_t new)
+{
+    return __atomic_compare_exchange_n(addr, &old, new, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomic_xchg(volatile uint32_t *addr, uint32_t val)
+{
+    return __atomic_exchange_n(addr, val, __ATOMIC_RELAXED);
+}
+
+#else // !HOST
+
+static inline void dmb(void)
+{
+    __asm__ __volatile__("dmb" : : : "memory");
+}
+
+static inline void dsb(void)
+{
+    __asm__ __volatile__("dsb" : : : "memory");
+}
+
+static inline void wfe(void)
+{
+    __asm__ __volatile__("wfe" : : : "memory");
+}
+
+static inline void sev(void)
+{
+    __asm__ __volatile__("sev" : : : "memory");
+}
+
+// Each operation is one asm block, the LDREX-STREX retry loop inside it:
+// no compiler-generated accesses (e.g. stack spills at -O0) between the
+// LDREX and the STREX, which could clear the exclusive monitor every time.
+
+// Returns the value before the addition
+static inline uint32_t atomic_fetch_add(volatile uint32_t *addr, uint32_t val)
+{
+    uint32_t old, new, fail;
+
+    __asm__ __volatile__("1: ldrex   %0, [%3]\n"
+                         "   add     %1, %0, %4\n"
+                         "   strex   %2, %1, [%3]\n"
+                         "   cmp     %2, #0\n"
+                         "   bne     1b\n"
+                         : "=&r" (old), "=&r" (new), "=&r" (fail)
+                         : "r" (addr), "r" (val)
+                         : "cc", "memory");
+    return old;
+}
+
+// Returns true if *addr was old and is now new
+static inline bool atomic_cas(volatile uint32_t *addr, uint32_t old, uint32_t new)
+{
+    uint32_t val, fail;
+
+    __asm__ __volatile__("1: ldrex   %0, [%2]\n"
+                         "   cmp     %0, %3\n"
+                         "   bne     2f\n"
+                         "   strex   %1, %4, [%2]\n"
+                         "   cmp     %1, #0\n"
+                         "   bne     1b\n"
+                         "   b       3f\n"
+                         "2: clrex\n"
+                         "3:\n"
+                         : "=&r" (val), "=&r" (fail)
+                         : "r" (addr), "r" (old), "r" (new)
+                         : "cc", "memory");
+    return val == old;
+}
+
+// Returns the previous value
+static inline uint32_t atomic_xchg(volatile uint32_t *addr, uint32_t val)
+{
+    uint32_t old, fail;
+
+    __asm__ __volatile__("1: ldrex   %0, [%2]\n"
+                         "   strex   %1, %3, [%2]\n"
+                         "   cmp     %1, #0\n"
+                         "   bne     1b\n"
+                         : "=&r" (old), "=&r" (fail)
+                         : "r" (addr), "r" (val)
+                         : "cc", "memory");
+    return old;
+}
+
+#endif // !HOST
+
+#endif // ATOMIC_H
@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "gic.h"
+#include "busid.h"
+#include "command.h"
+#include "mailbox.h"
+#include "event.h"
+#include "bench.h"
+
+#define BENCH_MBOX_ROUNDS     16
+#define BENCH_TIMEOUT_CYCLES  100000000 // per round, e.g. TRCH not running
+
+// Mailbox instances: the echo server on TRCH serves instance 0; instance 1
+// is owned by us and used to interrupt ourselves
+#define BENCH_MBOX_ECHO_INSTANCE  0
+#define BENCH_MBOX_SELF_INSTANCE  1
+
+static volatile bool bench_replied;
+static volatile uint32_t bench_reply_at;
+
+void bench_result(const char *name, uint32_t value)
+{
+    printf("BENCH %s %lu\r\n", name, value);
+}
+
+void bench_done(void)
+{
+    printf("BENCH_DONE\r\n");
+}
+
+static void bench_reply_cb(void *arg, volatile uint32_t *base, uint32_t *msg)
+{
+    (void)arg; (void)base; (void)msg;
+    bench_reply_at = pmu_cycles();
+    bench_replied = true;
+}
+
+// Returns 0 if the reply came within the timeout
+static int bench_wait_reply(uint32_t start)
+{
+    while (!bench_replied) {
+        event_dispatch(1); // the reply, unless received in the ISR
+        if (pmu_cycles() - start > BENCH_TIMEOUT_CYCLES) {
+            printf("ERROR: bench: no reply within %u cycles\r\n", BENCH_TIMEOUT_CYCLES);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void bench_report_rounds(const char *name, uint32_t min, uint32_t total, unsigned rounds)
+{
+    char stat[32];
+
+    snprintf(stat, sizeof(stat), "%s_min", name);
+    bench_result(stat, min);
+    snprintf(stat, sizeof(stat), "%s_avg", name);
+    bench_result(stat, total / rounds);
+}
+
+// Request-reply round trip to the echo server on TRCH: send, TRCH ISR and
+// command handling, reply, our ISR and callback
+void bench_mbox_rtt(void)
+{
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned len;
+    uint32_t start, t, min = ~0u, total = 0;
+    unsigned i;
+
+    gic_enable_irq(RTPS_TRCH_MAILBOX_IRQ_B, IRQ_TYPE_EDGE);
+    if (mbox_init_client(RTPS_TRCH_MBOX_BASE, BENCH_MBOX_ECHO_INSTANCE,
+                         MASTER_ID_RTPS_CPU0, bench_reply_cb, NULL))
+        return;
+
+    for (i = 0; i < BENCH_MBOX_ROUNDS; ++i) {
+        len = msg_echo_encode(msg, i);
+        bench_replied = false;
+        start = pmu_cycles();
+        mbox_request(RTPS_TRCH_MBOX_BASE, msg, len);
+        if (bench_wait_reply(start))
+            return;
+        t = bench_reply_at - start;
+        total += t;
+        if (t < min)
+            min = t;
+    }
+    bench_report_rounds("mbox_rtt", min, total, BENCH_MBOX_ROUNDS);
+}
+
+// Interrupt path on this core alone: raise INT B on an instance we own and
+// are the destination of, until the callback from the mailbox ISR. Polling
+// is off for this one, or only the first round would take an interrupt.
+void bench_mbox_irq(void)
+{
+    const struct mbox_poll_config irq_only = { .budget = 0, .idle_polls = 0 };
+    const struct mbox_poll_config dflt = { .budget = MBOX_POLL_BUDGET, .idle_polls = MBOX_POLL_IDLE };
+    volatile uint32_t *base = (volatile uint32_t *)((uint8_t *)RTPS_TRCH_MBOX_BASE +
+                              BENCH_MBOX_SELF_INSTANCE * HPSC_MBOX_INSTANCE_REGION);
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned len;
+    uint32_t start, t, min = ~0u, total = 0;
+    unsigned i;
+
+    gic_enable_irq(RTPS_TRCH_MAILBOX_IRQ_B, IRQ_TYPE_EDGE);
+    if (mbox_init_server(RTPS_TRCH_MBOX_BASE, BENCH_MBOX_SELF_INSTANCE,
+                         MASTER_ID_RTPS_CPU0, MASTER_ID_RTPS_CPU0, bench_reply_cb, NULL))
+        return;
+    if (mbox_init_client(RTPS_TRCH_MBOX_BASE, BENCH_MBOX_SELF_INSTANCE,
+                         MASTER_ID_RTPS_CPU0, bench_reply_cb, NULL))
+        return;
+
+    mbox_poll_configure(&irq_only);
+    for (i = 0; i < BENCH_MBOX_ROUNDS; ++i) {
+        len = msg_echo_reply_encode(msg, i);
+        bench_replied = false;
+        start = pmu_cycles();
+        mbox_reply(base, msg, len);
+        if (bench_wait_reply(start))
+            break;
+        t = bench_reply_at - start;
+        total += t;
+        if (t < min)
+            min = t;
+    }
+    mbox_poll_configure(&dflt);
+    if (i == BENCH_MBOX_ROUNDS)
+        bench_report_rounds("mbox_irq", min, total, BENCH_MBOX_ROUNDS);
+}
@@ -0,0 +1,17 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Benchmark results in a fixed format for tools/bench.sh, one per line:
+//     BENCH <name> <value>
+// Values are PMU cycles (deterministic under QEMU -icount), lower is better.
+// BENCH_DONE marks the end of the run.
+
+void bench_result(const char *name, uint32_t value);
+void bench_done(void);
+
+void bench_mbox_rtt(void);
+void bench_mbox_irq(void);
+
+#endif // BENCH_H
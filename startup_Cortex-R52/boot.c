@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "boot.h"
+
+// Must not be in .bss: the early markers are recorded from startup.s
+// before .bss is zeroed. The EL2 reset handler resets all entries to
+// BOOT_TS_NONE, so the markers are valid also after a warm restart.
+uint32_t boot_ts[BOOT_MARKS] = { [0 ... BOOT_MARKS - 1] = BOOT_TS_NONE };
+
+static const char *boot_mark_names[BOOT_MARKS] = {
+    [BOOT_MARK_RESET]     = "reset",
+    [BOOT_MARK_EL1]       = "EL1 entry",
+    [BOOT_MARK_CACHE_INV] = "cache invalidate",
+    [BOOT_MARK_MPU]       = "MPU enable",
+    [BOOT_MARK_CRT]       = "C runtime",
+    [BOOT_MARK_UART]      = "UART init",
+    [BOOT_MARK_CACHES]    = "caches enable",
+    [BOOT_MARK_IRQ]       = "IRQ enable",
+    [BOOT_MARK_MBOX]      = "first mailbox",
+};
+
+bool boot_mark(unsigned mark)
+{
+    if (mark >= BOOT_MARKS || boot_ts[mark] != BOOT_TS_NONE)
+        return false;
+    boot_ts[mark] = pmu_cycles();
+    return true;
+}
+
+void boot_report(void)
+{
+    uint32_t prev = boot_ts[BOOT_MARK_RESET];
+    unsigned i;
+
+#ifdef FAST_BOOT
+    printf("boot: timing (fast boot), cycles since reset:\r\n");
+#else
+    printf("boot: timing, cycles since reset:\r\n");
+#endif
+    for (i = 0; i < BOOT_MARKS; ++i) {
+        if (boot_ts[i] == BOOT_TS_NONE)
+            continue;
+        printf("boot: %-16s %10lu (+%lu)\r\n", boot_mark_names[i],
+               boot_ts[i] - boot_ts[BOOT_MARK_RESET], boot_ts[i] - prev);
+        prev = boot_ts[i];
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+// Boot phase markers: cycle counter timestamps (PMCCNTR) recorded at fixed
+// points from reset to the first serviced mailbox message. The first few
+// are recorded from startup.s, hence this header is also included in asm.
+
+#define BOOT_MARK_RESET         0 // EL2 reset handler entry (cycle counter started)
+#define BOOT_MARK_EL1           1 // EL1 reset handler entry
+#define BOOT_MARK_CACHE_INV     2 // L1 caches invalidated (or invalidation skipped with FAST_BOOT)
+#define BOOT_MARK_MPU           3 // MPU enabled (and caches, with FAST_BOOT)
+#define BOOT_MARK_CRT           4 // .bss zeroed, about to branch to main()
+#define BOOT_MARK_UART          5 // UART initialized
+#define BOOT_MARK_CACHES        6 // caches enabled from main()
+#define BOOT_MARK_IRQ           7 // interrupts enabled
+#define BOOT_MARK_MBOX          8 // first mailbox message serviced
+#define BOOT_MARKS              9
+
+#define BOOT_TS_NONE 0xffffffff // marker not reached (yet)
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+extern uint32_t boot_ts[BOOT_MARKS];
+
+// Returns true if this is the first time the marker is reached since reset
+bool boot_mark(unsigned mark);
+void boot_report(void);
+
+#endif // __ASSEMBLER__
+
+#endif // BOOT_H
@@ -0,0 +1,136 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cache.h"
+
+#define CLIDR_LOC(clidr)        (((clidr) >> 24) & 0x7)
+#define CLIDR_CTYPE(clidr, l)   (((clidr) >> ((l) * 3)) & 0x7)
+#define CTYPE_DATA              2 // data cache, or higher: unified, separate I+D
+#define CCSIDR_LINE_SHIFT(c)    (((c) & 0x7) + 4)
+#define CCSIDR_WAYS(c)          (((c) >> 3) & 0x3ff)  // associativity - 1
+#define CCSIDR_SETS(c)          (((c) >> 13) & 0x7fff) // number of sets - 1
+
+#define LINE_MASK               ((uintptr_t)CACHE_LINE_SIZE - 1)
+
+void dcache_clean_invalidate_all(void)
+{
+    uint32_t clidr, ccsidr;
+    unsigned level, line_shift, way_shift, ways, sets, way, set;
+
+    __asm__ __volatile__("dsb" : : : "memory");
+    __asm__ __volatile__("mrc p15, 1, %0, c0, c0, 1" : "=r" (clidr)); // CLIDR
+
+    for (level = 0; level < CLIDR_LOC(clidr); ++level) {
+        if (CLIDR_CTYPE(clidr, level) < CTYPE_DATA)
+            continue;
+
+        __asm__ __volatile__("mcr p15, 2, %0, c0, c0, 0" : : "r" (level << 1)); // CSSELR
+        __asm__ __volatile__("isb");
+        __asm__ __volatile__("mrc p15, 1, %0, c0, c0, 0" : "=r" (ccsidr)); // CCSIDR
+
+        line_shift = CCSIDR_LINE_SHIFT(ccsidr);
+        ways = CCSIDR_WAYS(ccsidr);
+        sets = CCSIDR_SETS(ccsidr);
+        way_shift = ways ? __builtin_clz(ways) : 0;
+
+        for (way = 0; way <= ways; ++way) {
+            for (set = 0; set <= sets; ++set) {
+                uint32_t sw = (way << way_shift) | (set << line_shift) | (level << 1);
+                __asm__ __volatile__("mcr p15, 0, %0, c7, c14, 2" : : "r" (sw)); // DCCISW
+            }
+        }
+    }
+
+    __asm__ __volatile__("dsb" : : : "memory");
+    __asm__ __volatile__("isb");
+}
+
+void icache_invalidate_all(void)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c7, c5, 0" : : "r" (0)); // ICIALLU
+    __asm__ __volatile__("dsb" : : : "memory");
+    __asm__ __volatile__("isb");
+}
+
+static inline void dccmvac(uintptr_t addr)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c7, c10, 1" : : "r" (addr) : "memory"); // DCCMVAC
+}
+
+static inline void dcimvac(uintptr_t addr)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c7, c6, 1" : : "r" (addr) : "memory"); // DCIMVAC
+}
+
+static inline void dccimvac(uintptr_t addr)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c7, c14, 1" : : "r" (addr) : "memory"); // DCCIMVAC
+}
+
+void dcache_clean_range(const void *addr, size_t len)
+{
+    uintptr_t line = (uintptr_t)addr & ~LINE_MASK;
+    uintptr_t end = (uintptr_t)addr + len;
+
+    if (!len)
+        return;
+
+    __asm__ __volatile__("dsb" : : : "memory"); // complete the stores to the range
+    for (; line < end; line += CACHE_LINE_SIZE)
+        dccmvac(line);
+    __asm__ __volatile__("dsb" : : : "memory");
+}
+
+void dcache_invalidate_range(void *addr, size_t len)
+{
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + len;
+    uintptr_t line = start & ~LINE_MASK;
+
+    if (!len)
+        return;
+
+    __asm__ __volatile__("dsb" : : : "memory");
+
+    // Partial lines at the edges may hold dirty data outside the range
+    if (start & LINE_MASK) {
+        dccimvac(line);
+        line += CACHE_LINE_SIZE;
+    }
+    if ((end & LINE_MASK) && line < end) {
+        dccimvac(end & ~LINE_MASK);
+        end &= ~LINE_MASK;
+    }
+    for (; line < end; line += CACHE_LINE_SIZE)
+        dcimvac(line);
+
+    __asm__ __volatile__("dsb" : : : "memory");
+}
+
+void dcache_clean_invalidate_range(const void *addr, size_t len)
+{
+    uintptr_t line = (uintptr_t)addr & ~LINE_MASK;
+    uintptr_t end = (uintptr_t)addr + len;
+
+    if (!len)
+        return;
+
+    __asm__ __volatile__("dsb" : : : "memory");
+    for (; line < end; line += CACHE_LINE_SIZE)
+        dccimvac(line);
+    __asm__ __volatile__("dsb" : : : "memory");
+}
+
+void shbuf_release(const void *buf, size_t len)
+{
+    // Also invalidate: lines of the buffer stay out of the cache until
+    // written again, so none is evicted over the memory later.
+    dcache_clean_invalidate_range(buf, len);
+}
+
+void shbuf_acquire(void *buf, size_t len)
+{
+    // Lines may have been speculatively refetched while the other side
+    // owned the buffer, so invalidate on every acquire.
+    dcache_invalidate_range(buf, len);
+}
@@ -0,0 +1,31 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+// Cortex-R52 L1 D-cache line size; use to align buffers shared with other
+// masters, so that no line is shared between a buffer and unrelated data.
+#define CACHE_LINE_SIZE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
+// Whole-cache maintenance by set/way (L1 on Cortex-R52)
+void dcache_clean_invalidate_all(void);
+void icache_invalidate_all(void);
+
+// D-cache maintenance by address range (to the Point of Coherency).
+// The range is widened to whole cache lines, except for invalidate, which
+// cleans partial lines at either end to not lose dirty data next to the range.
+void dcache_clean_range(const void *addr, size_t len);
+void dcache_invalidate_range(void *addr, size_t len);
+void dcache_clean_invalidate_range(const void *addr, size_t len);
+
+// Ownership transfer of cacheable buffers shared with another master (HPPS,
+// TRCH), like the log ring (shmlog.h). Call shbuf_release() after writing a
+// buffer and before signaling the other side (e.g. advancing the ring's
+// write position), and shbuf_acquire() before reading what the other side
+// wrote (e.g. the ring's reader position). Buffers are whole cache lines
+// (CACHE_ALIGNED), none shared with data of the other side.
+void shbuf_release(const void *buf, size_t len);
+void shbuf_acquire(void *buf, size_t len);
+
+#endif // CACHE_H
@@ -2,25 +2,138 @@
 
 #include "printf.h"
 #include "mailbox.h"
+#include "msg.h"
+#include "trace.h"
+#include "busid.h"
+#include "coro.h"
+#include "router.h"
 
 #include "command.h"
 
-void cmd_handle(void *cbarg, volatile uint32_t *mbox_base, uint32_t *msg)
+// Relays to TRCH: one coroutine per request in flight, each on its own
+// lane (instance) of the RTPS-TRCH mailbox, served by the echo server on
+// TRCH like instance 0
+#define CMD_RELAY_INSTANCE      2
+#define CMD_RELAY_LANES         2
+#define CMD_RELAY_TIMEOUT_MS    100
+
+// Requests from TRCH, on RTPS_TRCH instances after the lanes of the TRCH
+// route of router.c: served like those from HPPS, for MSG_ROUTE_HPPS
+#define CMD_TRCH_INSTANCE       8
+#define CMD_TRCH_LANES          2
+
+struct relay {
+    struct coro coro; // first, see relay_run()
+    bool busy;
+    volatile uint32_t *mbox_base; // to reply on
+    uint32_t arg;
+    uint32_t status;
+    struct coro_call *call;
+};
+
+static struct coro_client relay_client;
+static struct relay relays[CMD_RELAY_LANES];
+
+int cmd_init(void)
 {
-    unsigned cmd = msg[0];
-    unsigned arg = msg[1];
+    unsigned i;
+
+    if (coro_client_init(&relay_client, RTPS_TRCH_MBOX_BASE, CMD_RELAY_INSTANCE,
+                         CMD_RELAY_LANES, MASTER_ID_RTPS_CPU0))
+        return 1;
+    for (i = 0; i < CMD_TRCH_LANES; ++i)
+        if (mbox_init_server(RTPS_TRCH_MBOX_BASE, CMD_TRCH_INSTANCE + i,
+                             MASTER_ID_RTPS_CPU0, MASTER_ID_TRCH_CPU, cmd_handle, NULL))
+            return 1;
+    return router_init();
+}
 
-    uint32_t reply[1];
+// Handlers of the requests in msg_schema.h: fields are read in place from
+// the received message, the reply is filled in place and sent by
+// msg_dispatch()
 
-    printf("CMD handle cmd %x arg %x\r\n", cmd, arg);
+int msg_handle_echo(volatile uint32_t *mbox_base,
+                    const struct msg_echo *req, struct msg_echo_reply *reply)
+{
+    (void)mbox_base;
+    printf("ECHO %x\r\n", req->arg);
+    reply->arg = req->arg;
+    return 0;
+}
+
+int msg_handle_trace(volatile uint32_t *mbox_base,
+                     const struct msg_trace *req, struct msg_trace_reply *reply)
+{
+    unsigned end;
+
+    (void)mbox_base;
+    if (req->index == 0)
+        trace_stop();
+    reply->count = trace_read(req->index, (struct trace_event *)reply->events,
+                              MSG_TRACE_EVENTS);
+    end = req->index + reply->count;
+    reply->remaining = end < trace_count() ? trace_count() - end : 0;
+    return 0;
+}
+
+static int relay_run(struct coro *c)
+{
+    struct relay *r = (struct relay *)c;
+    uint32_t msg[MSG_MAX_WORDS];
+
+    CORO_BEGIN(c);
+    r->status = MSG_RELAY_BUSY; // timed-out requests may still hold lanes
+    r->call = coro_call_get(&relay_client, c);
+    if (r->call) {
+        coro_call_send(r->call, msg, msg_echo_encode(msg, r->arg));
+        CORO_WAIT_UNTIL_TIMEOUT(c, coro_call_replied(r->call), coro_ms(CMD_RELAY_TIMEOUT_MS));
+        if (coro_call_replied(r->call)) {
+            r->status = MSG_RELAY_OK;
+            r->arg = msg_echo_reply_decode(r->call->reply)->arg;
+        } else {
+            r->status = MSG_RELAY_TIMEOUT;
+        }
+        coro_call_put(r->call);
+    }
+    mbox_reply(r->mbox_base, msg, msg_relay_reply_encode(msg, r->status, r->arg));
+    CORO_END(c);
+}
+
+static void relay_done(struct coro *c)
+{
+    ((struct relay *)c)->busy = false;
+}
+
+// Replies from relay_run(), once TRCH has
+int msg_handle_relay(volatile uint32_t *mbox_base,
+                     const struct msg_relay *req, struct msg_relay_reply *reply)
+{
+    unsigned i;
+
+    for (i = 0; i < CMD_RELAY_LANES; ++i) {
+        struct relay *r = &relays[i];
+        if (!r->busy) {
+            r->busy = true;
+            r->mbox_base = mbox_base;
+            r->arg = req->arg;
+            coro_start(&r->coro, relay_run, EVENT_PRIO_NORMAL, relay_done);
+            return 1;
+        }
+    }
+    reply->status = MSG_RELAY_BUSY;
+    reply->arg = req->arg;
+    return 0;
+}
+
+void cmd_handle(void *cbarg, volatile uint32_t *mbox_base, uint32_t *msg)
+{
+    (void)cbarg;
+    printf("CMD handle cmd %x arg %x\r\n", msg[0], msg[1]);
 
-    switch (cmd) {
-        case CMD_ECHO:
-            printf("ECHO %x\r\n", arg);
-            reply[0] = arg;
-            mbox_reply(mbox_base, reply, 1);
-            break;
-        default:
-            printf("ERROR: unknown cmd: %x\r\n", cmd);
+    if (msg_route(msg) != MSG_ROUTE_LOCAL) {
+        router_request(mbox_base, msg);
+        return;
     }
+    if (msg_dispatch(mbox_base, msg))
+        printf("ERROR: unknown cmd: %x\r\n", msg[0]);
 }
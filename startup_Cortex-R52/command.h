@@ -3,9 +3,12 @@
 
 #include <stdbool.h>
 
-// Command field length is limited to 4-bits right now
-#define CMD_ECHO       0x1
+#include "msg.h" // commands and their messages, see msg_schema.h
 
+// Sets up the client side of the commands that call TRCH, the server of
+// requests from TRCH and the router (router.h) of the requests tagged with
+// a route
+int cmd_init(void);
 void cmd_handle(void *cbarg, volatile uint32_t *mbox_base, uint32_t *msg);
 
 #endif // COMMAND_H
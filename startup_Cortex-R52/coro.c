@@ -0,0 +1,224 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "intr.h"
+#include "mailbox.h"
+#include "coro.h"
+
+static struct coro *timers; // coroutines with a timeout running
+
+static void coro_run(void *arg)
+{
+    struct coro *c = arg;
+
+    if (!c->running) // woken after it finished, by a stale wait
+        return;
+    if (c->fn(c) == CORO_DONE) {
+        c->running = false;
+        if (c->done)
+            c->done(c);
+    }
+}
+
+void coro_start(struct coro *c, coro_fn_t fn, unsigned prio, void (*done)(struct coro *c))
+{
+    c->line = 0;
+    c->fn = fn;
+    c->prio = prio;
+    c->done = done;
+    c->ev.fn = coro_run;
+    c->ev.arg = c;
+    c->ev.pending = 0;
+    c->timer_on = false;
+    c->timed_out = false;
+    c->running = true;
+    coro_wake(c);
+}
+
+void coro_wake(struct coro *c)
+{
+    event_post(&c->ev, c->prio);
+}
+
+// The earliest deadline, or disarmed. Called with IRQs masked.
+void coro_timer_rearm(void)
+{
+    struct coro *c;
+    uint64_t next = UINT64_MAX;
+
+    for (c = timers; c; c = c->timer_next)
+        if (c->deadline < next)
+            next = c->deadline;
+    if (next == UINT64_MAX)
+        timer_disarm();
+    else
+        timer_arm(next); // fires at once if already past
+}
+
+static void timer_remove(struct coro *c)
+{
+    struct coro **p;
+
+    for (p = &timers; *p; p = &(*p)->timer_next) {
+        if (*p == c) {
+            *p = c->timer_next;
+            break;
+        }
+    }
+    c->timer_on = false;
+}
+
+void coro_timeout_start(struct coro *c, uint64_t ticks)
+{
+    uint32_t irq = intr_save();
+
+    c->timed_out = false;
+    c->deadline = timer_now() + ticks;
+    if (!c->timer_on) {
+        c->timer_next = timers;
+        timers = c;
+        c->timer_on = true;
+    }
+    coro_timer_rearm();
+    intr_restore(irq);
+}
+
+// The timer stays armed for the removed deadline: the interrupt re-arms
+// for the rest, no need to scan the list here
+void coro_timeout_stop(struct coro *c)
+{
+    uint32_t irq = intr_save();
+
+    if (c->timer_on)
+        timer_remove(c);
+    intr_restore(irq);
+}
+
+void coro_timer_isr(void)
+{
+    struct coro *c, *next;
+    uint64_t now = timer_now();
+
+    for (c = timers; c; c = next) {
+        next = c->timer_next;
+        if (c->deadline <= now) {
+            timer_remove(c);
+            c->timed_out = true;
+            coro_wake(c);
+        }
+    }
+    coro_timer_rearm();
+}
+
+// A lane was freed: wake all waiters, to retry. Called with IRQs masked.
+static void lane_freed(struct coro_client *cl)
+{
+    unsigned i;
+
+    for (i = 0; i < cl->waiters; ++i)
+        coro_wake(cl->waiter[i]);
+    cl->waiters = 0;
+}
+
+// Reply on a lane: callback of its mailbox instance
+static void call_reply_cb(void *arg, volatile uint32_t *base, uint32_t *msg)
+{
+    struct coro_call *call = arg;
+    unsigned i;
+
+    (void)base; // call->base
+
+    call->busy = false;
+    if (!call->waiter) {
+        call->client->late_replies++;
+        lane_freed(call->client);
+        return;
+    }
+    for (i = 0; i < MSG_MAX_WORDS; ++i)
+        call->reply[i] = msg[i];
+    call->replied = true;
+    coro_wake(call->waiter);
+}
+
+int coro_client_init(struct coro_client *cl, volatile uint32_t *ip_base,
+                     unsigned first_instance, unsigned lanes, uint32_t dest)
+{
+    struct coro_call *call;
+    unsigned l;
+
+    if (!lanes || lanes > CORO_CLIENT_MAX_LANES || first_instance + lanes > HPSC_MBOX_INSTANCES) {
+        printf("ERROR: coro client: bad layout: instances %u + %u\r\n", first_instance, lanes);
+        return 1;
+    }
+    cl->lanes = lanes;
+    cl->waiters = 0;
+    cl->calls = cl->no_lane = cl->late_replies = cl->reclaimed = 0;
+    for (l = 0; l < lanes; ++l) {
+        call = &cl->call[l];
+        call->client = cl;
+        call->base = (volatile uint32_t *)((uint8_t *)ip_base +
+                                           (first_instance + l) * HPSC_MBOX_INSTANCE_REGION);
+        call->waiter = NULL;
+        call->busy = false;
+        call->replied = false;
+        if (mbox_init_client(ip_base, first_instance + l, dest, call_reply_cb, call))
+            return 1;
+    }
+    return 0;
+}
+
+// An abandoned lane whose reply is overdue. Called with IRQs masked.
+static bool lane_reclaim(struct coro_call *call)
+{
+    if (call->waiter || !call->busy ||
+        timer_now() - call->abandoned_at < coro_ms(CORO_CALL_RECLAIM_MS))
+        return false;
+    call->busy = false;
+    call->client->reclaimed++;
+    return true;
+}
+
+struct coro_call *coro_call_get(struct coro_client *cl, struct coro *c)
+{
+    struct coro_call *call = NULL;
+    uint32_t irq = intr_save();
+    unsigned l;
+
+    for (l = 0; l < cl->lanes; ++l) {
+        if (!cl->call[l].waiter && (!cl->call[l].busy || lane_reclaim(&cl->call[l]))) {
+            call = &cl->call[l];
+            call->waiter = c;
+            call->replied = false;
+            cl->calls++;
+            break;
+        }
+    }
+    if (!call) {
+        cl->no_lane++;
+        for (l = 0; l < cl->waiters && cl->waiter[l] != c; ++l)
+            ;
+        if (l == cl->waiters && cl->waiters < CORO_CLIENT_MAX_WAITERS)
+            cl->waiter[cl->waiters++] = c;
+    }
+    intr_restore(irq);
+    return call;
+}
+
+void coro_call_send(struct coro_call *call, uint32_t *msg, size_t len)
+{
+    call->busy = true;
+    mbox_request(call->base, msg, len);
+}
+
+void coro_call_put(struct coro_call *call)
+{
+    uint32_t irq = intr_save();
+
+    call->waiter = NULL; // a reply still to come is dropped
+    if (!call->busy)
+        lane_freed(call->client);
+    else
+        call->abandoned_at = timer_now();
+    intr_restore(irq);
+}
@@ -0,0 +1,156 @@
+#ifndef CORO_H
+#define CORO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "msg.h"
+#include "event.h"
+#include "timer.h"
+
+// Stackless coroutines (protothreads), run by the event loop (event.h).
+//
+// A coroutine is a function int fn(struct coro *c) that the event loop
+// calls again each time the coroutine is woken; CORO_BEGIN() jumps to the
+// wait it returned from, by the line number of the wait (a switch). Hence
+// locals do not survive a wait: keep the state in a struct that embeds the
+// struct coro, and do not use switch statements across waits.
+//
+//     struct req { struct coro coro; ... };
+//
+//     static int req_run(struct coro *c)
+//     {
+//         struct req *r = (struct req *)c; // coro first
+//
+//         CORO_BEGIN(c);
+//         ...
+//         CORO_WAIT_UNTIL_TIMEOUT(c, coro_call_replied(r->call), ticks);
+//         ...
+//         CORO_END(c);
+//     }
+//
+// A waiting coroutine only re-checks its condition when woken: whatever
+// makes the condition true must call coro_wake(). The mailbox calls below
+// and the timeouts do; a timeout is the EL1 physical timer (timer.h),
+// shared by all coroutines, whose interrupt handler is coro_timer_isr().
+//
+// Coroutines, callbacks and ISRs run on one core.
+
+#define CORO_WAITING    0
+#define CORO_DONE       1
+
+struct coro;
+typedef int (*coro_fn_t)(struct coro *c);
+
+struct coro {
+    unsigned line;          // where to resume, 0 at the start
+    coro_fn_t fn;
+    unsigned prio;          // EVENT_PRIO_*
+    struct event ev;        // posted by coro_wake(), runs fn
+    void (*done)(struct coro *c); // when fn reaches CORO_END, may be NULL
+    bool running;           // started, CORO_END not reached: wakes otherwise ignored
+    // Timeout, on the list of coro_timer_isr() while running
+    uint64_t deadline;
+    struct coro *timer_next;
+    bool timer_on;
+    volatile bool timed_out;
+};
+
+// The switch of CORO_BEGIN() ends in CORO_END(), falling through the case
+// labels of the waits in between on purpose
+#define CORO_BEGIN(c)   switch ((c)->line) { case 0:
+#define CORO_END(c)     break; } (c)->line = 0; return CORO_DONE
+
+// Return and resume here once cond is true, cond is evaluated on each wake
+#define CORO_WAIT_UNTIL(c, cond) \
+    do { \
+        (c)->line = __LINE__; __attribute__((fallthrough)); case __LINE__: \
+        if (!(cond)) \
+            return CORO_WAITING; \
+    } while (0)
+
+// Same, or until ticks have passed: then (c)->timed_out is true
+#define CORO_WAIT_UNTIL_TIMEOUT(c, cond, ticks) \
+    do { \
+        coro_timeout_start((c), (ticks)); \
+        CORO_WAIT_UNTIL((c), (cond) || (c)->timed_out); \
+        coro_timeout_stop(c); \
+    } while (0)
+
+#define CORO_SLEEP(c, ticks) CORO_WAIT_UNTIL_TIMEOUT((c), 0, (ticks))
+
+// Let other events run, resume after them
+#define CORO_YIELD(c) \
+    do { \
+        (c)->line = __LINE__; \
+        coro_wake(c); \
+        return CORO_WAITING; \
+        case __LINE__:; \
+    } while (0)
+
+static inline uint64_t coro_ms(unsigned ms)
+{
+    return (uint64_t)timer_freq() * ms / 1000;
+}
+
+// Runs fn from the start, from the event loop
+void coro_start(struct coro *c, coro_fn_t fn, unsigned prio, void (*done)(struct coro *c));
+void coro_wake(struct coro *c);
+void coro_timeout_start(struct coro *c, uint64_t ticks);
+void coro_timeout_stop(struct coro *c);
+// Handler of the timer interrupt (GIC_IRQ(TIMER_PPI)): wakes the
+// coroutines whose timeout expired, re-arms for the next one
+void coro_timer_isr(void);
+// Arms the timer for the earliest timeout running, or disarms it: after
+// another user of the timer (idle_bench()). Called with IRQs masked.
+void coro_timer_rearm(void);
+
+// Requests to a mailbox server on a set of client instances ("lanes"), one
+// request in flight per lane, awaited by the coroutine that sent it. A
+// request that timed out keeps its lane until its reply comes, which is
+// then dropped, so that the reply cannot be taken for the next request's.
+// If no reply comes within CORO_CALL_RECLAIM_MS more, the server is taken
+// to have dropped the request and coro_call_get() reclaims the lane
+// (counted): only a reply later still would be mistaken for the next one.
+// Coroutines that found no free lane are woken when one is freed (the
+// first CORO_CLIENT_MAX_WAITERS of them, the others have to time out):
+//
+//     CORO_WAIT_UNTIL(c, (r->call = coro_call_get(cl, c)) != NULL);
+
+#define CORO_CLIENT_MAX_LANES   8
+#define CORO_CLIENT_MAX_WAITERS 8
+#define CORO_CALL_RECLAIM_MS    500
+
+struct coro_client;
+
+struct coro_call {
+    struct coro_client *client;
+    volatile uint32_t *base;    // of the instance
+    struct coro *waiter;        // NULL if free or abandoned
+    volatile bool busy;         // request sent, reply not received
+    volatile bool replied;
+    uint64_t abandoned_at;      // timer ticks, put while busy
+    uint32_t reply[MSG_MAX_WORDS];
+};
+
+struct coro_client {
+    unsigned lanes;
+    struct coro_call call[CORO_CLIENT_MAX_LANES];
+    struct coro *waiter[CORO_CLIENT_MAX_WAITERS]; // for a free lane
+    unsigned waiters;
+    uint32_t calls, no_lane, late_replies, reclaimed;
+};
+
+int coro_client_init(struct coro_client *cl, volatile uint32_t *ip_base,
+                     unsigned first_instance, unsigned lanes, uint32_t dest);
+// A free lane for c, or NULL and c is woken when one is freed
+struct coro_call *coro_call_get(struct coro_client *cl, struct coro *c);
+void coro_call_send(struct coro_call *call, uint32_t *msg, size_t len);
+static inline bool coro_call_replied(struct coro_call *call)
+{
+    return call->replied;
+}
+// Done with the lane (and the reply), replied or not
+void coro_call_put(struct coro_call *call);
+
+#endif // CORO_H
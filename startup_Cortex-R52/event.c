@@ -0,0 +1,158 @@
+#include <stdint.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "atomic.h"
+#include "ring.h"
+#include "event.h"
+
+struct event_queue {
+    struct ring_mpsc ring;
+    struct ring_mpsc_slot slots[EVENT_QUEUE_SIZE];
+    // Stats, the first three updated by posters (any context)
+    uint32_t posts;
+    uint32_t coalesced;     // already pending
+    uint32_t drops;         // queue full
+    unsigned depth_max;
+    uint32_t dispatched;
+    uint32_t lat_max;
+    uint64_t lat_total;
+};
+
+static const char * const prio_names[EVENT_PRIOS] = {
+    [EVENT_PRIO_HIGH]   = "high",
+    [EVENT_PRIO_NORMAL] = "normal",
+    [EVENT_PRIO_LOW]    = "low",
+};
+
+static struct event_queue queues[EVENT_PRIOS];
+
+void event_init(void)
+{
+    unsigned prio;
+
+    for (prio = 0; prio < EVENT_PRIOS; ++prio)
+        ring_mpsc_init(&queues[prio].ring, queues[prio].slots, EVENT_QUEUE_SIZE);
+}
+
+int event_post(struct event *ev, unsigned prio)
+{
+    struct event_queue *q = &queues[prio];
+    void *obj = ev;
+    unsigned depth;
+
+    if (atomic_xchg(&ev->pending, 1)) {
+        atomic_fetch_add(&q->coalesced, 1);
+        return 0;
+    }
+    ev->posted = pmu_cycles();
+    if (!ring_mpsc_enqueue(&q->ring, &obj, 1)) {
+        ev->pending = 0;
+        atomic_fetch_add(&q->drops, 1);
+        return 1;
+    }
+    atomic_fetch_add(&q->posts, 1);
+    depth = ring_mpsc_count(&q->ring);
+    if (depth > q->depth_max) // racy, but only ever raised
+        q->depth_max = depth;
+    return 0;
+}
+
+unsigned event_dispatch(unsigned budget)
+{
+    struct event_queue *q;
+    struct event *ev;
+    unsigned n, prio;
+    uint32_t lat;
+
+    // Back to the highest priority after each event: a handler may be
+    // preempted by an ISR that posts a more urgent one
+    for (n = 0; n < budget; ++n) {
+        for (prio = 0; prio < EVENT_PRIOS; ++prio)
+            if (ring_mpsc_dequeue(&queues[prio].ring, (void **)&ev, 1))
+                break;
+        if (prio == EVENT_PRIOS)
+            break;
+
+        q = &queues[prio];
+        lat = pmu_cycles() - ev->posted;
+        q->dispatched++;
+        q->lat_total += lat;
+        if (lat > q->lat_max)
+            q->lat_max = lat;
+
+        ev->pending = 0;
+        dmb(); // a post from here on queues it again
+        ev->fn(ev->arg);
+    }
+    return n;
+}
+
+unsigned event_pending(void)
+{
+    unsigned prio, n = 0;
+
+    for (prio = 0; prio < EVENT_PRIOS; ++prio)
+        n += ring_mpsc_count(&queues[prio].ring);
+    return n;
+}
+
+void event_report(void)
+{
+    struct event_queue *q;
+    unsigned prio;
+
+    printf("events: %-6s %8s %9s %5s %9s %10s %8s %8s\r\n", "prio", "posts", "coalesced",
+           "drops", "depth max", "dispatched", "lat avg", "lat max");
+    for (prio = 0; prio < EVENT_PRIOS; ++prio) {
+        q = &queues[prio];
+        printf("        %-6s %8lu %9lu %5lu %9u %10lu %8lu %8lu\r\n", prio_names[prio],
+               q->posts, q->coalesced, q->drops, q->depth_max, q->dispatched,
+               q->dispatched ? (uint32_t)(q->lat_total / q->dispatched) : 0, q->lat_max);
+    }
+}
+
+#define EVENT_TEST_EVENTS 6
+
+static unsigned test_order[EVENT_TEST_EVENTS], test_runs;
+
+static void test_handler(void *arg)
+{
+    if (test_runs < EVENT_TEST_EVENTS)
+        test_order[test_runs] = (unsigned)(uintptr_t)arg;
+    test_runs++;
+}
+
+// Posted low priority first, each twice: dispatched high priority first,
+// in post order within a priority, once each
+void event_test(void)
+{
+    static struct event evs[EVENT_TEST_EVENTS];
+    unsigned i, prio, expected = 0;
+
+    test_runs = 0;
+    for (i = 0; i < EVENT_TEST_EVENTS; ++i) {
+        struct event ev = EVENT_INIT(test_handler, (void *)(uintptr_t)i);
+        evs[i] = ev;
+    }
+    for (i = 0; i < EVENT_TEST_EVENTS; ++i) {
+        prio = EVENT_PRIOS - 1 - i % EVENT_PRIOS;
+        event_post(&evs[i], prio);
+        event_post(&evs[i], prio);
+    }
+    event_dispatch(EVENT_ALL);
+
+    if (test_runs != EVENT_TEST_EVENTS)
+        printf("ERROR: events: %u handler runs, expected %u\r\n", test_runs, EVENT_TEST_EVENTS);
+    for (prio = 0; prio < EVENT_PRIOS; ++prio) {
+        for (i = 0; i < EVENT_TEST_EVENTS; ++i) {
+            if (EVENT_PRIOS - 1 - i % EVENT_PRIOS != prio)
+                continue;
+            if (expected < test_runs && test_order[expected] != i)
+                printf("ERROR: events: dispatch %u: event %u, expected %u\r\n",
+                       expected, test_order[expected], i);
+            expected++;
+        }
+    }
+    event_report();
+}
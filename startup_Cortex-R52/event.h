@@ -0,0 +1,50 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+
+// Event reactor: ISRs only acknowledge (or mask) the hardware and post an
+// event; the main loop dispatches events to their handlers in thread
+// context, run to completion, highest priority first. One MPSC ring
+// (ring.h) per priority, so events may be posted from ISRs, thread context
+// and other cores.
+//
+// An event is a statically allocated object owned by its poster, queued at
+// most once: posting an event that is still pending does nothing (it keeps
+// its queue and its first post time), like a deferred work item. The
+// pending flag is cleared just before the handler runs, so the handler, or
+// an ISR meanwhile, may post it again for work that came after.
+//
+// Per priority, counted: posts, coalesced posts, drops (queue full), the
+// high-water mark of the queue depth and the dispatch latency, in cycles
+// from the (first) post to the handler call.
+
+#define EVENT_PRIO_HIGH     0
+#define EVENT_PRIO_NORMAL   1
+#define EVENT_PRIO_LOW      2
+#define EVENT_PRIOS         3
+
+#define EVENT_QUEUE_SIZE    16  // per priority, power of 2
+#define EVENT_ALL           (~0u) // dispatch budget: until no event is pending
+
+typedef void (*event_fn_t)(void *arg);
+
+struct event {
+    event_fn_t fn;
+    void *arg;
+    volatile uint32_t pending;
+    uint32_t posted;    // cycle count at the post
+};
+
+#define EVENT_INIT(handler, handler_arg) { .fn = (handler), .arg = (handler_arg) }
+
+void event_init(void);
+// Returns 0 if queued or already pending, 1 if the queue is full
+int event_post(struct event *ev, unsigned prio);
+// Runs up to budget events, returns how many
+unsigned event_dispatch(unsigned budget);
+unsigned event_pending(void);
+void event_report(void);
+void event_test(void);
+
+#endif // EVENT_H
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "gic.h"
+#include "fiq.h"
+
+#define FIQ_BENCH_ROUNDS        16
+#define FIQ_BENCH_TIMEOUT       1000000 // cycles per round
+
+struct fiq_entry {
+    unsigned intid;
+    fiq_fn_t fn;
+    void *arg;
+};
+
+static struct fiq_entry fiq_table[FIQ_HANDLERS];
+static unsigned fiq_entries;
+static volatile uint32_t fiq_unhandled;
+
+void fiq_init(void)
+{
+    __asm__ __volatile__("cpsie f" : : : "memory");
+}
+
+int fiq_register(unsigned intid, fiq_fn_t fn, void *arg)
+{
+    struct fiq_entry *e;
+    unsigned i;
+
+    for (i = 0; i < fiq_entries; ++i) {
+        if (fiq_table[i].intid == intid) {
+            printf("ERROR: fiq: INTID %u already has a handler\r\n", intid);
+            return 1;
+        }
+    }
+    if (fiq_entries == FIQ_HANDLERS) {
+        printf("ERROR: fiq: no room for INTID %u, %u handlers\r\n", intid, FIQ_HANDLERS);
+        return 1;
+    }
+    e = &fiq_table[fiq_entries];
+    e->intid = intid;
+    e->fn = fn;
+    e->arg = arg;
+    __asm__ __volatile__("dmb" : : : "memory"); // the entry, then the count
+    fiq_entries++;
+    gic_set_group0(intid);
+    return 0;
+}
+
+void fiq_handler(unsigned intid)
+{
+    unsigned i;
+
+    for (i = 0; i < fiq_entries; ++i) {
+        if (fiq_table[i].intid == intid) {
+            fiq_table[i].fn(fiq_table[i].arg);
+            return;
+        }
+    }
+    fiq_unhandled++; // no printf here, see fiq.h
+}
+
+// Benchmark: each round raises an SGI, the handler stamps its entry
+enum bench_path {
+    BENCH_IRQ,
+    BENCH_FIQ,
+    BENCH_FIQ_IN_IRQ,   // FIQ raised from the IRQ handler
+    BENCH_PATHS,
+};
+
+static const char * const bench_names[BENCH_PATHS] = {
+    [BENCH_IRQ]        = "irq",
+    [BENCH_FIQ]        = "fiq",
+    [BENCH_FIQ_IN_IRQ] = "fiq in irq",
+};
+
+static volatile enum bench_path bench_path;
+static volatile uint32_t bench_start, bench_entry;
+static volatile bool bench_taken;
+
+static void bench_fiq(void *arg)
+{
+    bench_entry = pmu_cycles();
+    bench_taken = true;
+}
+
+void fiq_bench_irq_isr(void)
+{
+    uint32_t entry = pmu_cycles();
+
+    if (bench_path == BENCH_FIQ_IN_IRQ) {
+        // The FIQ preempts this handler: taken before the SGI write retires
+        bench_start = pmu_cycles();
+        gic_send_sgi(FIQ_BENCH_SGI_FIQ, 0);
+        return;
+    }
+    bench_entry = entry;
+    bench_taken = true;
+}
+
+void fiq_bench(void)
+{
+    uint32_t lat, min, max, total, start;
+    unsigned p, i;
+
+    static bool registered;
+
+    if (!registered && fiq_register(FIQ_BENCH_SGI_FIQ, bench_fiq, NULL))
+        return;
+    registered = true;
+    gic_enable_ppi(FIQ_BENCH_SGI_FIQ);
+    gic_enable_ppi(FIQ_BENCH_SGI_IRQ);
+
+    printf("fiq bench: %-10s %8s %8s %8s (cycles from the SGI to the handler)\r\n",
+           "path", "min", "avg", "max");
+    for (p = 0; p < BENCH_PATHS; ++p) {
+        bench_path = p;
+        min = ~0u;
+        max = total = 0;
+        for (i = 0; i < FIQ_BENCH_ROUNDS; ++i) {
+            bench_taken = false;
+            start = pmu_cycles();
+            bench_start = start;
+            if (p == BENCH_FIQ)
+                gic_send_sgi(FIQ_BENCH_SGI_FIQ, 0);
+            else
+                gic_send_sgi(FIQ_BENCH_SGI_IRQ, 1);
+            while (!bench_taken) {
+                if (pmu_cycles() - start > FIQ_BENCH_TIMEOUT) {
+                    printf("ERROR: fiq bench: %s: not taken within %u cycles\r\n",
+                           bench_names[p], FIQ_BENCH_TIMEOUT);
+                    return;
+                }
+            }
+            lat = bench_entry - bench_start;
+            total += lat;
+            if (lat < min)
+                min = lat;
+            if (lat > max)
+                max = lat;
+        }
+        printf("           %-10s %8lu %8lu %8lu\r\n", bench_names[p], min,
+               total / FIQ_BENCH_ROUNDS, max);
+    }
+    if (fiq_unhandled)
+        printf("ERROR: fiq: %lu unhandled FIQs\r\n", fiq_unhandled);
+}
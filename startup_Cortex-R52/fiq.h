@@ -0,0 +1,42 @@
+#ifndef FIQ_H
+#define FIQ_H
+
+#include <stdint.h>
+
+#include "gic.h"
+
+// FIQ path for the few interrupts that must not wait behind the IRQ
+// handler: INTIDs moved to GIC group 0 with gic_set_group0() are signaled
+// as FIQ, which preempts IRQ handlers and intr_save() sections (those mask
+// IRQs only). EL1_FIQ_Handler (startup.s) acknowledges with ICC_IAR0 and
+// calls the handler registered for the INTID, in FIQ mode, with IRQs and
+// FIQs masked; then EOIs with ICC_EOIR0.
+//
+// A FIQ handler may only touch state that is safe to access at any point
+// of the code, IRQ handlers included: it must not printf, post events
+// (event.h) or take locks; it hands work over with lock-free flags or
+// counters, or with an SGI to the IRQ path.
+
+#define FIQ_HANDLERS        4
+
+// SGIs of fiq_bench(): one in group 0, one left in group 1
+#define FIQ_BENCH_SGI_FIQ   1
+#define FIQ_BENCH_SGI_IRQ   2
+#define FIQ_BENCH_IRQ       GIC_IRQ(FIQ_BENCH_SGI_IRQ) // in irq_handler()
+
+typedef void (*fiq_fn_t)(void *arg);
+
+// Unmasks FIQs on this core (CPSR.F)
+void fiq_init(void);
+// Moves intid to group 0 and handles its FIQs with fn, returns 0 on
+// success; the INTID is enabled as for an IRQ (gic_enable_irq/ppi())
+int fiq_register(unsigned intid, fiq_fn_t fn, void *arg);
+// Called by EL1_FIQ_Handler
+void fiq_handler(unsigned intid);
+
+// Entry latency, in cycles from raising an SGI, of: the IRQ path, the FIQ
+// path, and the FIQ path while an IRQ handler runs
+void fiq_bench(void);
+void fiq_bench_irq_isr(void); // irq_handler() case FIQ_BENCH_IRQ
+
+#endif // FIQ_H
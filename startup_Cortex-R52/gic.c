@@ -5,9 +5,17 @@
 
 #define GIC_BASE ((volatile uint32_t *)0xf9a00000)
 
+#define GICD_IGROUPR   0x0080
 #define GICD_ISENABLER 0x0100
 #define GICD_ICFGR     0x0C00
 
+// Redistributors, one frame per core in core order (as startup.s finds them)
+#define GICR_BASE       ((volatile uint32_t *)0xf9b00000)
+#define GICR_FRAME_SIZE 0x20000 // RD_base and SGI_base
+#define GICR_SGI_BASE   0x10000
+#define GICR_IGROUPR0   0x0080
+#define GICR_ISENABLER0 0x0100
+
 static const char *irq_type_name(irq_type_t t)
 {
     switch (t) {
@@ -35,3 +43,55 @@ void gic_enable_irq(unsigned irq, irq_type_t type) {
     printf("GIC: enable IRQ #%u (INTID %u): %p |= %08x\r\n", irq, intid, reg_addr, val);
     *reg_addr |= val;
 }
+
+static inline uint32_t mpidr(void)
+{
+    uint32_t val;
+    __asm__ __volatile__("mrc p15, 0, %0, c0, c0, 5" : "=r" (val)); // MPIDR
+    return val;
+}
+
+// A register in the SGI_base frame of this core's redistributor
+static volatile uint32_t *gicr_sgi_reg(unsigned offset)
+{
+    return (volatile uint32_t *)((volatile uint8_t *)GICR_BASE + (mpidr() & 0xff) * GICR_FRAME_SIZE +
+                                 GICR_SGI_BASE + offset);
+}
+
+// SGIs and PPIs are enabled per core, in this core's redistributor
+void gic_enable_ppi(unsigned intid) {
+    volatile uint32_t *reg_addr = gicr_sgi_reg(GICR_ISENABLER0);
+
+    printf("GIC: enable PPI (INTID %u): %p = %08x\r\n", intid, reg_addr, 1u << intid);
+    *reg_addr = 1u << intid; // write 1 to set, zeros have no effect
+}
+
+// Group 0 is signaled as FIQ, group 1 (all INTIDs, from startup.s) as IRQ.
+// SGIs and PPIs are grouped per core, SPIs in the distributor.
+void gic_set_group0(unsigned intid) {
+    volatile uint32_t *reg_addr;
+
+    if (intid < 32)
+        reg_addr = gicr_sgi_reg(GICR_IGROUPR0);
+    else
+        reg_addr = (volatile uint32_t *)((volatile uint8_t *)GIC_BASE + GICD_IGROUPR + (intid / 32) * 4);
+
+    printf("GIC: INTID %u to group 0 (FIQ): %p &= ~%08x\r\n", intid, reg_addr, 1u << (intid % 32));
+    *reg_addr &= ~(1u << (intid % 32));
+}
+
+// To this core, in group 0 (ICC_SGI0R) or group 1 (ICC_SGI1R): the SGI is
+// taken only if it is in that group
+void gic_send_sgi(unsigned intid, unsigned group) {
+    uint32_t aff = mpidr();
+    uint64_t sgir = (uint64_t)((aff >> 16) & 0xff) << 32 |     // Aff2
+                    (uint64_t)(intid & 0xf) << 24 |           // INTID
+                    (uint64_t)((aff >> 8) & 0xff) << 16 |     // Aff1
+                    1u << (aff & 0xf);                        // TargetList: Aff0
+
+    if (group == 0)
+        __asm__ __volatile__("mcrr p15, 2, %Q0, %R0, c12" : : "r" (sgir)); // ICC_SGI0R
+    else
+        __asm__ __volatile__("mcrr p15, 0, %Q0, %R0, c12" : : "r" (sgir)); // ICC_SGI1R
+    __asm__ __volatile__("isb");
+}
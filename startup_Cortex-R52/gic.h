@@ -6,6 +6,15 @@ typedef enum {
     IRQ_TYPE_EDGE  = 1
 } irq_type_t;
 
+// IRQ # as passed to irq_handler() (INTID - 32, see startup.s); wraps
+// around for SGIs and PPIs
+#define GIC_IRQ(intid) ((unsigned)(intid) - 32)
+
 void gic_enable_irq(unsigned irq, irq_type_t type);
+void gic_enable_ppi(unsigned intid);
+// Signal intid as FIQ (fiq.h) instead of IRQ
+void gic_set_group0(unsigned intid);
+// Software-generated interrupt intid (0-15) to this core
+void gic_send_sgi(unsigned intid, unsigned group);
 
 #endif // GIC_H
@@ -0,0 +1,471 @@
+/* Host counterpart of main.c: runs the firmware's mailbox flows against the
+   device models (mmio_model.c) and the benchmarks, on x86 Linux.
+   Exits with the number of failed flows, for use in scripts. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "printf.h"
+#include "mailbox.h"
+#include "command.h"
+#include "busid.h"
+#include "pool.h"
+#include "mbox_chan.h"
+#include "ring.h"
+#include "event.h"
+#include "gic.h"
+#include "timer.h"
+#include "coro.h"
+#include "router.h"
+#include "shmlog.h"
+#include "pmu.h"
+#include "mmio_model.h"
+
+#define MBOX_BENCH_ROUNDS 10000
+#define MBOX_STORM_MSGS   10000
+#define HPPS_URGENT_LANES 1
+#define HPPS_BULK_LANES   3
+#define QOS_BULK_MSGS     10000
+#define QOS_URGENT_EVERY  16  // bulk messages between urgent ones
+#define RELAY_INSTANCE    2     // CMD_RELAY_INSTANCE in command.c
+#define RELAY_LANES       2
+#define RELAY_DROP        0xdead // dropped by the TRCH model
+#define RELAY_WAIT_MS     1000
+#define ROUTE_INSTANCE    4     // of the TRCH route in router.c
+#define ROUTE_LANES       4
+#define ROUTE_ROUNDS      1000  // of requests on all HPPS lanes at once
+#define HPPS_ROUTE_INSTANCE 4   // of the HPPS route in router.c
+#define HPPS_ROUTE_LANES  2
+#define TRCH_INSTANCE     8     // CMD_TRCH_INSTANCE in command.c
+#define TRCH_LANES        2
+
+int cdns_uart_startup();
+extern void compare_sorts(void);
+
+static unsigned errors;
+static uint32_t trch_reply;     // last reply received from the TRCH model
+static uint32_t hpps_reply;     // last reply received by the HPPS model
+static unsigned replies;
+static unsigned hpps_replies;   // replies received by the HPPS model
+static unsigned urgent_sent_at; // hpps_replies when the urgent request was sent
+static unsigned urgent_wait_max, urgent_wait_total, urgent_replies;
+static bool urgent_pending;
+static struct mbox_chan hpps_chan;
+static uint32_t hpps_last[HPPS_URGENT_LANES + HPPS_BULK_LANES][MSG_MAX_WORDS]; // per lane
+static unsigned trch_replies;   // replies received by the TRCH model
+static uint32_t trch_last[TRCH_LANES][MSG_MAX_WORDS];
+
+/* TRCH side of the RTPS -> TRCH -> RTPS flow, like cmd_handle() on TRCH:
+   compiled from the same msg_schema.h */
+static void trch_server(const uint32_t *req, uint32_t *reply, size_t *len)
+{
+    if (req[0] == CMD_ECHO)
+        *len = msg_echo_reply_encode(reply, msg_echo_decode(req)->arg);
+}
+
+/* HPPS side of the HPPS -> RTPS -> HPPS flow */
+static void hpps_client(unsigned instance, const uint32_t *reply)
+{
+    hpps_reply = msg_echo_reply_decode(reply)->arg;
+    hpps_replies++;
+    for (unsigned i = 0; i < MSG_MAX_WORDS; ++i)
+        hpps_last[instance][i] = reply[i];
+    if (instance < HPPS_URGENT_LANES && urgent_pending) {
+        unsigned wait = hpps_replies - 1 - urgent_sent_at; // bulk replies ahead of it
+        urgent_pending = false;
+        urgent_replies++;
+        urgent_wait_total += wait;
+        if (wait > urgent_wait_max)
+            urgent_wait_max = wait;
+    }
+}
+
+/* TRCH side of the TRCH -> RTPS -> HPPS flow, routed */
+static void trch_client(unsigned instance, const uint32_t *reply)
+{
+    trch_replies++;
+    for (unsigned i = 0; i < MSG_MAX_WORDS; ++i)
+        trch_last[instance - TRCH_INSTANCE][i] = reply[i];
+}
+
+static void handle_trch_reply(void *arg, volatile uint32_t *mbox_base, uint32_t *msg)
+{
+    (void)arg; (void)mbox_base;
+    trch_reply = msg_echo_reply_decode(msg)->arg;
+    printf("recved reply from TRCH: 0x%x\r\n", trch_reply);
+    replies++;
+}
+
+static void check(const char *what, uint32_t got, uint32_t expected)
+{
+    if (got != expected) {
+        printf("ERROR: %s: got 0x%x, expected 0x%x\r\n", what, got, expected);
+        errors++;
+    }
+}
+
+/* TRCH echo server on the relay and route lanes, which never answers
+   RELAY_DROP (in the low half of the arg) */
+static void trch_relay_server(const uint32_t *req, uint32_t *reply, size_t *len)
+{
+    if (req[0] == CMD_ECHO && (msg_echo_decode(req)->arg & 0xffff) != RELAY_DROP)
+        *len = msg_echo_reply_encode(reply, msg_echo_decode(req)->arg);
+}
+
+/* Same dispatch as irq_handler() in main.c */
+void irq_handler(unsigned irq)
+{
+#ifdef IRQ_DEBUG
+    printf("IRQ #%u\r\n", irq);
+#endif
+    switch (irq) {
+        case RTPS_TRCH_MAILBOX_IRQ_B:
+            mbox_reply_isr(RTPS_TRCH_MBOX_BASE);
+            break;
+        case HPPS_RTPS_MAILBOX_IRQ_A:
+            mbox_request_isr(HPPS_RTPS_MBOX_BASE);
+            break;
+        case RTPS_TRCH_MAILBOX_IRQ_A:
+            mbox_request_isr(RTPS_TRCH_MBOX_BASE);
+            break;
+        case HPPS_RTPS_MAILBOX_IRQ_B:
+            mbox_reply_isr(HPPS_RTPS_MBOX_BASE);
+            break;
+        case GIC_IRQ(TIMER_PPI):
+            timer_disarm();
+            coro_timer_isr();
+            break;
+        default:
+            printf("No ISR registered for IRQ #%u\r\n", irq);
+            break;
+    }
+}
+
+/* A request from HPPS that RTPS relays to TRCH: the reply comes from a
+   coroutine (command.c), once TRCH replied or the relay timed out */
+static void relay(uint32_t arg, uint32_t status)
+{
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned start_replies = hpps_replies;
+    uint64_t start = timer_now();
+
+    if (mbox_model_request(HPPS_RTPS_MBOX_BASE, /* instance */ 0, msg, msg_relay_encode(msg, arg))) {
+        errors++;
+        return;
+    }
+    while (hpps_replies == start_replies && timer_now() - start < coro_ms(RELAY_WAIT_MS)) {
+        event_dispatch(1);
+        timer_model_poll();
+    }
+    check("relay: replies", hpps_replies - start_replies, 1);
+    check("relay: status", msg_relay_reply_decode(hpps_last[0])->status, status);
+    check("relay: arg", msg_relay_reply_decode(hpps_last[0])->arg, arg);
+}
+
+/* Routed echo requests from HPPS to TRCH, one on each HPPS lane at once,
+   for rounds: all in flight through RTPS together (router.c), the lane in
+   the high half of the arg */
+static void route(uint32_t arg, uint32_t status, unsigned rounds)
+{
+    const unsigned lanes = HPPS_URGENT_LANES + HPPS_BULK_LANES;
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned round, lane, start_replies;
+    uint64_t start;
+
+    uart_model_mute(rounds > 1);
+    for (round = 0; round < rounds; ++round) {
+        start_replies = hpps_replies;
+        for (lane = 0; lane < lanes; ++lane) {
+            unsigned len = msg_echo_encode(msg, arg + (lane << 16));
+            msg_set_route(msg, MSG_ROUTE_TRCH);
+            if (mbox_model_request(HPPS_RTPS_MBOX_BASE, lane, msg, len))
+                errors++;
+        }
+        start = timer_now();
+        while (hpps_replies - start_replies < lanes && timer_now() - start < coro_ms(RELAY_WAIT_MS)) {
+            event_dispatch(1);
+            timer_model_poll();
+        }
+        for (lane = 0; lane < lanes; ++lane) {
+            check("route: status", hpps_last[lane][0], status);
+            if (status == MSG_ROUTE_OK)
+                check("route: arg", msg_echo_reply_decode(&hpps_last[lane][1])->arg, arg + (lane << 16));
+        }
+        if (hpps_replies - start_replies != lanes) {
+            check("route: replies", hpps_replies - start_replies, lanes);
+            break;
+        }
+    }
+    uart_model_mute(false);
+}
+
+/* Routed echo requests from TRCH to HPPS, one on each TRCH lane at once,
+   the lane in the high half of the arg */
+static void route_hpps(uint32_t arg)
+{
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned lane, start_replies = trch_replies;
+    uint64_t start;
+
+    for (lane = 0; lane < TRCH_LANES; ++lane) {
+        unsigned len = msg_echo_encode(msg, arg + (lane << 16));
+        msg_set_route(msg, MSG_ROUTE_HPPS);
+        if (mbox_model_request(RTPS_TRCH_MBOX_BASE, TRCH_INSTANCE + lane, msg, len))
+            errors++;
+    }
+    start = timer_now();
+    while (trch_replies - start_replies < TRCH_LANES && timer_now() - start < coro_ms(RELAY_WAIT_MS)) {
+        event_dispatch(1);
+        timer_model_poll();
+    }
+    check("route hpps: replies", trch_replies - start_replies, TRCH_LANES);
+    for (lane = 0; lane < TRCH_LANES; ++lane) {
+        check("route hpps: status", trch_last[lane][0], MSG_ROUTE_OK);
+        check("route hpps: arg", msg_echo_reply_decode(&trch_last[lane][1])->arg, arg + (lane << 16));
+    }
+}
+
+/* printf to the log ring, read back like the HPPS reader does, after
+   enough text to wrap the ring */
+static void shmlog_check(void)
+{
+    static const char line[] = "shmlog check: the last line\r\n";
+    char buf[sizeof(line) - 1];
+    uint32_t pos, lost, off;
+
+    shmlog_init();
+    shmlog_bench();
+    uart_model_mute(true);
+    shmlog_console = SHMLOG_CONSOLE_UART | SHMLOG_CONSOLE_RING;
+    while (shmlog_ring()->wraps < 2)
+        printf("shmlog check: filler\r\n");
+    printf("%s", line);
+    shmlog_console = SHMLOG_CONSOLE_UART;
+    uart_model_mute(false);
+
+    // The last line and the header handed to HPPS (out of the D-cache)
+    off = (shmlog_ring()->write - (sizeof(line) - 1)) & (SHMLOG_SIZE - 1);
+    if (off + sizeof(line) - 1 > SHMLOG_SIZE)
+        check("shmlog: released", cache_model_released(&shmlog_ring()->text[off], SHMLOG_SIZE - off) &&
+              cache_model_released(shmlog_ring()->text, off + sizeof(line) - 1 - SHMLOG_SIZE), true);
+    else
+        check("shmlog: released", cache_model_released(&shmlog_ring()->text[off], sizeof(line) - 1), true);
+    check("shmlog: header released", cache_model_released(shmlog_ring(), SHMLOG_READER_OFFSET), true);
+    pos = shmlog_ring()->write - (sizeof(line) - 1);
+    check("shmlog: read", shmlog_read(shmlog_ring(), &pos, buf, sizeof(buf), &lost), sizeof(buf));
+    check("shmlog: lost", lost, 0);
+    check("shmlog: text", memcmp(buf, line, sizeof(buf)), 0);
+    pos = 0;
+    shmlog_read(shmlog_ring(), &pos, buf, sizeof(buf), &lost);
+    check("shmlog: lost when behind", lost, shmlog_oldest(shmlog_ring()));
+
+    // The reader's position, as shmlogcat -f stores it, read back from its line
+    ((struct shmlog *)shmlog_ring())->read = pos;
+    check("shmlog: reader", shmlog_reader(), pos);
+    check("shmlog: reader acquired",
+          cache_model_acquired((const uint8_t *)shmlog_ring() + SHMLOG_READER_OFFSET, 4), true);
+    shmlog_report();
+}
+
+/* Request-reply round trips with the UART output discarded: the cost of the
+   driver path (register accesses, ISR dispatch, pool, printf formatting) */
+static void mbox_bench(void)
+{
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned long tx_bytes = uart_model_tx_bytes();
+    unsigned i, start_replies = replies;
+    uint32_t start;
+
+    uart_model_mute(true);
+    start = pmu_cycles();
+    for (i = 0; i < MBOX_BENCH_ROUNDS; ++i) {
+        mbox_request(RTPS_TRCH_MBOX_BASE, msg, msg_echo_encode(msg, i));
+        while (replies - start_replies == i && event_pending())
+            event_dispatch(1);
+    }
+    start = pmu_cycles() - start;
+    uart_model_mute(false);
+
+    check("mbox bench: replies", replies - start_replies, MBOX_BENCH_ROUNDS);
+    printf("mbox bench: %u round trips: %u ns/round trip, %lu UART bytes/round trip\r\n",
+           MBOX_BENCH_ROUNDS, start / MBOX_BENCH_ROUNDS,
+           (uart_model_tx_bytes() - tx_bytes) / MBOX_BENCH_ROUNDS);
+}
+
+/* A request received in the ISR with the message pool exhausted: dropped
+   and counted, with the instance acked so the next request goes through */
+static void mbox_drop(void)
+{
+    const struct mbox_poll_config irq_only = { .budget = 0, .idle_polls = MBOX_POLL_IDLE };
+    const struct mbox_poll_config hybrid = { .budget = MBOX_POLL_BUDGET, .idle_polls = MBOX_POLL_IDLE };
+    struct mbox_poll_stats before, after;
+    void *held[64];
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned n = 0, len;
+
+    mbox_poll_configure(&irq_only);
+    mbox_poll_get_stats(&before);
+    while (n < 64 && (held[n] = pool_alloc(POOL_SIZE_MSG)) != NULL)
+        n++;
+    hpps_reply = 0;
+    len = msg_echo_encode(msg, 0x4321);
+    if (mbox_model_request(HPPS_RTPS_MBOX_BASE, 0, msg, len))
+        errors++;
+    event_dispatch(EVENT_ALL);
+    mbox_poll_get_stats(&after);
+    check("mbox drop: dropped", after.dropped - before.dropped, 1);
+    check("mbox drop: no reply", hpps_reply, 0);
+
+    while (n)
+        pool_free(held[--n]);
+    if (mbox_model_request(HPPS_RTPS_MBOX_BASE, 0, msg, len))
+        errors++;
+    event_dispatch(EVENT_ALL);
+    check("mbox drop: then received", hpps_reply, 0x4321);
+    mbox_poll_configure(&hybrid);
+}
+
+/* A storm of requests from HPPS, sent as fast as RTPS takes them, with
+   the main loop of main.c: per message cost with interrupts only vs. with
+   the interrupt/polling hybrid */
+static void mbox_storm(const char *mode, unsigned budget)
+{
+    const struct mbox_poll_config config = { .budget = budget, .idle_polls = MBOX_POLL_IDLE };
+    struct mbox_poll_stats before, after;
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned sent = 0;
+    uint32_t start;
+
+    mbox_poll_configure(&config);
+    mbox_poll_get_stats(&before);
+    uart_model_mute(true);
+    start = pmu_cycles();
+    while (sent < MBOX_STORM_MSGS || event_pending()) {
+        unsigned len = msg_echo_encode(msg, sent);
+        if (sent < MBOX_STORM_MSGS && !mbox_model_request(HPPS_RTPS_MBOX_BASE, 0, msg, len))
+            sent++;
+        event_dispatch(1);
+    }
+    start = pmu_cycles() - start;
+    uart_model_mute(false);
+    mbox_poll_get_stats(&after);
+
+    check("mbox storm: last reply", hpps_reply, MBOX_STORM_MSGS - 1);
+    printf("mbox storm (%s): %u msgs: %u ns/msg, %u interrupts\r\n", mode,
+           MBOX_STORM_MSGS, start / MBOX_STORM_MSGS, after.irqs - before.irqs);
+}
+
+/* Bulk requests from HPPS keep every bulk lane busy; an urgent request is
+   sent every QOS_URGENT_EVERY bulk ones. Reports how many bulk replies
+   went out between sending an urgent request and its reply. */
+static void mbox_qos(void)
+{
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned len, sent = 0, lane, next_urgent = QOS_URGENT_EVERY;
+
+    urgent_wait_max = urgent_wait_total = urgent_replies = 0;
+    uart_model_mute(true);
+    while (sent < QOS_BULK_MSGS || event_pending()) {
+        for (lane = HPPS_URGENT_LANES; lane < HPPS_URGENT_LANES + HPPS_BULK_LANES; ++lane) {
+            len = msg_echo_encode(msg, sent);
+            if (sent < QOS_BULK_MSGS && !mbox_model_request(HPPS_RTPS_MBOX_BASE, lane, msg, len))
+                sent++;
+        }
+        if (sent >= next_urgent && !urgent_pending) {
+            urgent_pending = true;
+            urgent_sent_at = hpps_replies;
+            if (mbox_model_request(HPPS_RTPS_MBOX_BASE, 0, msg, len))
+                urgent_pending = false;
+            next_urgent += QOS_URGENT_EVERY;
+        }
+        event_dispatch(1);
+    }
+    uart_model_mute(false);
+
+    check("mbox qos: urgent replies", urgent_replies, QOS_BULK_MSGS / QOS_URGENT_EVERY);
+    printf("mbox qos: %u bulk msgs, %u urgent: bulk replies ahead of urgent: max %u, avg %u.%02u\r\n",
+           QOS_BULK_MSGS, urgent_replies, urgent_wait_max,
+           urgent_wait_total / urgent_replies, urgent_wait_total * 100 / urgent_replies % 100);
+}
+
+int main(void)
+{
+    cdns_uart_startup();
+    printf("R52 host build\r\n");
+
+    pool_init();
+    event_init();
+
+    /* Message flow: RTPS -> TRCH -> RTPS, as TEST_RTPS_TRCH_MAILBOX */
+    mbox_model_attach_server(RTPS_TRCH_MBOX_BASE, /* instance */ 0,
+                             MASTER_ID_TRCH_CPU, MASTER_ID_RTPS_CPU0, trch_server);
+    if (mbox_init_client(RTPS_TRCH_MBOX_BASE, /* instance */ 0, MASTER_ID_RTPS_CPU0, handle_trch_reply, NULL))
+        errors++;
+    uint32_t msg[MSG_MAX_WORDS];
+    unsigned len = msg_echo_encode(msg, 42);
+    printf("sending request to TRCH: cmd %x arg %x\r\n", msg[0], msg_echo_decode(msg)->arg);
+    mbox_request(RTPS_TRCH_MBOX_BASE, msg, len);
+    event_dispatch(EVENT_ALL);
+    check("RTPS -> TRCH echo", trch_reply, 42);
+
+    /* Message flow: HPPS -> RTPS -> HPPS, as TEST_HPPS_RTPS_MAILBOX */
+    if (mbox_chan_init_server(&hpps_chan, HPPS_RTPS_MBOX_BASE, /* instance */ 0,
+                              HPPS_URGENT_LANES, HPPS_BULK_LANES,
+                              MASTER_ID_RTPS_CPU0, MASTER_ID_HPPS_CPU0, cmd_handle, NULL))
+        errors++;
+    for (unsigned lane = 0; lane < HPPS_URGENT_LANES + HPPS_BULK_LANES; ++lane)
+        mbox_model_attach_client(HPPS_RTPS_MBOX_BASE, lane, hpps_client);
+    len = msg_echo_encode(msg, 0x1234);
+    if (mbox_model_request(HPPS_RTPS_MBOX_BASE, /* instance */ 0, msg, len))
+        errors++;
+    event_dispatch(EVENT_ALL);
+    check("HPPS -> RTPS echo", hpps_reply, 0x1234);
+    mbox_drop();
+
+    /* Message flow: HPPS -> RTPS -> TRCH -> RTPS -> HPPS, relayed and
+       routed, and timeouts, and TRCH -> RTPS -> HPPS -> RTPS -> TRCH, routed
+       to the same echo server on HPPS */
+    for (unsigned lane = 0; lane < RELAY_LANES; ++lane)
+        mbox_model_attach_server(RTPS_TRCH_MBOX_BASE, RELAY_INSTANCE + lane,
+                                 MASTER_ID_TRCH_CPU, MASTER_ID_RTPS_CPU0, trch_relay_server);
+    for (unsigned lane = 0; lane < ROUTE_LANES; ++lane)
+        mbox_model_attach_server(RTPS_TRCH_MBOX_BASE, ROUTE_INSTANCE + lane,
+                                 MASTER_ID_TRCH_CPU, MASTER_ID_RTPS_CPU0, trch_relay_server);
+    for (unsigned lane = 0; lane < HPPS_ROUTE_LANES; ++lane)
+        mbox_model_attach_server(HPPS_RTPS_MBOX_BASE, HPPS_ROUTE_INSTANCE + lane,
+                                 MASTER_ID_HPPS_CPU0, MASTER_ID_RTPS_CPU0, trch_relay_server);
+    for (unsigned lane = 0; lane < TRCH_LANES; ++lane)
+        mbox_model_attach_client(RTPS_TRCH_MBOX_BASE, TRCH_INSTANCE + lane, trch_client);
+    if (cmd_init())
+        errors++;
+    relay(0x5678, MSG_RELAY_OK);
+    relay(RELAY_DROP, MSG_RELAY_TIMEOUT);
+    relay(0x9abc, MSG_RELAY_OK);
+    route(0x100, MSG_ROUTE_OK, 1);
+    route(0x200, MSG_ROUTE_OK, ROUTE_ROUNDS);
+    route(RELAY_DROP, MSG_ROUTE_TIMEOUT, 1); // holds the route lanes...
+    uint64_t start = timer_now();
+    while (timer_now() - start < coro_ms(CORO_CALL_RECLAIM_MS))
+        ;
+    route(0x300, MSG_ROUTE_OK, 1);          // ...until they are reclaimed
+    route_hpps(0x400);
+
+    /* Benchmarks, in nanoseconds where the target reports cycles */
+    mbox_bench();
+    mbox_storm("irq", 0);
+    mbox_storm("poll", MBOX_POLL_BUDGET);
+    mbox_qos();
+    mbox_poll_report();
+    event_report();
+    router_report();
+    compare_sorts();
+    ring_bench();
+    printf_bench();
+    pool_report();
+    shmlog_check();
+
+    printf("Done: %u errors.\r\n", errors);
+    return errors;
+}
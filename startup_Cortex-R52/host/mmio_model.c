@@ -0,0 +1,355 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mmio.h"
+#include "mailbox.h"
+#include "gic.h"
+#include "timer.h"
+#include "cache.h"
+#include "mmio_model.h"
+
+#define UART_BASE           0x30001000
+#define UART_SIZE           0x1000
+#define UART_CR             0x00
+#define UART_CR_RESETS      0x3 // TXRST, RXRST: self-clearing
+#define UART_SR             0x2c
+#define UART_SR_TXEMPTY     0x8
+#define UART_FIFO           0x30
+
+#define MBOX_IP_SIZE        (HPSC_MBOX_INSTANCES * HPSC_MBOX_INSTANCE_REGION)
+
+struct uart_model {
+    uint32_t regs[UART_SIZE / 4];
+    bool mute;
+    unsigned long tx_bytes;
+};
+
+struct mbox_instance {
+    uint32_t owner;
+    uint32_t dest;
+    uint32_t int_enable;
+    uint32_t int_status;
+    uint32_t data[HPSC_MBOX_DATA_REGS];
+    mbox_model_server_t server; // remote server: receives INT A
+    mbox_model_client_t client; // remote client: receives INT B
+};
+
+struct mbox_ip {
+    uintptr_t base;
+    unsigned irq_a, irq_b;
+    struct mbox_instance inst[HPSC_MBOX_INSTANCES];
+};
+
+static struct uart_model uart;
+
+struct cache_range {
+    uintptr_t start, end;
+};
+
+struct cache_ranges {
+    struct cache_range range[CACHE_MODEL_RANGES];
+    unsigned next;
+};
+
+static struct cache_ranges cache_released, cache_acquired;
+
+uint32_t timer_model_ctl;
+uint64_t timer_model_cval;
+
+static struct mbox_ip mbox_ips[] = {
+    { .base = (uintptr_t)RTPS_TRCH_MBOX_BASE, .irq_a = RTPS_TRCH_MAILBOX_IRQ_A, .irq_b = RTPS_TRCH_MAILBOX_IRQ_B },
+    { .base = (uintptr_t)HPPS_RTPS_MBOX_BASE, .irq_a = HPPS_RTPS_MAILBOX_IRQ_A, .irq_b = HPPS_RTPS_MAILBOX_IRQ_B },
+    { .base = (uintptr_t)HPPS_TRCH_MBOX_BASE, .irq_a = HPPS_TRCH_MAILBOX_IRQ_A, .irq_b = HPPS_TRCH_MAILBOX_IRQ_B },
+};
+#define MBOX_IPS (sizeof(mbox_ips) / sizeof(mbox_ips[0]))
+
+// Raised interrupts, delivered in order once the raising access completes
+#define IRQ_QUEUE_SIZE 64
+static unsigned irq_queue[IRQ_QUEUE_SIZE];
+static unsigned irq_head, irq_tail;
+static bool in_irq;
+
+static void fatal(const char *what, volatile uint32_t *addr)
+{
+    fprintf(stderr, "mmio model: %s: %p\n", what, (void *)addr);
+    abort();
+}
+
+static struct mbox_ip *find_ip(uintptr_t addr)
+{
+    unsigned i;
+    for (i = 0; i < MBOX_IPS; ++i)
+        if (addr >= mbox_ips[i].base && addr < mbox_ips[i].base + MBOX_IP_SIZE)
+            return &mbox_ips[i];
+    return NULL;
+}
+
+static struct mbox_ip *ip_by_base(volatile uint32_t *ip_base)
+{
+    struct mbox_ip *ip = find_ip((uintptr_t)ip_base);
+    if (!ip || ip->base != (uintptr_t)ip_base)
+        fatal("not a mailbox IP base", ip_base);
+    return ip;
+}
+
+static void raise_irq(unsigned irq)
+{
+    if (irq_tail - irq_head == IRQ_QUEUE_SIZE) {
+        fprintf(stderr, "mmio model: IRQ queue overflow, IRQ %u lost\n", irq);
+        return;
+    }
+    irq_queue[irq_tail++ % IRQ_QUEUE_SIZE] = irq;
+}
+
+static void deliver_irqs(void)
+{
+    if (in_irq)
+        return;
+    in_irq = true;
+    while (irq_head != irq_tail)
+        irq_handler(irq_queue[irq_head++ % IRQ_QUEUE_SIZE]);
+    in_irq = false;
+}
+
+// The remote side reacts to an interrupt raised towards it right away
+static void mbox_remote(struct mbox_ip *ip, struct mbox_instance *mb, uint32_t ints)
+{
+    unsigned instance = mb - ip->inst;
+
+    if ((ints & HPSC_MBOX_INT_A) && mb->server) {
+        uint32_t req[HPSC_MBOX_DATA_REGS], reply[HPSC_MBOX_DATA_REGS] = { 0 };
+        size_t len = 0, i;
+        for (i = 0; i < HPSC_MBOX_DATA_REGS; ++i)
+            req[i] = mb->data[i];
+        mb->server(req, reply, &len);
+        mb->int_status &= ~HPSC_MBOX_INT_A;
+        if (len) {
+            for (i = 0; i < len && i < HPSC_MBOX_DATA_REGS; ++i)
+                mb->data[i] = reply[i];
+            mb->int_status |= HPSC_MBOX_INT_B;
+            if (mb->int_enable & HPSC_MBOX_INT_B)
+                raise_irq(ip->irq_b);
+        }
+    }
+    if ((ints & HPSC_MBOX_INT_B) && mb->client) {
+        mb->client(instance, mb->data);
+        mb->int_status &= ~HPSC_MBOX_INT_B;
+    }
+}
+
+static void mbox_set_ints(struct mbox_ip *ip, struct mbox_instance *mb, uint32_t ints)
+{
+    mb->int_status |= ints;
+    mbox_remote(ip, mb, ints);
+    ints &= mb->int_status & mb->int_enable;
+    if ((ints & HPSC_MBOX_INT_A) && !mb->server)
+        raise_irq(ip->irq_a);
+    if ((ints & HPSC_MBOX_INT_B) && !mb->client)
+        raise_irq(ip->irq_b);
+}
+
+static uint32_t mbox_instances(struct mbox_ip *ip, uint32_t mbox_int)
+{
+    uint32_t mask = 0;
+    unsigned i;
+    for (i = 0; i < HPSC_MBOX_INSTANCES; ++i)
+        if (ip->inst[i].int_status & ip->inst[i].int_enable & mbox_int)
+            mask |= 1u << i;
+    return mask;
+}
+
+static uint32_t mbox_read(struct mbox_ip *ip, uintptr_t off)
+{
+    struct mbox_instance *mb = &ip->inst[off / HPSC_MBOX_INSTANCE_REGION];
+    unsigned reg = off % HPSC_MBOX_INSTANCE_REGION;
+
+    if (reg >= REG_DATA)
+        return mb->data[(reg - REG_DATA) / 4];
+    switch (reg) {
+        case REG_OWNER:             return mb->owner;
+        case REG_INT_ENABLE:        return mb->int_enable;
+        case REG_INT_CAUSE:         return mb->int_status & mb->int_enable;
+        case REG_INT_STATUS:        return mb->int_status;
+        // IP-wide in the first instance's region, as the driver reads them
+        case REG_INT_A_INSTANCES:   return mbox_instances(ip, HPSC_MBOX_INT_A);
+        case REG_INT_B_INSTANCES:   return mbox_instances(ip, HPSC_MBOX_INT_B);
+        case REG_DESTINATION:       return mb->dest;
+        default:                    return 0;
+    }
+}
+
+static void mbox_write(struct mbox_ip *ip, uintptr_t off, uint32_t val)
+{
+    struct mbox_instance *mb = &ip->inst[off / HPSC_MBOX_INSTANCE_REGION];
+    unsigned reg = off % HPSC_MBOX_INSTANCE_REGION;
+
+    if (reg >= REG_DATA) {
+        mb->data[(reg - REG_DATA) / 4] = val;
+        return;
+    }
+    switch (reg) {
+        case REG_OWNER:         mb->owner = val; break;
+        case REG_INT_ENABLE:    mb->int_enable = val; break;
+        case REG_INT_CLEAR:     mb->int_status &= ~val; break;
+        case REG_INT_SET:       mbox_set_ints(ip, mb, val); break;
+        case REG_DESTINATION:   mb->dest = val; break;
+        default:                break;
+    }
+}
+
+static uint32_t uart_read(uintptr_t off)
+{
+    switch (off) {
+        case UART_SR:   return UART_SR_TXEMPTY; // drains instantly
+        case UART_FIFO: return 0;               // no RX
+        default:        return uart.regs[off / 4];
+    }
+}
+
+static void uart_write(uintptr_t off, uint32_t val)
+{
+    switch (off) {
+        case UART_CR:
+            uart.regs[off / 4] = val & ~UART_CR_RESETS;
+            break;
+        case UART_FIFO:
+            uart.tx_bytes++;
+            if (!uart.mute)
+                putchar(val & 0xff);
+            break;
+        default:
+            uart.regs[off / 4] = val;
+            break;
+    }
+}
+
+uint32_t mmio_read32(volatile uint32_t *addr)
+{
+    uintptr_t a = (uintptr_t)addr;
+    struct mbox_ip *ip;
+
+    if (a >= UART_BASE && a < UART_BASE + UART_SIZE)
+        return uart_read(a - UART_BASE);
+    if ((ip = find_ip(a)))
+        return mbox_read(ip, a - ip->base);
+    fatal("read of unmodelled address", addr);
+    return 0;
+}
+
+void mmio_write32(volatile uint32_t *addr, uint32_t val)
+{
+    uintptr_t a = (uintptr_t)addr;
+    struct mbox_ip *ip;
+
+    if (a >= UART_BASE && a < UART_BASE + UART_SIZE) {
+        uart_write(a - UART_BASE, val);
+        return;
+    }
+    if ((ip = find_ip(a))) {
+        mbox_write(ip, a - ip->base, val);
+        deliver_irqs();
+        return;
+    }
+    fatal("write to unmodelled address", addr);
+}
+
+void mbox_model_attach_server(volatile uint32_t *ip_base, unsigned instance,
+                              uint32_t owner, uint32_t dest, mbox_model_server_t server)
+{
+    struct mbox_instance *mb = &ip_by_base(ip_base)->inst[instance];
+    mb->owner = owner;
+    mb->dest = dest;
+    mb->int_enable |= HPSC_MBOX_INT_A;
+    mb->server = server;
+}
+
+void mbox_model_attach_client(volatile uint32_t *ip_base, unsigned instance,
+                              mbox_model_client_t client)
+{
+    struct mbox_instance *mb = &ip_by_base(ip_base)->inst[instance];
+    mb->int_enable |= HPSC_MBOX_INT_B;
+    mb->client = client;
+}
+
+int mbox_model_request(volatile uint32_t *ip_base, unsigned instance,
+                       const uint32_t *msg, size_t len)
+{
+    struct mbox_ip *ip = ip_by_base(ip_base);
+    struct mbox_instance *mb = &ip->inst[instance];
+    size_t i;
+
+    if (len > HPSC_MBOX_DATA_REGS || (mb->int_status & HPSC_MBOX_INT_A))
+        return 1;
+    for (i = 0; i < len; ++i)
+        mb->data[i] = msg[i];
+    mbox_set_ints(ip, mb, HPSC_MBOX_INT_A);
+    deliver_irqs();
+    return 0;
+}
+
+void uart_model_mute(bool mute)
+{
+    fflush(stdout);
+    uart.mute = mute;
+}
+
+unsigned long uart_model_tx_bytes(void)
+{
+    return uart.tx_bytes;
+}
+
+static void cache_record(struct cache_ranges *rs, const void *buf, size_t len)
+{
+    struct cache_range *r = &rs->range[rs->next++ % CACHE_MODEL_RANGES];
+    r->start = (uintptr_t)buf;
+    r->end = (uintptr_t)buf + len;
+}
+
+static bool cache_covered(const struct cache_ranges *rs, const void *addr, size_t len)
+{
+    uintptr_t a = (uintptr_t)addr, end = a + len;
+    unsigned i;
+
+    while (a < end) {
+        for (i = 0; i < CACHE_MODEL_RANGES; ++i)
+            if (a >= rs->range[i].start && a < rs->range[i].end)
+                break;
+        if (i == CACHE_MODEL_RANGES)
+            return false;
+        a++;
+    }
+    return true;
+}
+
+void shbuf_release(const void *buf, size_t len)
+{
+    cache_record(&cache_released, buf, len);
+}
+
+void shbuf_acquire(void *buf, size_t len)
+{
+    cache_record(&cache_acquired, buf, len);
+}
+
+bool cache_model_released(const void *addr, size_t len)
+{
+    return cache_covered(&cache_released, addr, len);
+}
+
+bool cache_model_acquired(const void *addr, size_t len)
+{
+    return cache_covered(&cache_acquired, addr, len);
+}
+
+void timer_model_poll(void)
+{
+    const uint32_t fired = CNTP_CTL_ENABLE | CNTP_CTL_ISTATUS;
+
+    if ((timer_ctl() & (fired | CNTP_CTL_IMASK)) == fired) {
+        raise_irq(GIC_IRQ(TIMER_PPI));
+        deliver_irqs();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef MMIO_MODEL_H
+#define MMIO_MODEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Software models of the devices behind mmio_read32()/mmio_write32() in
+// the host build: the Cadence UART at 0x30001000 and the HPSC mailbox IP
+// blocks at RTPS_TRCH/HPPS_RTPS/HPPS_TRCH_MBOX_BASE.
+//
+// A mailbox interrupt (INT A or B set on an instance with the interrupt
+// enabled) is delivered to irq_handler() with the IRQ number of the IP, like
+// the GIC would, after the register write that raised it has completed.
+// Interrupts are not nested: one raised from an ISR is delivered after it.
+//
+// The far side of a mailbox (TRCH or HPPS) is played by the model: a remote
+// server answers requests (INT A) with a reply (INT B), a remote client
+// sends requests and receives the replies.
+
+typedef void (*mbox_model_server_t)(const uint32_t *req, uint32_t *reply, size_t *reply_len);
+typedef void (*mbox_model_client_t)(unsigned instance, const uint32_t *reply);
+
+// IRQ dispatch of the firmware (main.c on target, host_main.c on host)
+void irq_handler(unsigned irq);
+
+void mbox_model_attach_server(volatile uint32_t *ip_base, unsigned instance,
+                              uint32_t owner, uint32_t dest, mbox_model_server_t server);
+void mbox_model_attach_client(volatile uint32_t *ip_base, unsigned instance,
+                              mbox_model_client_t client);
+int mbox_model_request(volatile uint32_t *ip_base, unsigned instance,
+                       const uint32_t *msg, size_t len);
+
+// EL1 physical timer (timer.h): delivers its interrupt to irq_handler()
+// if it fired, called by the host loops as the GIC would interrupt
+void timer_model_poll(void);
+
+// Whether each byte of [addr, addr + len) was handed to the other side with
+// shbuf_release() (cache.h), or taken back with shbuf_acquire(), in the
+// last CACHE_MODEL_RANGES calls of each: the host has no cache to maintain,
+// the model keeps the ranges
+#define CACHE_MODEL_RANGES 16
+bool cache_model_released(const void *addr, size_t len);
+bool cache_model_acquired(const void *addr, size_t len);
+
+// Discard the UART output (for benchmarks), the bytes are still counted
+void uart_model_mute(bool mute);
+unsigned long uart_model_tx_bytes(void);
+
+#endif // MMIO_MODEL_H
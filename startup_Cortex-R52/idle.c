@@ -0,0 +1,233 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "atomic.h"
+#include "intr.h"
+#include "idle.h"
+#include "coro.h"
+
+#define IDLE_FOREVER    UINT64_MAX
+#define IDLE_GAP_MAX    0x0fffffff // inter-arrival samples are clamped to this
+#define IDLE_BENCH_RUNS 16
+#define IDLE_BENCH_US   1000       // timer deadline for idle_bench()
+
+#define ISR_I           (1 << 7)   // IRQ pending (ISR)
+
+struct idle_stats {
+    uint32_t entries;
+    uint64_t residency;     // ticks spent in the state
+    uint32_t lat_samples;   // wake-ups by the timer deadline
+    uint64_t lat_sum;
+    uint32_t lat_max;
+    uint32_t lat;           // EWMA of the above, used by the governor
+};
+
+static const char * const idle_names[IDLE_STATES] = {
+    [IDLE_SPIN] = "spin",
+    [IDLE_WFE]  = "wfe",
+    [IDLE_WFI]  = "wfi",
+};
+
+static struct idle_stats idle_stats[IDLE_STATES];
+static uint32_t idle_lat_limit = IDLE_NO_LIMIT;
+static int idle_forced = IDLE_GOVERNOR;
+
+static bool irq_seen;
+static uint64_t irq_last;   // time of the last irq_handler() entry
+static uint32_t irq_gap;    // EWMA of the time between IRQs, 0 until known
+
+static int wake_state = IDLE_STATES; // state of the idle period just ended
+static volatile uint32_t timer_wakeups; // on bench_deadline, by idle_timer_isr()
+static volatile uint64_t bench_deadline; // of the idle_bench() run, 0 if none
+
+static inline uint32_t ewma(uint32_t avg, uint32_t sample)
+{
+    return avg - (avg >> IDLE_EWMA_SHIFT) + (sample >> IDLE_EWMA_SHIFT);
+}
+
+static inline bool irq_pending(void)
+{
+    uint32_t isr;
+    __asm__ __volatile__("mrc p15, 0, %0, c12, c1, 0" : "=r" (isr) : : "memory"); // ISR
+    return isr & ISR_I;
+}
+
+void idle_init(void)
+{
+    uint32_t freq = timer_freq(), ticks, bit, kctl;
+
+    // An event every 2^(bit + 1) ticks, the largest no longer than IDLE_EVENT_NS
+    ticks = (uint32_t)((uint64_t)freq * IDLE_EVENT_NS / 1000000000);
+    for (bit = 0; bit < 15 && (2u << (bit + 1)) <= ticks; ++bit)
+        ;
+    __asm__ __volatile__("mrc p15, 0, %0, c14, c1, 0" : "=r" (kctl)); // CNTKCTL
+    kctl = (kctl & ~CNTKCTL_EVNTI_MASK) | CNTKCTL_EVNTEN | (bit << CNTKCTL_EVNTI_SHIFT);
+    __asm__ __volatile__("mcr p15, 0, %0, c14, c1, 0" : : "r" (kctl));
+    __asm__ __volatile__("isb");
+}
+
+// Returns the state to enter at now, and in until when the idle period is
+// expected to end (by the timer deadline or the next predicted IRQ)
+static enum idle_state idle_select(uint64_t now, uint64_t *until)
+{
+    uint64_t end = IDLE_FOREVER, cval, expected;
+    int s;
+
+    if (timer_deadline(&cval))
+        end = cval;
+    // An IRQ later than predicted leaves no prediction, rather than
+    // predicting one any moment from then on
+    if (irq_gap && irq_last + irq_gap > now && irq_last + irq_gap < end)
+        end = irq_last + irq_gap;
+    *until = end;
+
+    if (idle_forced != IDLE_GOVERNOR)
+        return idle_forced;
+
+    expected = end > now ? end - now : 0;
+    for (s = IDLE_STATES - 1; s > IDLE_SPIN; --s)
+        if (idle_stats[s].lat <= idle_lat_limit &&
+            (uint64_t)idle_stats[s].lat * IDLE_RESIDENCY_FACTOR <= expected)
+            return s;
+    return IDLE_SPIN;
+}
+
+void idle_enter(void)
+{
+    uint64_t start = timer_now(), until;
+    enum idle_state s = idle_select(start, &until);
+
+    switch (s) {
+        case IDLE_SPIN:
+            while (!irq_pending() && timer_now() < until)
+                ;
+            break;
+        case IDLE_WFE:
+            // The event register may be set already: then the first WFE
+            // returns at once, and we poll and wait again
+            while (!irq_pending() && timer_now() < until)
+                wfe();
+            break;
+        default:
+            // Wakes on a pending IRQ even with IRQs masked
+            __asm__ __volatile__("dsb\n"
+                                 "wfi" : : : "memory");
+            break;
+    }
+
+    idle_stats[s].entries++;
+    idle_stats[s].residency += timer_now() - start;
+    wake_state = s;
+}
+
+void idle_irq(void)
+{
+    uint64_t now = timer_now(), gap;
+    uint32_t lat;
+    struct idle_stats *st;
+
+    if (irq_seen) {
+        gap = now - irq_last;
+        if (gap > IDLE_GAP_MAX)
+            gap = IDLE_GAP_MAX;
+        irq_gap = irq_gap ? ewma(irq_gap, gap) : gap;
+    }
+    irq_seen = true;
+    irq_last = now;
+
+    // Only the timer tells when the core should have woken up
+    if (wake_state != IDLE_STATES &&
+        (timer_ctl() & (CNTP_CTL_ENABLE | CNTP_CTL_ISTATUS)) == (CNTP_CTL_ENABLE | CNTP_CTL_ISTATUS) &&
+        now >= timer_cval()) {
+        st = &idle_stats[wake_state];
+        lat = now - timer_cval();
+        st->lat = st->lat_samples ? ewma(st->lat, lat) : lat;
+        st->lat_samples++;
+        st->lat_sum += lat;
+        if (lat > st->lat_max)
+            st->lat_max = lat;
+    }
+    wake_state = IDLE_STATES;
+}
+
+void idle_timer_isr(void)
+{
+    timer_disarm();
+    // Coroutine timeouts share the timer: only the bench's deadline counts
+    if (bench_deadline && timer_now() >= bench_deadline) {
+        bench_deadline = 0;
+        timer_wakeups++;
+    }
+}
+
+void idle_set_latency_limit(uint32_t ticks)
+{
+    idle_lat_limit = ticks;
+}
+
+void idle_force(int state)
+{
+    idle_forced = state;
+}
+
+void idle_report(void)
+{
+    enum idle_state s;
+    struct idle_stats *st;
+
+    printf("idle: ticks at %lu Hz, IRQ inter-arrival EWMA %lu, latency limit %lu\r\n",
+           timer_freq(), irq_gap, idle_lat_limit);
+    printf("  %-5s %8s %16s %8s %8s %8s %8s\r\n",
+           "state", "entries", "residency", "wakeups", "lat avg", "lat max", "lat ewma");
+    for (s = 0; s < IDLE_STATES; ++s) {
+        st = &idle_stats[s];
+        printf("  %-5s %8lu %16llu %8lu %8lu %8lu %8lu\r\n", idle_names[s],
+               st->entries, st->residency, st->lat_samples,
+               st->lat_samples ? (uint32_t)(st->lat_sum / st->lat_samples) : 0,
+               st->lat_max, st->lat);
+    }
+}
+
+void idle_bench(void)
+{
+    uint32_t period = (uint32_t)((uint64_t)timer_freq() * IDLE_BENCH_US / 1000000);
+    uint32_t irq, wakeups = timer_wakeups;
+    uint64_t deadline, cval;
+    unsigned s, i;
+
+    gic_enable_ppi(TIMER_PPI);
+    for (s = 0; s < IDLE_STATES; ++s) {
+        idle_force(s);
+        for (i = 0; i < IDLE_BENCH_RUNS; ) {
+            irq = intr_save();
+            deadline = timer_now() + period;
+            // A deadline due first keeps the timer: a coroutine timeout (that
+            // period ends on it, coro_timer_isr() re-arms, the run is repeated)
+            // or the previous run's, if another IRQ ended it early
+            if (!timer_deadline(&cval) || cval >= deadline) {
+                bench_deadline = deadline;
+                timer_arm(deadline);
+                ++i;
+            }
+            idle_enter();
+            intr_restore(irq); // the timer IRQ is taken here
+        }
+    }
+    // The last run may have ended on another IRQ: wait for its deadline
+    irq = intr_save();
+    while (bench_deadline) {
+        idle_enter();
+        intr_restore(irq);
+        irq = intr_save();
+    }
+    idle_force(IDLE_GOVERNOR);
+    // Back to the coroutine timeouts (coro_timer_isr() did on the last IRQ)
+    coro_timer_rearm();
+    intr_restore(irq);
+
+    if (timer_wakeups - wakeups != IDLE_STATES * IDLE_BENCH_RUNS)
+        printf("ERROR: idle: %lu timer interrupts, expected %u\r\n",
+               timer_wakeups - wakeups, IDLE_STATES * IDLE_BENCH_RUNS);
+    idle_report();
+}
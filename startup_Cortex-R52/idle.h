@@ -0,0 +1,69 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+#include "gic.h"
+#include "timer.h"
+
+// Idle governor for the main loop. Each time there is nothing to do it
+// picks one of three idle states by how long the core is expected to stay
+// idle: until the nearer of the timer deadline (CNTP_CVAL, if armed) and
+// the next interrupt predicted by an EWMA of recent inter-arrival times.
+//
+//     SPIN  poll for a pending IRQ: no wake-up cost, full power
+//     WFE   sleep in WFE, woken by the timer event stream every
+//           IDLE_EVENT_NS to poll: wake-up cost of WFE plus up to a period
+//     WFI   clock gated until an interrupt: lowest power, slowest wake-up
+//
+// The deepest state is taken whose exit latency is within the limit set
+// with idle_set_latency_limit() and at most 1/IDLE_RESIDENCY_FACTOR of the
+// expected idle time. Exit latencies are measured, from the deadline to
+// the entry of irq_handler(), whenever the armed timer is what ended an
+// idle period (idle_bench() forces such periods in each state). Until a
+// state has been measured its latency is taken as 0, so with no deadlines
+// and no history the governor picks WFI, as the main loop did before.
+//
+// Time in each state and wake-up latencies are accounted per state, in
+// generic timer ticks (timer.h), and printed by idle_report().
+
+enum idle_state {
+    IDLE_SPIN,
+    IDLE_WFE,
+    IDLE_WFI,
+    IDLE_STATES,
+};
+
+#define IDLE_NO_LIMIT           0xffffffff
+#define IDLE_GOVERNOR           (-1) // for idle_force()
+
+#define IDLE_EVENT_NS           1000 // WFE event stream period (rounded to a power of 2 ticks)
+#define IDLE_RESIDENCY_FACTOR   4    // a state must be expected to last this many exit latencies
+#define IDLE_EWMA_SHIFT         3    // EWMA weight of a new sample: 1/8
+
+#define IDLE_TIMER_IRQ          GIC_IRQ(TIMER_PPI)
+
+// Enables the WFE event stream
+void idle_init(void);
+
+// Call with IRQs masked, after checking that there is nothing to do; returns
+// with IRQs still masked, the IRQ that ended the idle period (if any) is
+// taken on unmasking them
+void idle_enter(void);
+
+// First thing in irq_handler(): inter-arrival times and wake-up latency
+void idle_irq(void);
+// Handler of IDLE_TIMER_IRQ, disarms the timer
+void idle_timer_isr(void);
+
+// Worst wake-up latency acceptable, in ticks, or IDLE_NO_LIMIT
+void idle_set_latency_limit(uint32_t ticks);
+// Always enter this state, or IDLE_GOVERNOR to let the governor choose
+void idle_force(int state);
+
+void idle_report(void);
+// Measures the wake-up latency of each state on timer deadlines and reports.
+// Shares the timer with the coroutine timeouts (coro.h), re-armed at the end.
+void idle_bench(void);
+
+#endif // IDLE_H
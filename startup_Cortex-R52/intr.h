@@ -0,0 +1,41 @@
+#ifndef INTR_H
+#define INTR_H
+
+#include <stdint.h>
+
+// Mask IRQs on this core, returns the previous state for intr_restore().
+// Nestable, hence usable from ISRs as well as from thread context.
+#ifdef HOST
+// Host build: the device models deliver interrupts synchronously, never
+// in the middle of a critical section
+static inline uint32_t intr_save(void)
+{
+    return 0;
+}
+
+static inline void intr_restore(uint32_t cpsr)
+{
+    (void)cpsr;
+}
+#else // !HOST
+static inline uint32_t intr_save(void)
+{
+    uint32_t cpsr;
+    __asm__ __volatile__("mrs %0, cpsr\n"
+                         "cpsid i"
+                         : "=r" (cpsr)
+                         :
+                         : "memory");
+    return cpsr;
+}
+
+static inline void intr_restore(uint32_t cpsr)
+{
+    __asm__ __volatile__("msr cpsr_c, %0"
+                         :
+                         : "r" (cpsr)
+                         : "memory");
+}
+#endif // !HOST
+
+#endif // INTR_H
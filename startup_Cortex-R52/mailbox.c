@@ -1,10 +1,24 @@
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "printf.h"
 #include "mailbox.h"
+#include "mmio.h"
+#include "intr.h"
+#include "pool.h"
+#include "spinlock.h"
+#include "event.h"
 
 #define OFFSET_PAYLOAD 4
 
+// Register-level trace (make IRQ_DEBUG=1): much of it runs in the ISRs,
+// which otherwise only ack the hardware and post events
+#ifdef IRQ_DEBUG
+#define mbox_dbg(...) printf(__VA_ARGS__)
+#else
+#define mbox_dbg(...) do { } while (0)
+#endif
+
 #define MAX_HW_INSTANCES 128
 
 typedef struct mbox_state {
@@ -13,31 +27,81 @@ typedef struct mbox_state {
         unsigned instance;
         cb_t cb;
         void *cb_arg;
+        uint32_t polled;    // interrupts masked and polled by mbox_poll()
+        unsigned idle;      // consecutive empty polls
+        unsigned prio;      // MBOX_PRIO_*, serviced in this order
 } mbox_t;
 
 static mbox_t mboxes[MAX_HW_INSTANCES];
 static unsigned num_mboxes = 0; // number of registered HW mailbox instancees
+static struct rwlock mboxes_lock = RWLOCK_INIT; // looked up from ISRs, hence irqsave
+
+static struct mbox_poll_config poll_config = {
+    .budget = MBOX_POLL_BUDGET,
+    .idle_polls = MBOX_POLL_IDLE,
+};
+static struct mbox_poll_stats poll_stats;
+static unsigned num_polled; // instances in polling mode
+
+// Polling runs from the event loop: posted by the ISR when it switches an
+// instance to polling, and again by the handler while any instance is
+// polled. One event per mailbox priority, so that urgent instances get
+// their first poll ahead of other work.
+static void mbox_poll_event(void *arg);
+static const unsigned mbox_event_prio[MBOX_PRIOS] = {
+    [MBOX_PRIO_URGENT] = EVENT_PRIO_HIGH,
+    [MBOX_PRIO_BULK]   = EVENT_PRIO_NORMAL,
+};
+static struct event mbox_events[MBOX_PRIOS] = {
+    [MBOX_PRIO_URGENT] = EVENT_INIT(mbox_poll_event, (void *)MBOX_PRIO_URGENT),
+    [MBOX_PRIO_BULK]   = EVENT_INIT(mbox_poll_event, (void *)MBOX_PRIO_BULK),
+};
 
 static mbox_t *alloc_mbox(volatile uint32_t *ip_base, unsigned instance, cb_t cb, void *cb_arg)
 {
-    if (num_mboxes == MAX_HW_INSTANCES)
-        return NULL;
-    mboxes[num_mboxes].ip_base = ip_base;
-    mboxes[num_mboxes].instance = instance;
-    mboxes[num_mboxes].base = (volatile uint32_t *)((uint8_t *)ip_base + instance * HPSC_MBOX_INSTANCE_REGION);
-    mboxes[num_mboxes].cb = cb;
-    mboxes[num_mboxes].cb_arg = cb_arg;
-    num_mboxes++;
-    return &mboxes[num_mboxes - 1];
+    mbox_t *mbox = NULL;
+    uint32_t flags = write_lock_irqsave(&mboxes_lock);
+    if (num_mboxes < MAX_HW_INSTANCES) {
+        mbox = &mboxes[num_mboxes];
+        mbox->ip_base = ip_base;
+        mbox->instance = instance;
+        mbox->base = (volatile uint32_t *)((uint8_t *)ip_base + instance * HPSC_MBOX_INSTANCE_REGION);
+        mbox->cb = cb;
+        mbox->cb_arg = cb_arg;
+        mbox->polled = 0;
+        mbox->idle = 0;
+        mbox->prio = MBOX_PRIO_BULK;
+        num_mboxes++;
+    }
+    write_unlock_irqrestore(&mboxes_lock, flags);
+    return mbox;
 }
 
+// Entries are never removed, so the returned pointer stays valid after unlock
 static mbox_t *find_mbox(volatile uint32_t *ip_base, unsigned instance)
 {
+   mbox_t *mbox = NULL;
    unsigned i;
-   for (i = 0; i < num_mboxes; ++i)
-       if (mboxes[i].ip_base == ip_base && mboxes[i].instance == instance)
-           return &mboxes[i];
-   return NULL;
+   uint32_t flags = read_lock_irqsave(&mboxes_lock);
+   for (i = 0; i < num_mboxes; ++i) {
+       if (mboxes[i].ip_base == ip_base && mboxes[i].instance == instance) {
+           mbox = &mboxes[i];
+           break;
+       }
+   }
+   read_unlock_irqrestore(&mboxes_lock, flags);
+   return mbox;
+}
+
+int mbox_set_prio(volatile uint32_t *ip_base, unsigned instance, unsigned prio)
+{
+    mbox_t *mbox = find_mbox(ip_base, instance);
+    if (!mbox || prio >= MBOX_PRIOS) {
+        printf("ERROR: mbox_set_prio: no mailbox instance %u or bad prio %u\r\n", instance, prio);
+        return 1;
+    }
+    mbox->prio = prio;
+    return 0;
 }
 
 int mbox_init_server(volatile uint32_t * ip_base, unsigned instance, uint32_t owner, uint32_t dest, cb_t req_cb, void *cb_arg)
@@ -52,17 +116,17 @@ int mbox_init_server(volatile uint32_t * ip_base, unsigned instance, uint32_t ow
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)base + REG_OWNER);
     uint32_t val = owner;
     printf("mbox_init: owner: %p <|- %08lx\r\n", addr, val);
-    *addr = val;
+    mmio_write32(addr, val);
 
     addr = (volatile uint32_t *)((uint8_t *)base + REG_DESTINATION);
     val = dest;
     printf("mbox_init: dest: %p <|- %08lx\r\n", addr, val);
-    *addr = val;
+    mmio_write32(addr, val);
 
     addr = (volatile uint32_t *)((uint8_t *)base + REG_INT_ENABLE);
     val = HPSC_MBOX_INT_A;
     printf("mbox_init: int A en: %p <|- %08lx\r\n", addr, val);
-    *addr |= val;
+    mmio_write32(addr, mmio_read32(addr) | val);
     return 0;
 }
 
@@ -75,7 +139,7 @@ int mbox_init_client(volatile uint32_t * ip_base, unsigned instance, uint32_t de
     volatile uint32_t *base = (volatile uint32_t *)((uint8_t *)ip_base + instance * HPSC_MBOX_INSTANCE_REGION);
 
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)base + REG_DESTINATION);
-    if (*addr != dest) {
+    if (mmio_read32(addr) != dest) {
         printf("mbox_init_dest: we are not the destination\r\n");
         return 1;
     }
@@ -83,7 +147,7 @@ int mbox_init_client(volatile uint32_t * ip_base, unsigned instance, uint32_t de
     addr = (volatile uint32_t *)((uint8_t *)base + REG_INT_ENABLE);
     uint32_t val = HPSC_MBOX_INT_B;
     printf("mbox_init: int B en: %p <|- %08lx\r\n", addr, val);
-    *addr |= val;
+    mmio_write32(addr, mmio_read32(addr) | val);
     return 0;
 }
 
@@ -95,7 +159,7 @@ static void mbox_send(volatile uint32_t *base, uint32_t *msg, size_t len, uint32
     // Prevent another request before the reply (receiver holds A high while replying)
     printf("mbox_request: waiting for INT A to fall...\r\n");
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)base + REG_INT_STATUS);
-    while (*addr & HPSC_MBOX_INT_A);
+    while (mmio_read32(addr) & HPSC_MBOX_INT_A);
     printf("mbox_request: INT A low\r\n");
 #endif
 
@@ -104,67 +168,256 @@ static void mbox_send(volatile uint32_t *base, uint32_t *msg, size_t len, uint32
         return;
     }
 
-    printf("mbox_request: writing msg: ");
+    mbox_dbg("mbox_request: writing msg: ");
     volatile uint32_t *slot = (volatile uint32_t *)((uint8_t *)base + REG_DATA);
     for (i = 0; i < len; ++i) {
-        slot[i] = msg[i];
-        printf("%x ", msg[i]);
+        mmio_write32(&slot[i], msg[i]);
+        mbox_dbg("%x ", msg[i]);
     }
-    printf("\r\n");
+    mbox_dbg("\r\n");
 
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)base + REG_INT_SET);
     uint32_t val = mbox_int;
-    printf("mbox_request: raise int %u: %p <- %08lx\r\n", mbox_int, addr, val);
-    *addr = val;
+    mbox_dbg("mbox_request: raise int %u: %p <- %08lx\r\n", mbox_int, addr, val);
+    mmio_write32(addr, val);
 
     // for blocking on send: async wait for INT B (or wait for clearing of INT_A)?
     // TODO: timeout, in order to clear A (since receiver failed to clear it)
 }
 
-static void mbox_receive(mbox_t *mbox, unsigned mbox_int)
+// We don't have to copy, but let's copy for simplicity and to go over the
+// bus to the IP block only once
+static void mbox_read(mbox_t *mbox, uint32_t *msg)
 {
-    uint32_t msg[HPSC_MBOX_DATA_REGS];    
-
-    // We don't have to copy, but let's copy for simplicity and to go over the
-    // bus to the IP block only once
-    printf("mbox_receive: rcved: ", msg);
     volatile uint32_t *data = (volatile uint32_t *)((uint8_t *)mbox->base + REG_DATA);
     int len;
-    for (len = 0; len < HPSC_MBOX_DATA_REGS; len++) {
-        msg[len] = *data++; 
-        printf("%x ", msg[len]);
-    }
-    printf("\r\n");
 
-    mbox->cb(mbox->cb_arg, mbox->base, &msg[0]);
+    for (len = 0; len < HPSC_MBOX_DATA_REGS; len++)
+        msg[len] = mmio_read32(data++);
+}
 
+static void mbox_ack(mbox_t *mbox, unsigned mbox_int)
+{
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)mbox->base + REG_INT_CLEAR);
     uint32_t val = mbox_int;
-    printf("mbox_receive: clear int %u: %p <- %08lx\r\n", mbox_int, addr, val);
-    *addr = val;
+    mbox_dbg("mbox_receive: clear int %u: %p <- %08lx\r\n", mbox_int, addr, val);
+    mmio_write32(addr, val);
+}
+
+// Hands a message read from mbox to its callback, then acks it: the sender
+// sees the instance free only once the callback is done with it
+static void mbox_deliver(mbox_t *mbox, unsigned mbox_int, uint32_t *msg)
+{
+#ifdef IRQ_DEBUG
+    int len;
+
+    mbox_dbg("mbox_receive: rcved: ");
+    for (len = 0; len < HPSC_MBOX_DATA_REGS; len++)
+        mbox_dbg("%x ", msg[len]);
+    mbox_dbg("\r\n");
+#endif
+
+    mbox->cb(mbox->cb_arg, mbox->base, &msg[0]);
+    mbox_ack(mbox, mbox_int);
+}
+
+static void mbox_receive(mbox_t *mbox, unsigned mbox_int)
+{
+    uint32_t *msg = pool_alloc(HPSC_MBOX_DATA_REGS * sizeof(uint32_t));
+
+    if (!msg) { // ack anyway: left pending, the interrupt would fire again at once
+        printf("ERROR: mbox_receive: no buffer, message dropped: instance %u\r\n",
+               mbox->instance);
+        poll_stats.dropped++;
+        mbox_ack(mbox, mbox_int);
+        return;
+    }
+    mbox_read(mbox, msg);
+    mbox_deliver(mbox, mbox_int, msg);
+    pool_free(msg);
+}
+
+// Switch an instance from interrupts to polling (NAPI style): the message
+// that raised the interrupt and the following ones under a burst are
+// received by mbox_poll(), from the event loop, without an interrupt each.
+// Returns false if polling is disabled. Called with IRQs masked.
+static bool mbox_poll_start(mbox_t *mbox, uint32_t mbox_int)
+{
+    volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)mbox->base + REG_INT_ENABLE);
+
+    if (!poll_config.budget)
+        return false;
+    if (!(mbox->polled & mbox_int)) {
+        mmio_write32(addr, mmio_read32(addr) & ~mbox_int);
+        if (!mbox->polled)
+            num_polled++;
+        mbox->polled |= mbox_int;
+        mbox->idle = 0;
+    }
+    event_post(&mbox_events[mbox->prio], mbox_event_prio[mbox->prio]);
+    return true;
+}
+
+// Back to interrupts after idle_polls empty polls. A message that arrived
+// while masked raises no interrupt when unmasked, so check once more and
+// keep polling if there is one. Called with IRQs masked.
+static void mbox_poll_stop(mbox_t *mbox, uint32_t mbox_int)
+{
+    volatile uint32_t *enable = (volatile uint32_t *)((uint8_t *)mbox->base + REG_INT_ENABLE);
+    volatile uint32_t *status = (volatile uint32_t *)((uint8_t *)mbox->base + REG_INT_STATUS);
+
+    mmio_write32(enable, mmio_read32(enable) | mbox_int);
+    if (mmio_read32(status) & mbox_int) {
+        mmio_write32(enable, mmio_read32(enable) & ~mbox_int);
+        mbox->idle = 0;
+        poll_stats.rearm_races++;
+        return;
+    }
+    mbox->polled &= ~mbox_int;
+    if (!mbox->polled)
+        num_polled--;
+    poll_stats.unmasks++;
 }
+
 static void mbox_isr(volatile uint32_t *ip_base, unsigned mbox_int)
 {
     unsigned reg_instances = mbox_int == HPSC_MBOX_INT_B ? REG_INT_B_INSTANCES : REG_INT_A_INSTANCES;
     volatile uint32_t *addr = (volatile uint32_t *)((uint8_t *)ip_base + reg_instances);
-    uint32_t val = *addr;
-    int i;
+    uint32_t val = mmio_read32(addr);
+    mbox_t *pending[HPSC_MBOX_INSTANCES]; // in instance order
+    unsigned prio, n = 0, i;
 
-    printf("MBOX ISR (%u): int instances: %p -> %08lx\r\n", mbox_int, addr, val);
+    mbox_dbg("MBOX ISR (%u): int instances: %p -> %08lx\r\n", mbox_int, addr, val);
+    poll_stats.irqs++;
 
+    // Each pending instance looked up once (find_mbox() takes the lock)
     for (i = 0; i < HPSC_MBOX_INSTANCES; ++i) { // could be replaced with find-first-set-bit instruction
-        if (val & (1 << i)) {
-            volatile uint32_t *base = (volatile uint32_t *)((uint8_t *)ip_base + i * HPSC_MBOX_INSTANCE_REGION);
-            printf("MBOX ISR (%u): int instance %u: %p\r\n", mbox_int, i, base);
-
-            mbox_t *mbox = find_mbox(ip_base, i);
-            if (!mbox) {
+        if (val & (1u << i)) {
+            pending[n] = find_mbox(ip_base, i);
+            if (!pending[n]) {
                 printf("ERROR: cannot find mailbox by base addr: %p\r\n", ip_base);
                 return;
             }
+            n++;
+        }
+    }
+
+    // Urgent instances first, then the rest
+    for (prio = 0; prio < MBOX_PRIOS; ++prio) {
+        for (i = 0; i < n; ++i) {
+            mbox_t *mbox = pending[i];
+            if (mbox->prio != prio)
+                continue;
+            mbox_dbg("MBOX ISR (%u): int instance %u: %p\r\n", mbox_int, mbox->instance, mbox->base);
+            if (mbox_poll_start(mbox, mbox_int))
+                continue; // received from the event loop
             mbox_receive(mbox, mbox_int);
+            poll_stats.irq_msgs++;
+        }
+    }
+}
+
+// Receive up to budget messages on instances in polling mode. Returns the
+// number of messages received.
+unsigned mbox_poll(void)
+{
+    static const uint32_t ints[HPSC_MBOX_INTS] = { HPSC_MBOX_INT_A, HPSC_MBOX_INT_B };
+    // With polling disabled, drain and unmask what is still being polled
+    const unsigned budget = poll_config.budget ? poll_config.budget : ~0u;
+    const unsigned idle_polls = poll_config.budget ? poll_config.idle_polls : 0;
+    unsigned work = 0, prio, i, j;
+    bool pending = true;
+    uint32_t msg[HPSC_MBOX_DATA_REGS]; // thread context, not the ISR stack
+
+    if (!num_polled)
+        return 0;
+
+    // Rounds over the polled instances, at most one message per instance
+    // per round, urgent instances first in each round, until the budget is
+    // spent or none has a message. Entries are never removed, see
+    // find_mbox().
+    while (pending && work < budget) {
+        pending = false;
+        for (prio = 0; prio < MBOX_PRIOS; ++prio) {
+            for (i = 0; i < num_mboxes && work < budget; ++i) {
+                mbox_t *mbox = &mboxes[i];
+                if (mbox->prio != prio)
+                    continue;
+                for (j = 0; j < HPSC_MBOX_INTS; ++j) {
+                    // Only the check and the copy with IRQs masked (against
+                    // mbox_poll_start() in the ISR): the callback runs with
+                    // IRQs enabled, while the interrupt of this instance
+                    // stays masked in the IP until the next poll_stop
+                    bool got = false;
+                    uint32_t irq = intr_save();
+                    if (mbox->polled & ints[j]) {
+                        volatile uint32_t *status = (volatile uint32_t *)((uint8_t *)mbox->base + REG_INT_STATUS);
+                        if (mmio_read32(status) & ints[j]) {
+                            mbox_read(mbox, msg);
+                            mbox->idle = 0;
+                            got = true;
+                        }
+                    }
+                    intr_restore(irq);
+                    if (got) {
+                        mbox_deliver(mbox, ints[j], msg);
+                        poll_stats.polled_msgs++;
+                        pending = true;
+                        work++;
+                    }
+                }
+            }
+        }
+    }
+    if (work >= budget) {
+        poll_stats.budget_exhausted++;
+        return work;
+    }
+
+    // Nothing left: count an idle poll, unmask the instances idle long enough
+    for (i = 0; i < num_mboxes; ++i) {
+        mbox_t *mbox = &mboxes[i];
+        uint32_t irq = intr_save();
+        if (mbox->polled && ++mbox->idle >= idle_polls) {
+            for (j = 0; j < HPSC_MBOX_INTS; ++j)
+                if (mbox->polled & ints[j])
+                    mbox_poll_stop(mbox, ints[j]);
         }
+        intr_restore(irq);
     }
+    return work;
+}
+
+static void mbox_poll_event(void *arg)
+{
+    unsigned prio = (unsigned)(uintptr_t)arg;
+
+    mbox_poll();
+    if (num_polled)
+        event_post(&mbox_events[prio], mbox_event_prio[prio]);
+}
+
+unsigned mbox_polling(void)
+{
+    return num_polled;
+}
+
+void mbox_poll_configure(const struct mbox_poll_config *config)
+{
+    poll_config = *config;
+}
+
+void mbox_poll_get_stats(struct mbox_poll_stats *stats)
+{
+    *stats = poll_stats;
+}
+
+void mbox_poll_report(void)
+{
+    printf("mbox poll: irqs %u, msgs by irq %u, by poll %u, budget exhausted %u, unmasks %u, rearm races %u, dropped %u\r\n",
+           poll_stats.irqs, poll_stats.irq_msgs, poll_stats.polled_msgs,
+           poll_stats.budget_exhausted, poll_stats.unmasks, poll_stats.rearm_races,
+           poll_stats.dropped);
 }
 
 void mbox_request(volatile uint32_t *base, uint32_t *msg, size_t len)
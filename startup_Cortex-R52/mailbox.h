@@ -2,6 +2,7 @@
 #define MAILBOX_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define RTPS_TRCH_MBOX_BASE	((volatile uint32_t *)0x3000a000)
 #define HPPS_RTPS_MBOX_BASE 	((volatile uint32_t *)0xf9230000)
@@ -53,11 +54,49 @@
 
 typedef void (*cb_t)(void *arg, volatile uint32_t *base, uint32_t *msg);
 
+// Service order of instances with messages pending at the same time
+#define MBOX_PRIO_URGENT    0 // latency-critical commands
+#define MBOX_PRIO_BULK      1 // bulk/status traffic, the default
+#define MBOX_PRIOS          2
+
+// Interrupt/polling hybrid: on an interrupt, the instance's interrupt is
+// masked (REG_INT_ENABLE) and its messages, starting with the one that
+// raised it, are received by mbox_poll(), up to budget messages per call,
+// from an event (event.h) that stays posted while mbox_polling() is
+// non-zero. After idle_polls consecutive empty polls the interrupt is
+// unmasked. Polled messages are copied out with IRQs masked, then handed
+// to their callback with IRQs enabled. A budget of 0 disables polling:
+// messages are received, and callbacks run, in the ISR.
+#define MBOX_POLL_BUDGET    16
+#define MBOX_POLL_IDLE      4
+
+struct mbox_poll_config {
+    unsigned budget;        // messages per mbox_poll() call
+    unsigned idle_polls;    // empty polls before unmasking
+};
+
+struct mbox_poll_stats {
+    uint32_t irqs;              // mailbox ISR invocations
+    uint32_t irq_msgs;          // messages received in the ISR
+    uint32_t polled_msgs;       // messages received by mbox_poll()
+    uint32_t budget_exhausted;  // polls that stopped at the budget
+    uint32_t unmasks;           // returns to interrupt mode
+    uint32_t rearm_races;       // messages found while unmasking
+    uint32_t dropped;           // messages acked unread, no pool buffer
+};
+
 int mbox_init_server(volatile uint32_t *ip_base, unsigned instance, uint32_t owner, uint32_t dest, cb_t req_cb, void *cb_arg);
 int mbox_init_client(volatile uint32_t *ip_base, unsigned instance, uint32_t dest, cb_t reply_cb, void *cb_arg);
 void mbox_request(volatile uint32_t *ip_base, uint32_t *msg, size_t len);
 void mbox_reply(volatile uint32_t *ip_base, uint32_t *msg, size_t len);
 void mbox_request_isr(volatile uint32_t *ip_base);
 void mbox_reply_isr(volatile uint32_t *ip_base);
+int mbox_set_prio(volatile uint32_t *ip_base, unsigned instance, unsigned prio);
+
+unsigned mbox_poll(void);
+unsigned mbox_polling(void);
+void mbox_poll_configure(const struct mbox_poll_config *config);
+void mbox_poll_get_stats(struct mbox_poll_stats *stats);
+void mbox_poll_report(void);
 
 #endif // MAILBOX_H
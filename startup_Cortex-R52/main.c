@@ -12,16 +12,57 @@
 #include "uart.h"
 #include "float.h"
 #include "mailbox.h"
+#include "mbox_chan.h"
 #include "command.h"
 #include "busid.h"
 #include "gic.h"
+#include "boot.h"
+#include "mpu.h"
+#include "pool.h"
+#include "ring.h"
+#include "pmu.h"
+#include "telemetry.h"
+#include "bench.h"
+#include "intr.h"
+#include "stack.h"
+#include "trace.h"
+#include "membench.h"
+#include "memops.h"
+#include "idle.h"
+#include "event.h"
+#include "coro.h"
+#include "shmlog.h"
+#include "fiq.h"
 
+#if defined(TESTS_OVERRIDE)
+// Selected on the command line: make TESTS="TEST_SORT TEST_RING"
+#elif defined(BENCH)
+// Benchmark image (make bench), results parsed by tools/bench.sh
+#define TEST_SORT
+#define TEST_PRINTF
+#define TEST_MEMOPS
+#define TEST_MBOX_BENCH
+#else
 // #define TEST_FLOAT
 // #define TEST_SORT
+// #define TEST_MPU_PROFILES
+// #define TEST_MEMBENCH
+// #define TEST_MEMOPS
+// #define TEST_RING
+// #define TEST_PRINTF // needs make PRINTF_BENCH=1
+// #define TEST_TELEMETRY
+// #define TEST_MBOX_BENCH
+// #define TEST_STACK
+// #define TEST_IDLE
+// #define TEST_EVENT
+// #define TEST_SHMLOG
+// #define TEST_FIQ
+// #define TEST_TRACE // needs make TRACE=1
 #define TEST_RTPS_TRCH_MAILBOX
 // #define TEST_HPPS_RTPS_MAILBOX
 // #define TEST_SOFT_RESET
 // #define TEST_RTPS_HPPS_MMU
+#endif
 
 extern unsigned char _text_start;
 extern unsigned char _text_end;
@@ -51,23 +92,37 @@ void soft_reset (void)
 			     "mcr p15, 4, r1, c12, c0, 2\n"); 
 }
 
+#ifdef TEST_HPPS_RTPS_MAILBOX
+#define HPPS_RTPS_URGENT_LANES  1
+#define HPPS_RTPS_BULK_LANES    3
+static struct mbox_chan hpps_chan;
+#endif // TEST_HPPS_RTPS_MAILBOX
+
 static void handle_trch_reply(void *arg, volatile uint32_t *mbox_base, uint32_t *msg)
 {
-    printf("recved reply from TRCH: 0x%x\r\n", msg);
+    printf("recved reply from TRCH: 0x%x\r\n", msg_echo_reply_decode(msg)->arg);
 }
 
 int main(void)
 {
+#ifdef TRACE
+    trace_start();
+#endif
 //    asm(".global __use_hlt_semihosting");
     cdns_uart_startup(); 	// init UART
+    boot_mark(BOOT_MARK_UART);
     printf("R52 is alive\r\n");
 
 
     /* Display a welcome message via semihosting */
     printf("Cortex-R52 bare-metal startup example\r\n");
 
+    pool_init();
+    event_init();
+
     /* Enable the caches */
     enable_caches();
+    boot_mark(BOOT_MARK_CACHES);
 
     /* Enable GIC */
 /*    printf("start of arm_gic_setup()\n");
@@ -75,7 +130,16 @@ int main(void)
     printf("end of arm_gic_setup()\n");
 */
     enable_interrupts();
+    fiq_init();
+    boot_mark(BOOT_MARK_IRQ);
+    idle_init();
 
+#ifdef TEST_SHMLOG /* read the ring from HPPS with tools/shmlogcat */
+    shmlog_init();
+    shmlog_bench();
+    printf("console: to the log ring at 0x%x from here on\r\n", SHMLOG_BASE);
+    shmlog_console = SHMLOG_CONSOLE_RING;
+#endif // TEST_SHMLOG
 
 #ifdef TEST_FLOAT
     float_test();
@@ -86,21 +150,89 @@ int main(void)
     compare_sorts();
 #endif // TEST_SORT
 
+#ifdef TEST_MPU_PROFILES
+    mpu_print();
+    mpu_bench();
+#endif // TEST_MPU_PROFILES
+
+#ifdef TEST_MEMBENCH
+    membench();
+#endif // TEST_MEMBENCH
+
+#ifdef TEST_MEMOPS
+    memops_bench();
+#endif // TEST_MEMOPS
+
+#ifdef TEST_RING
+    ring_bench();
+#endif // TEST_RING
+
+#ifdef TEST_PRINTF
+    printf_bench();
+#endif // TEST_PRINTF
+
+#ifdef TEST_TELEMETRY /* decode the capture with tools/tlmdecode */
+    tlm_log("telemetry test");
+    for (unsigned m = 0; m < BOOT_MARKS; ++m)
+        tlm_counter(m, boot_ts[m]);
+    tlm_trace(0, pmu_cycles());
+    tlm_report();
+#endif // TEST_TELEMETRY
+
+#ifdef TEST_MBOX_BENCH /* needs the echo server on TRCH */
+    bench_mbox_irq();
+    bench_mbox_rtt();
+#endif // TEST_MBOX_BENCH
+
 #ifdef TEST_RTPS_TRCH_MAILBOX /* Message flow: RTPS -> TRCH -> RTPS */
     gic_enable_irq(RTPS_TRCH_MAILBOX_IRQ_B, IRQ_TYPE_EDGE);
     mbox_init_client(RTPS_TRCH_MBOX_BASE, /* instance */ 0, MASTER_ID_RTPS_CPU0, handle_trch_reply, NULL);
 
-    uint32_t msg[] = { CMD_ECHO, 42 }; // the protocol, must match the server-side on TRCH
-    printf("sending request to TRCH: cmd %x arg %x\r\n", msg[0], msg[1]);
-    mbox_request(RTPS_TRCH_MBOX_BASE, &msg[0], 2);
+    uint32_t msg[MSG_MAX_WORDS]; // the protocol, in msg_schema.h shared with TRCH
+    unsigned len = msg_echo_encode(msg, 42);
+    printf("sending request to TRCH: cmd %x arg %x\r\n", msg[0], msg_echo_decode(msg)->arg);
+    mbox_request(RTPS_TRCH_MBOX_BASE, msg, len);
 #endif // TEST_RTPS_TRCH_MAILBOX
 
 #ifdef TEST_HPPS_RTPS_MAILBOX /* Message flow: HPPS -> RTPS -> HPPS */
     gic_enable_irq(HPPS_RTPS_MAILBOX_IRQ_A, IRQ_TYPE_EDGE);
-    mbox_init_server(HPPS_RTPS_MBOX_BASE, /* instance */ 0, MASTER_ID_RTPS_CPU0, MASTER_ID_HPPS_CPU0, cmd_handle, NULL);
+    // Relayed commands: RTPS -> TRCH -> RTPS in between, with timeouts
+    gic_enable_irq(RTPS_TRCH_MAILBOX_IRQ_B, IRQ_TYPE_EDGE);
+    gic_enable_ppi(TIMER_PPI);
+    // Routed commands: TRCH -> RTPS -> HPPS -> RTPS -> TRCH
+    gic_enable_irq(RTPS_TRCH_MAILBOX_IRQ_A, IRQ_TYPE_EDGE);
+    gic_enable_irq(HPPS_RTPS_MAILBOX_IRQ_B, IRQ_TYPE_EDGE);
+    cmd_init();
+    // Instance 0 is the urgent lane (commands), 1-3 carry bulk/status
+    mbox_chan_init_server(&hpps_chan, HPPS_RTPS_MBOX_BASE, /* instance */ 0,
+                          HPPS_RTPS_URGENT_LANES, HPPS_RTPS_BULK_LANES,
+                          MASTER_ID_RTPS_CPU0, MASTER_ID_HPPS_CPU0, cmd_handle, NULL);
 #endif // TEST_HPPS_RTPS_MAILBOX
 
+#ifdef TEST_TRACE /* symbolize with tools/tracefold */
+    trace_dump();
+#endif // TEST_TRACE
+
+#ifdef TEST_STACK /* high-water marks so far, see also stack_check() in irq_handler() */
+    stack_report();
+#endif // TEST_STACK
+
+#ifdef TEST_IDLE
+    idle_bench();
+#endif // TEST_IDLE
+
+#ifdef TEST_EVENT
+    event_test();
+#endif // TEST_EVENT
+
+#ifdef TEST_FIQ
+    fiq_bench();
+#endif // TEST_FIQ
+
     printf("Done.\r\n");
+#ifdef BENCH
+    bench_done();
+#endif
 
 #ifdef TEST_SOFT_RESET
     printf("Resetting...\r\n");
@@ -128,8 +260,23 @@ int main(void)
 #endif // TEST_RTPS_HPPS_MMU
 
     printf("Waiting for interrupt...\r\n");
+    bool boot_reported = false;
     while (1) {
-        asm("wfi");
+        // The work posted by ISRs, including mailbox polling
+        event_dispatch(EVENT_ALL);
+
+        // Boot timing once the ISR marked the first mailbox message
+        if (!boot_reported && boot_ts[BOOT_MARK_MBOX] != BOOT_TS_NONE) {
+            boot_report();
+            boot_reported = true;
+        }
+
+        // Sleep only if no event is pending: IRQs masked from the check
+        // to the idle state, which ends on a pending IRQ
+        uint32_t irq = intr_save();
+        if (!event_pending())
+            idle_enter();
+        intr_restore(irq);
     }
     
     return 0;
@@ -153,16 +300,36 @@ void mbox_hpps_request_isr()
 #endif
 
 void irq_handler(unsigned irq) {
-    printf("IRQ #%u\r\n", irq);
+    idle_irq(); // first, for the wake-up latency
+#ifdef IRQ_DEBUG
+    if (irq != IDLE_TIMER_IRQ && irq != FIQ_BENCH_IRQ) // too frequent to print
+        printf("IRQ #%u\r\n", irq);
+#endif
     switch (irq) {
+        case FIQ_BENCH_IRQ:
+            fiq_bench_irq_isr();
+            break;
+        case IDLE_TIMER_IRQ:
+            idle_timer_isr();
+            coro_timer_isr(); // re-arms if timeouts are running
+            break;
         case RTPS_TRCH_MAILBOX_IRQ_B:
             mbox_reply_isr(RTPS_TRCH_MBOX_BASE);
+            boot_mark(BOOT_MARK_MBOX); // reported from main()
             break;
         case HPPS_RTPS_MAILBOX_IRQ_A:
             mbox_request_isr(HPPS_RTPS_MBOX_BASE);
+            boot_mark(BOOT_MARK_MBOX); // reported from main()
+            break;
+        case RTPS_TRCH_MAILBOX_IRQ_A:
+            mbox_request_isr(RTPS_TRCH_MBOX_BASE);
+            break;
+        case HPPS_RTPS_MAILBOX_IRQ_B:
+            mbox_reply_isr(HPPS_RTPS_MBOX_BASE);
             break;
         default:
             printf("No ISR registered for IRQ #%u\r\n", irq);
             break;
     }
+    stack_check(); // the deepest the IRQ stack gets is in the ISRs
 }
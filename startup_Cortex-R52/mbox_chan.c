@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "intr.h"
+#include "mailbox.h"
+#include "mbox_chan.h"
+
+static const char *prio_name(unsigned prio)
+{
+    return prio == MBOX_PRIO_URGENT ? "urgent" : "bulk";
+}
+
+static volatile uint32_t *lane_base(struct mbox_chan *chan, struct mbox_lane *lane)
+{
+    return (volatile uint32_t *)((uint8_t *)chan->ip_base + lane->instance * HPSC_MBOX_INSTANCE_REGION);
+}
+
+static unsigned lane_prio(struct mbox_chan *chan, unsigned l)
+{
+    return l < chan->urgent_lanes ? MBOX_PRIO_URGENT : MBOX_PRIO_BULK;
+}
+
+// Frees the lane, then hands the reply to the channel's callback
+static void lane_reply_cb(void *arg, volatile uint32_t *base, uint32_t *msg)
+{
+    struct mbox_lane *lane = arg;
+    struct mbox_chan *chan = lane->chan;
+
+    lane->busy = false;
+    chan->cb(chan->cb_arg, base, msg);
+}
+
+static int chan_init(struct mbox_chan *chan, volatile uint32_t *ip_base, unsigned first_instance,
+                     unsigned urgent_lanes, unsigned bulk_lanes, cb_t cb, void *cb_arg)
+{
+    unsigned l, lanes = urgent_lanes + bulk_lanes;
+
+    if (!lanes || lanes > MBOX_CHAN_MAX_LANES || first_instance + lanes > HPSC_MBOX_INSTANCES) {
+        printf("ERROR: mbox chan: bad layout: instances %u + %u urgent + %u bulk\r\n",
+               first_instance, urgent_lanes, bulk_lanes);
+        return 1;
+    }
+    chan->ip_base = ip_base;
+    chan->lanes = lanes;
+    chan->urgent_lanes = urgent_lanes;
+    chan->next[MBOX_PRIO_URGENT] = 0;
+    chan->next[MBOX_PRIO_BULK] = urgent_lanes;
+    chan->cb = cb;
+    chan->cb_arg = cb_arg;
+    for (l = 0; l < lanes; ++l) {
+        chan->lane[l].chan = chan;
+        chan->lane[l].instance = first_instance + l;
+        chan->lane[l].busy = false;
+    }
+    for (l = 0; l < MBOX_PRIOS; ++l)
+        chan->stats[l].sent = chan->stats[l].no_lane = chan->stats[l].borrowed = 0;
+    return 0;
+}
+
+int mbox_chan_init_server(struct mbox_chan *chan, volatile uint32_t *ip_base,
+                          unsigned first_instance, unsigned urgent_lanes, unsigned bulk_lanes,
+                          uint32_t owner, uint32_t dest, cb_t req_cb, void *cb_arg)
+{
+    unsigned l;
+
+    if (chan_init(chan, ip_base, first_instance, urgent_lanes, bulk_lanes, req_cb, cb_arg))
+        return 1;
+    // Requests go straight to the callback, which replies on the same lane
+    for (l = 0; l < chan->lanes; ++l) {
+        if (mbox_init_server(ip_base, chan->lane[l].instance, owner, dest, req_cb, cb_arg) ||
+            mbox_set_prio(ip_base, chan->lane[l].instance, lane_prio(chan, l)))
+            return 1;
+    }
+    return 0;
+}
+
+int mbox_chan_init_client(struct mbox_chan *chan, volatile uint32_t *ip_base,
+                          unsigned first_instance, unsigned urgent_lanes, unsigned bulk_lanes,
+                          uint32_t dest, cb_t reply_cb, void *cb_arg)
+{
+    unsigned l;
+
+    if (chan_init(chan, ip_base, first_instance, urgent_lanes, bulk_lanes, reply_cb, cb_arg))
+        return 1;
+    for (l = 0; l < chan->lanes; ++l) {
+        if (mbox_init_client(ip_base, chan->lane[l].instance, dest, lane_reply_cb, &chan->lane[l]) ||
+            mbox_set_prio(ip_base, chan->lane[l].instance, lane_prio(chan, l)))
+            return 1;
+    }
+    return 0;
+}
+
+// Claims the next free lane in [first, first + count) round-robin from
+// *next. Called with IRQs masked. Returns the lane or NULL.
+static struct mbox_lane *claim_lane(struct mbox_chan *chan, unsigned first, unsigned count, unsigned *next)
+{
+    unsigned i, l;
+
+    for (i = 0; i < count; ++i) {
+        l = first + (*next - first + i) % count;
+        if (!chan->lane[l].busy) {
+            chan->lane[l].busy = true;
+            *next = first + (l - first + 1) % count;
+            return &chan->lane[l];
+        }
+    }
+    return NULL;
+}
+
+int mbox_chan_request(struct mbox_chan *chan, unsigned prio, uint32_t *msg, size_t len)
+{
+    unsigned bulk_lanes = chan->lanes - chan->urgent_lanes;
+    struct mbox_lane *lane = NULL;
+    uint32_t irq;
+
+    if (prio >= MBOX_PRIOS) {
+        printf("ERROR: mbox chan: bad prio %u\r\n", prio);
+        return 1;
+    }
+
+    irq = intr_save();
+    if (prio == MBOX_PRIO_URGENT && chan->urgent_lanes)
+        lane = claim_lane(chan, 0, chan->urgent_lanes, &chan->next[MBOX_PRIO_URGENT]);
+    if (!lane && bulk_lanes) {
+        lane = claim_lane(chan, chan->urgent_lanes, bulk_lanes, &chan->next[MBOX_PRIO_BULK]);
+        if (lane && prio == MBOX_PRIO_URGENT)
+            chan->stats[prio].borrowed++;
+    }
+    if (!lane)
+        chan->stats[prio].no_lane++;
+    else
+        chan->stats[prio].sent++;
+    intr_restore(irq);
+
+    if (!lane)
+        return 1;
+    mbox_request(lane_base(chan, lane), msg, len);
+    return 0;
+}
+
+void mbox_chan_report(struct mbox_chan *chan)
+{
+    unsigned prio;
+
+    for (prio = 0; prio < MBOX_PRIOS; ++prio)
+        printf("mbox chan %p %-6s: sent %u, no lane %u, borrowed %u\r\n", chan->ip_base,
+               prio_name(prio), chan->stats[prio].sent, chan->stats[prio].no_lane,
+               chan->stats[prio].borrowed);
+}
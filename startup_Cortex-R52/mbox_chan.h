@@ -0,0 +1,59 @@
+#ifndef MBOX_CHAN_H
+#define MBOX_CHAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mailbox.h"
+
+// A channel bonds consecutive instances of one mailbox IP into lanes, in
+// two priority classes: the first urgent lanes carry latency-critical
+// commands, the remaining bulk lanes status and bulk traffic. Both ends
+// must agree on the layout.
+//
+// A lane carries one request at a time, from the request until its reply
+// is received. Senders take a free lane of the class, round-robin; urgent
+// requests may also take a free bulk lane, bulk requests never take an
+// urgent lane. Receivers service urgent lanes first (MBOX_PRIO_URGENT).
+//
+// A client channel is used from one core; requests may be sent from ISRs.
+
+#define MBOX_CHAN_MAX_LANES 8
+
+struct mbox_chan;
+
+struct mbox_lane {
+    struct mbox_chan *chan;
+    unsigned instance;
+    volatile bool busy;     // request sent, reply not yet received
+};
+
+struct mbox_chan_stats {
+    uint32_t sent;          // requests sent
+    uint32_t no_lane;       // requests refused, no free lane
+    uint32_t borrowed;      // urgent requests sent on a bulk lane
+};
+
+struct mbox_chan {
+    volatile uint32_t *ip_base;
+    unsigned lanes;
+    unsigned urgent_lanes;
+    unsigned next[MBOX_PRIOS];  // round-robin position per class
+    cb_t cb;
+    void *cb_arg;
+    struct mbox_lane lane[MBOX_CHAN_MAX_LANES];
+    struct mbox_chan_stats stats[MBOX_PRIOS];
+};
+
+int mbox_chan_init_server(struct mbox_chan *chan, volatile uint32_t *ip_base,
+                          unsigned first_instance, unsigned urgent_lanes, unsigned bulk_lanes,
+                          uint32_t owner, uint32_t dest, cb_t req_cb, void *cb_arg);
+int mbox_chan_init_client(struct mbox_chan *chan, volatile uint32_t *ip_base,
+                          unsigned first_instance, unsigned urgent_lanes, unsigned bulk_lanes,
+                          uint32_t dest, cb_t reply_cb, void *cb_arg);
+// Returns 0 if sent, 1 if no lane is free (retry later)
+int mbox_chan_request(struct mbox_chan *chan, unsigned prio, uint32_t *msg, size_t len);
+void mbox_chan_report(struct mbox_chan *chan);
+
+#endif // MBOX_CHAN_H
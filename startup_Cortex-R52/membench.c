@@ -0,0 +1,280 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "cache.h"
+#include "mpu.h"
+#include "membench.h"
+#include "memmap.h"
+
+// The kernels are in asm: at -O0 a C loop would measure the loop, not the
+// memory. The loop overhead (SUBS, BNE per iteration) is still included.
+
+#define MB_TCM_SIZE         4096
+#define MB_DRAM_BUF         ((uint8_t *)MEMBENCH_BUF)
+#define MB_DRAM_SMALL       4096        // fits in the L1 D-cache
+#define MB_DRAM_LARGE       MEMBENCH_BUF_SIZE // does not
+#define MB_DEVICE_REG       ((volatile uint32_t *)(0x30001000 + 0x2C)) // UART channel status, no read side effects
+#define MB_CHASE_LOADS      4096
+#define MB_LINE             CACHE_LINE_SIZE // pointer chase stride
+
+static uint8_t mb_tcm_a[MB_TCM_SIZE] CACHE_ALIGNED;
+static uint8_t mb_tcm_b[MB_TCM_SIZE] __attribute__((section(".tcm_b.membench"), aligned(CACHE_LINE_SIZE)));
+
+struct mb_target {
+    const char *name;
+    uint8_t *buf;
+    size_t size;
+    int region; // MPU region whose profile is varied, -1: attributes do not apply (TCM)
+};
+
+static const struct mb_target mb_targets[] = {
+    { "TCM A",       mb_tcm_a,    MB_TCM_SIZE,   -1 },
+    { "TCM B",       mb_tcm_b,    MB_TCM_SIZE,   -1 },
+    { "DRAM 4K",     MB_DRAM_BUF, MB_DRAM_SMALL, MPU_REGION_BENCH_DRAM },
+    { "DRAM 256K",   MB_DRAM_BUF, MB_DRAM_LARGE, MPU_REGION_BENCH_DRAM },
+};
+
+static const mpu_prof_t mb_profs[] = { MPU_PROF_WB, MPU_PROF_WT, MPU_PROF_NC, MPU_PROF_DEVICE };
+
+#define MB_TARGETS  (sizeof(mb_targets) / sizeof(mb_targets[0]))
+#define MB_PROFS    (sizeof(mb_profs) / sizeof(mb_profs[0]))
+
+typedef void mb_kernel_t(uint8_t *dst, const uint8_t *src, size_t bytes);
+
+// Read, write and copy kernels for LDRB/LDRH/LDR and their stores
+#define MB_KERNELS(bits, step, ld, st) \
+static void mb_read##bits(uint8_t *dst, const uint8_t *src, size_t bytes) \
+{ \
+    size_t n = bytes / step; \
+    __asm__ __volatile__("1: " ld " r3, [%0], #" #step "\n" \
+                         "   subs %1, %1, #1\n" \
+                         "   bne 1b\n" \
+                         : "+r" (src), "+r" (n) : : "r3", "cc", "memory"); \
+} \
+static void mb_write##bits(uint8_t *dst, const uint8_t *src, size_t bytes) \
+{ \
+    size_t n = bytes / step; \
+    __asm__ __volatile__("   mov r3, #0\n" \
+                         "1: " st " r3, [%0], #" #step "\n" \
+                         "   subs %1, %1, #1\n" \
+                         "   bne 1b\n" \
+                         : "+r" (dst), "+r" (n) : : "r3", "cc", "memory"); \
+} \
+static void mb_copy##bits(uint8_t *dst, const uint8_t *src, size_t bytes) \
+{ \
+    size_t n = bytes / step; \
+    __asm__ __volatile__("1: " ld " r3, [%1], #" #step "\n" \
+                         "   " st " r3, [%0], #" #step "\n" \
+                         "   subs %2, %2, #1\n" \
+                         "   bne 1b\n" \
+                         : "+r" (dst), "+r" (src), "+r" (n) : : "r3", "cc", "memory"); \
+}
+
+MB_KERNELS(8, 1, "ldrb", "strb")
+MB_KERNELS(16, 2, "ldrh", "strh")
+MB_KERNELS(32, 4, "ldr", "str")
+
+static void mb_read64(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 8;
+    __asm__ __volatile__("1: ldrd r2, r3, [%0], #8\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (src), "+r" (n) : : "r2", "r3", "cc", "memory");
+}
+
+static void mb_write64(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 8;
+    __asm__ __volatile__("   mov r2, #0\n"
+                         "   mov r3, #0\n"
+                         "1: strd r2, r3, [%0], #8\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (dst), "+r" (n) : : "r2", "r3", "cc", "memory");
+}
+
+static void mb_copy64(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 8;
+    __asm__ __volatile__("1: ldrd r2, r3, [%1], #8\n"
+                         "   strd r2, r3, [%0], #8\n"
+                         "   subs %2, %2, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (dst), "+r" (src), "+r" (n) : : "r2", "r3", "cc", "memory");
+}
+
+// LDM/STM of 4 registers, twice per iteration: 32 bytes. Not r7, the frame
+// pointer in Thumb at -O0.
+static void mb_read_ldm(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 32;
+    __asm__ __volatile__("1: ldmia %0!, {r3-r6}\n"
+                         "   ldmia %0!, {r3-r6}\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (src), "+r" (n) : : "r3", "r4", "r5", "r6", "cc", "memory");
+}
+
+static void mb_write_ldm(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 32;
+    __asm__ __volatile__("   mov r3, #0\n"
+                         "   mov r4, #0\n"
+                         "   mov r5, #0\n"
+                         "   mov r6, #0\n"
+                         "1: stmia %0!, {r3-r6}\n"
+                         "   stmia %0!, {r3-r6}\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (dst), "+r" (n) : : "r3", "r4", "r5", "r6", "cc", "memory");
+}
+
+static void mb_copy_ldm(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t n = bytes / 32;
+    __asm__ __volatile__("1: ldmia %1!, {r3-r6}\n"
+                         "   stmia %0!, {r3-r6}\n"
+                         "   ldmia %1!, {r3-r6}\n"
+                         "   stmia %0!, {r3-r6}\n"
+                         "   subs %2, %2, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (dst), "+r" (src), "+r" (n) : : "r3", "r4", "r5", "r6", "cc", "memory");
+}
+
+#define MB_WIDTHS 5
+#define MB_OPS    3
+
+static const char *mb_width_names[MB_WIDTHS] = { "LDRB", "LDRH", "LDR", "LDRD", "LDM" };
+static const char *mb_op_names[MB_OPS] = { "read", "write", "copy" };
+
+static mb_kernel_t *const mb_kernels[MB_OPS][MB_WIDTHS] = {
+    { mb_read8,  mb_read16,  mb_read32,  mb_read64,  mb_read_ldm },
+    { mb_write8, mb_write16, mb_write32, mb_write64, mb_write_ldm },
+    { mb_copy8,  mb_copy16,  mb_copy32,  mb_copy64,  mb_copy_ldm },
+};
+
+// Bytes per 1000 cycles of the second run (the first warms the cache).
+// Read and write cover the whole buffer, copy moves its lower half to the
+// upper half: no kernel goes past the end of the buffer.
+static unsigned mb_bandwidth(mb_kernel_t *kernel, uint8_t *buf, size_t size, int copy)
+{
+    size_t bytes = copy ? size / 2 : size;
+    uint8_t *dst = copy ? buf + size / 2 : buf;
+    uint32_t cycles;
+
+    kernel(dst, buf, bytes);
+    cycles = pmu_cycles();
+    kernel(dst, buf, bytes);
+    cycles = pmu_cycles() - cycles;
+    return cycles ? bytes * 1000 / cycles : 0;
+}
+
+// Links the lines of buf in a single random cycle (Sattolo), the next
+// pointer in the first word of each line, so that the prefetcher does
+// not help: the chase measures the load-to-use latency.
+static void mb_chase_init(uint8_t *buf, size_t size)
+{
+    unsigned lines = size / MB_LINE, i, j;
+    uint32_t t;
+
+    srand(3);
+    for (i = 0; i < lines; ++i)
+        *(uint32_t *)(buf + i * MB_LINE) = i;
+    for (i = lines - 1; i > 0; --i) {
+        j = rand() % i;
+        t = *(uint32_t *)(buf + i * MB_LINE);
+        *(uint32_t *)(buf + i * MB_LINE) = *(uint32_t *)(buf + j * MB_LINE);
+        *(uint32_t *)(buf + j * MB_LINE) = t;
+    }
+    for (i = 0; i < lines; ++i)
+        *(uintptr_t *)(buf + i * MB_LINE) = (uintptr_t)(buf + *(uint32_t *)(buf + i * MB_LINE) * MB_LINE);
+}
+
+// Cycles for n dependent loads, starting (and ending, for a device
+// register) at p
+static uint32_t mb_chase(const void *p, unsigned n)
+{
+    uint32_t cycles = pmu_cycles();
+    __asm__ __volatile__("1: ldr %0, [%0]\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (p), "+r" (n) : : "cc", "memory");
+    return pmu_cycles() - cycles;
+}
+
+static uint32_t mb_device_read(volatile uint32_t *reg, unsigned n)
+{
+    uint32_t cycles = pmu_cycles();
+    __asm__ __volatile__("1: ldr r3, [%0]\n"
+                         "   subs %1, %1, #1\n"
+                         "   bne 1b\n"
+                         : "+r" (reg), "+r" (n) : : "r3", "cc", "memory");
+    return pmu_cycles() - cycles;
+}
+
+static void mb_print_latency(const char *target, const char *prof, uint32_t cycles)
+{
+    unsigned tenths = cycles * 10 / MB_CHASE_LOADS;
+    printf("  %-10s %-13s %4u.%u\r\n", target, prof, tenths / 10, tenths % 10);
+}
+
+// Prints the bandwidth rows, returns the latency of the chase
+static uint32_t mb_run(const struct mb_target *t, const char *prof)
+{
+    unsigned op, w;
+
+    for (op = 0; op < MB_OPS; ++op) {
+        printf("  %-10s %-13s %-5s", t->name, prof, mb_op_names[op]);
+        for (w = 0; w < MB_WIDTHS; ++w)
+            printf(" %6u", mb_bandwidth(mb_kernels[op][w], t->buf, t->size, op == 2));
+        printf("\r\n");
+    }
+    mb_chase_init(t->buf, t->size);
+    mb_chase(t->buf, MB_CHASE_LOADS); // warm
+    return mb_chase(t->buf, MB_CHASE_LOADS);
+}
+
+void membench(void)
+{
+    uint32_t lat[MB_TARGETS][MB_PROFS] = { { 0 } };
+    unsigned i, p, w;
+    struct mpu_region orig;
+    const struct mb_target *t;
+
+    mpu_get_region(MPU_REGION_BENCH_DRAM, &orig);
+
+    printf("membench: bandwidth, bytes/1000 cycles:\r\n");
+    printf("  %-10s %-13s %-5s", "memory", "attributes", "op");
+    for (w = 0; w < MB_WIDTHS; ++w)
+        printf(" %6s", mb_width_names[w]);
+    printf("\r\n");
+    for (i = 0; i < MB_TARGETS; ++i) {
+        t = &mb_targets[i];
+        if (t->region < 0) {
+            lat[i][0] = mb_run(t, "-");
+            continue;
+        }
+        for (p = 0; p < MB_PROFS; ++p) {
+            if (mpu_set_profile(t->region, mb_profs[p]))
+                break;
+            lat[i][p] = mb_run(t, mpu_prof_name(mb_profs[p]));
+        }
+        mpu_set_region(t->region, &orig);
+    }
+
+    printf("membench: latency, cycles/load (random chase, %u byte stride):\r\n", MB_LINE);
+    for (i = 0; i < MB_TARGETS; ++i) {
+        t = &mb_targets[i];
+        if (t->region < 0) {
+            mb_print_latency(t->name, "-", lat[i][0]);
+            continue;
+        }
+        for (p = 0; p < MB_PROFS; ++p)
+            mb_print_latency(t->name, mpu_prof_name(mb_profs[p]), lat[i][p]);
+    }
+    mb_print_latency("UART SR", "device", mb_device_read(MB_DEVICE_REG, MB_CHASE_LOADS));
+}
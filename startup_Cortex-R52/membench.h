@@ -0,0 +1,13 @@
+#ifndef MEMBENCH_H
+#define MEMBENCH_H
+
+// Memory characterization: STREAM-style read, write and copy bandwidth by
+// access width (LDRB, LDRH, LDR, LDRD, LDM of 4 registers and their
+// stores), and load-to-use latency by chasing pointers in random order,
+// for TCM A, TCM B and a buffer in HPPS DRAM (memmap.h) under each MPU memory
+// attribute profile; plus the latency of a device register read.
+// Prints tables in bytes per 1000 cycles and cycles per load.
+
+void membench(void);
+
+#endif // MEMBENCH_H
@@ -0,0 +1,37 @@
+#ifndef MEMMAP_H
+#define MEMMAP_H
+
+// RTPS memory map outside the TCMs (startup.ld has the TCMs)
+
+#define HPPS_DRAM_WINDOW_BASE   0x80000000 // HPPS DRAM, translated by the RTPS MMU
+#define HPPS_DRAM_WINDOW_END    0xf9000000
+
+// RTPS carve-out in HPPS DRAM, [RTPS_DRAM_BASE, RTPS_DRAM_END): every
+// buffer RTPS keeps in HPPS DRAM is in here, at the addresses below, so
+// HPPS must reserve the whole range, e.g. with a reserved-memory node in
+// its device tree:
+//
+//     rtps_dram@8e100000 { reg = <0x0 0x8e100000 0x0 0x300000>; no-map; };
+//
+// HPPS Linux still reads the log ring through /dev/mem (tools/shmlogcat).
+#define RTPS_DRAM_BASE          0x8e100000
+#define RTPS_DRAM_END           0x8e400000
+
+// Benchmark buffers in HPPS DRAM, private to RTPS: their own MPU region
+// (MPU_REGION_BENCH_DRAM), write-back at boot, whose attributes the
+// benchmarks vary. The rest of the window is shared with HPPS and
+// non-cacheable, but for the log ring below.
+#define BENCH_DRAM_BASE         RTPS_DRAM_BASE
+#define MPU_BENCH_BUF           BENCH_DRAM_BASE              // mpu_bench(): the sorts
+#define MPU_BENCH_BUF_SIZE      0x10000
+#define MEMBENCH_BUF            (BENCH_DRAM_BASE + 0x100000) // membench()
+#define MEMBENCH_BUF_SIZE       0x40000
+#define BENCH_DRAM_END          (MEMBENCH_BUF + MEMBENCH_BUF_SIZE)
+
+// Console log ring, shared with HPPS, see shmlog.h: its own MPU region
+// (MPU_REGION_SHMLOG), write-back, maintained at handoff (cache.h)
+#define SHMLOG_BASE             (RTPS_DRAM_BASE + 0x200000)
+#define SHMLOG_REGION_SIZE      0x20000 // the header and the text
+#define SHMLOG_END              (SHMLOG_BASE + SHMLOG_REGION_SIZE)
+
+#endif // MEMMAP_H
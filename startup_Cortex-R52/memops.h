@@ -0,0 +1,16 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stddef.h>
+
+// memcpy/memset/memcmp in memops.s replace the newlib ones at link time
+// (--wrap); the newlib ones stay reachable as __real_* for comparison.
+void *__real_memcpy(void *dst, const void *src, size_t n);
+void *__real_memset(void *dst, int c, size_t n);
+int __real_memcmp(const void *a, const void *b, size_t n);
+
+// Checks ours against newlib over all small sizes and alignments, then
+// cycles of ours against newlib's over a matrix of sizes and alignments
+void memops_bench(void);
+
+#endif // MEMOPS_H
@@ -0,0 +1,232 @@
+//----------------------------------------------------------------
+// memcpy, memset and memcmp for the Cortex-R52, in TCM
+//
+// Linked in place of the newlib routines with --wrap (see the Makefile):
+// every call from our objects lands on __wrap_*, while __real_* still
+// reach newlib, for the comparison in memops_bench().
+//
+// Word-aligned bulk moves with LDM/STM of 8 registers (32 bytes) and
+// LDRD/STRD (8 bytes); unaligned heads and tails byte by byte. memcpy
+// with source and destination misaligned to each other loads aligned
+// words and merges them with shifts, as LDM/LDRD need aligned addresses.
+// Normal memory only, like newlib's: no device registers.
+//
+// The section is placed right after the vectors by startup.ld, in TCM A.
+//----------------------------------------------------------------
+
+    .syntax unified
+    .thumb
+    .section .text.memops, "ax", %progbits
+
+//----------------------------------------------------------------
+// void *memcpy(void *dst, const void *src, size_t n)
+//----------------------------------------------------------------
+    .global __wrap_memcpy
+    .type __wrap_memcpy, %function
+    .thumb_func
+__wrap_memcpy:
+        PUSH    {r0, r4-r10}            // r0: return value
+        CMP     r2, #8
+        BLO     .Lcpy_bytes
+
+    // Align the destination
+.Lcpy_align:
+        TST     r0, #3
+        BEQ     .Lcpy_aligned
+        LDRB    r3, [r1], #1
+        STRB    r3, [r0], #1
+        SUB     r2, r2, #1
+        B       .Lcpy_align
+
+.Lcpy_aligned:
+        TST     r1, #3
+        BNE     .Lcpy_shift
+
+.Lcpy_32:
+        SUBS    r2, r2, #32
+        BLO     .Lcpy_8_entry
+1:      LDMIA   r1!, {r3-r10}
+        STMIA   r0!, {r3-r10}
+        SUBS    r2, r2, #32
+        BHS     1b
+.Lcpy_8_entry:
+        ADDS    r2, r2, #24             // undo the last -32, then -8
+        BLO     .Lcpy_4_entry
+1:      LDRD    r3, r4, [r1], #8
+        STRD    r3, r4, [r0], #8
+        SUBS    r2, r2, #8
+        BHS     1b
+.Lcpy_4_entry:
+        ADDS    r2, r2, #8
+        CMP     r2, #4
+        BLO     .Lcpy_bytes
+        LDR     r3, [r1], #4
+        STR     r3, [r0], #4
+        SUB     r2, r2, #4
+        B       .Lcpy_bytes
+
+    // Source misaligned by k = 1..3 bytes: dst word = (w0 >> 8k) | (w1 << (32 - 8k)),
+    // from the aligned words w0, w1 that hold it. Only words holding
+    // bytes to copy are loaded.
+.Lcpy_shift:
+        CMP     r2, #4
+        BLO     .Lcpy_bytes
+        AND     r5, r1, #3
+        LSL     r5, r5, #3              // r5 = 8k
+        RSB     r6, r5, #32             // r6 = 32 - 8k
+        BIC     r1, r1, #3
+        LDR     r3, [r1], #4            // w0
+1:      LDR     r4, [r1], #4            // w1
+        LSR     r3, r3, r5
+        LSL     r7, r4, r6
+        ORR     r3, r3, r7
+        STR     r3, [r0], #4
+        MOV     r3, r4
+        SUB     r2, r2, #4
+        CMP     r2, #4
+        BHS     1b
+        SUB     r1, r1, #4              // back to the first byte not copied
+        LSR     r5, r5, #3
+        ADD     r1, r1, r5
+
+.Lcpy_bytes:
+        CBZ     r2, .Lcpy_done
+1:      LDRB    r3, [r1], #1
+        STRB    r3, [r0], #1
+        SUBS    r2, r2, #1
+        BNE     1b
+.Lcpy_done:
+        POP     {r0, r4-r10}
+        BX      lr
+    .size __wrap_memcpy, . - __wrap_memcpy
+
+//----------------------------------------------------------------
+// void *memset(void *dst, int c, size_t n)
+//----------------------------------------------------------------
+    .global __wrap_memset
+    .type __wrap_memset, %function
+    .thumb_func
+__wrap_memset:
+        PUSH    {r0, r4-r10}            // r0: return value
+        AND     r1, r1, #0xff
+        CMP     r2, #8
+        BLO     .Lset_bytes
+
+.Lset_align:
+        TST     r0, #3
+        BEQ     .Lset_aligned
+        STRB    r1, [r0], #1
+        SUB     r2, r2, #1
+        B       .Lset_align
+
+.Lset_aligned:
+        ORR     r1, r1, r1, LSL #8
+        ORR     r1, r1, r1, LSL #16
+        MOV     r3, r1
+        MOV     r4, r1
+        MOV     r5, r1
+        MOV     r6, r1
+        MOV     r7, r1
+        MOV     r8, r1
+        MOV     r9, r1
+        MOV     r10, r1
+        SUBS    r2, r2, #32
+        BLO     .Lset_8_entry
+1:      STMIA   r0!, {r3-r10}
+        SUBS    r2, r2, #32
+        BHS     1b
+.Lset_8_entry:
+        ADDS    r2, r2, #24
+        BLO     .Lset_4_entry
+1:      STRD    r3, r4, [r0], #8
+        SUBS    r2, r2, #8
+        BHS     1b
+.Lset_4_entry:
+        ADDS    r2, r2, #8
+        CMP     r2, #4
+        BLO     .Lset_bytes
+        STR     r3, [r0], #4
+        SUB     r2, r2, #4
+
+.Lset_bytes:
+        CBZ     r2, .Lset_done
+1:      STRB    r1, [r0], #1
+        SUBS    r2, r2, #1
+        BNE     1b
+.Lset_done:
+        POP     {r0, r4-r10}
+        BX      lr
+    .size __wrap_memset, . - __wrap_memset
+
+//----------------------------------------------------------------
+// int memcmp(const void *a, const void *b, size_t n)
+//----------------------------------------------------------------
+    .global __wrap_memcmp
+    .type __wrap_memcmp, %function
+    .thumb_func
+__wrap_memcmp:
+        PUSH    {r4, r5}
+        CMP     r2, #8
+        BLO     .Lcmp_bytes
+        EOR     r3, r0, r1              // word compare only if equally aligned
+        TST     r3, #3
+        BNE     .Lcmp_bytes
+
+.Lcmp_align:
+        TST     r0, #3
+        BEQ     .Lcmp_words
+        LDRB    r3, [r0], #1
+        LDRB    r4, [r1], #1
+        SUBS    r3, r3, r4
+        BNE     .Lcmp_ret
+        SUB     r2, r2, #1
+        B       .Lcmp_align
+
+    // Two words per iteration; on a difference, the bytes of that word
+    // tell the sign
+.Lcmp_words:
+        CMP     r2, #8
+        BLO     .Lcmp_word
+        LDRD    r3, r4, [r0]
+        LDR     r5, [r1]
+        CMP     r3, r5
+        BNE     .Lcmp_bytes_4
+        LDR     r5, [r1, #4]
+        CMP     r4, r5
+        BNE     .Lcmp_next_4
+        ADD     r0, r0, #8
+        ADD     r1, r1, #8
+        SUB     r2, r2, #8
+        B       .Lcmp_words
+.Lcmp_next_4:
+        ADD     r0, r0, #4
+        ADD     r1, r1, #4
+        B       .Lcmp_bytes_4
+.Lcmp_word:
+        CMP     r2, #4
+        BLO     .Lcmp_bytes
+        LDR     r3, [r0]
+        LDR     r5, [r1]
+        CMP     r3, r5
+        BNE     .Lcmp_bytes_4
+        ADD     r0, r0, #4
+        ADD     r1, r1, #4
+        SUB     r2, r2, #4
+        B       .Lcmp_bytes
+.Lcmp_bytes_4:
+        MOV     r2, #4
+
+.Lcmp_bytes:
+        MOV     r3, #0
+        CBZ     r2, .Lcmp_ret
+1:      LDRB    r3, [r0], #1
+        LDRB    r4, [r1], #1
+        SUBS    r3, r3, r4
+        BNE     .Lcmp_ret
+        SUBS    r2, r2, #1
+        BNE     1b
+.Lcmp_ret:
+        MOV     r0, r3
+        POP     {r4, r5}
+        BX      lr
+    .size __wrap_memcmp, . - __wrap_memcmp
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "bench.h"
+#include "memops.h"
+
+#define MEMOPS_MAX      4096
+#define MEMOPS_REPS     4 // best of
+
+#define MEMOPS_STORAGE __attribute__((section(".tcm_b.memops"), aligned(8)))
+
+static uint8_t memops_src[MEMOPS_MAX + 8] MEMOPS_STORAGE;
+static uint8_t memops_dst[MEMOPS_MAX + 8] MEMOPS_STORAGE;
+
+static const size_t memops_sizes[] = { 4, 16, 64, 256, 1024, 4096 };
+
+// Byte offsets of dst and src from 8-byte alignment
+static const struct {
+    unsigned dst, src;
+    const char *name;
+} memops_aligns[] = {
+    { 0, 0, "aligned" },
+    { 1, 1, "both+1" },
+    { 0, 1, "src+1" },
+    { 3, 0, "dst+3" },
+};
+
+// Exhaustive check against newlib: every size up to MEMOPS_CHECK_MAX at
+// every pair of dst/src offsets from 4-byte alignment, with guard bytes
+// around dst to catch overruns
+#define MEMOPS_CHECK_MAX    80
+#define MEMOPS_CHECK_OFFS   4
+#define MEMOPS_CHECK_GUARD  8
+#define MEMOPS_CHECK_REPORTS 8
+#define MEMOPS_CHECK_BUF    (MEMOPS_CHECK_GUARD + MEMOPS_CHECK_OFFS + MEMOPS_CHECK_MAX + MEMOPS_CHECK_GUARD)
+
+static uint8_t check_src[MEMOPS_CHECK_BUF] MEMOPS_STORAGE;
+static uint8_t check_ours[MEMOPS_CHECK_BUF] MEMOPS_STORAGE;
+static uint8_t check_newlib[MEMOPS_CHECK_BUF] MEMOPS_STORAGE;
+
+enum { MEMOPS_CPY, MEMOPS_SET, MEMOPS_CMP, MEMOPS_FNS };
+
+static const char *memops_names[MEMOPS_FNS] = { "memcpy", "memset", "memcmp" };
+
+static uint32_t memops_run(unsigned fn, int ours, uint8_t *dst, const uint8_t *src, size_t n)
+{
+    uint32_t t, best = ~0u;
+    unsigned r;
+
+    for (r = 0; r < MEMOPS_REPS; ++r) {
+        t = pmu_cycles();
+        switch (fn) {
+            case MEMOPS_CPY:
+                if (ours)
+                    memcpy(dst, src, n);
+                else
+                    __real_memcpy(dst, src, n);
+                break;
+            case MEMOPS_SET:
+                if (ours)
+                    memset(dst, 0x5a, n);
+                else
+                    __real_memset(dst, 0x5a, n);
+                break;
+            case MEMOPS_CMP: // equal buffers: the whole length is compared
+                if (ours)
+                    memcmp(dst, src, n);
+                else
+                    __real_memcmp(dst, src, n);
+                break;
+        }
+        t = pmu_cycles() - t;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+static int sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+static void check_fill(void)
+{
+    unsigned i;
+
+    for (i = 0; i < MEMOPS_CHECK_BUF; ++i) {
+        check_src[i] = i * 7 + 0x80; // both halves of the byte range
+        check_ours[i] = check_newlib[i] = 0xee;
+    }
+}
+
+// The first few mismatches only, a broken routine mismatches all over
+static unsigned check_report(unsigned errors, const char *fn, size_t n, unsigned d, unsigned s)
+{
+    if (errors < MEMOPS_CHECK_REPORTS)
+        printf("ERROR: memops: %s mismatch: size %u, dst+%u, src+%u\r\n", fn, n, d, s);
+    return 1;
+}
+
+// Returns the number of mismatches against newlib
+static unsigned memops_check(void)
+{
+    unsigned errors = 0, d, s, k;
+    uint8_t *src, *ours, *newlib;
+    int r, v;
+    size_t n;
+
+    for (n = 0; n <= MEMOPS_CHECK_MAX; ++n) {
+        for (d = 0; d < MEMOPS_CHECK_OFFS; ++d) {
+            for (s = 0; s < MEMOPS_CHECK_OFFS; ++s) {
+                src = check_src + MEMOPS_CHECK_GUARD + s;
+                ours = check_ours + MEMOPS_CHECK_GUARD + d;
+                newlib = check_newlib + MEMOPS_CHECK_GUARD + d;
+
+                check_fill();
+                if (memcpy(ours, src, n) != ours)
+                    errors += check_report(errors, "memcpy return", n, d, s);
+                __real_memcpy(newlib, src, n);
+                if (__real_memcmp(check_ours, check_newlib, MEMOPS_CHECK_BUF))
+                    errors += check_report(errors, "memcpy", n, d, s);
+
+                if (s == 0) { // no source
+                    check_fill();
+                    if (memset(ours, 0x1a5, n) != ours) // only the low byte counts
+                        errors += check_report(errors, "memset return", n, d, s);
+                    __real_memset(newlib, 0x1a5, n);
+                    if (__real_memcmp(check_ours, check_newlib, MEMOPS_CHECK_BUF))
+                        errors += check_report(errors, "memset", n, d, s);
+                }
+
+                // Equal, then a difference at each position, both ways
+                check_fill();
+                __real_memcpy(ours, src, n);
+                if (memcmp(ours, src, n) != 0)
+                    errors += check_report(errors, "memcmp equal", n, d, s);
+                for (k = 0; k < n; ++k) {
+                    for (v = -1; v <= 1; v += 2) {
+                        ours[k] = src[k] + v;
+                        r = memcmp(ours, src, n);
+                        if (sign(r) != sign(__real_memcmp(ours, src, n)))
+                            errors += check_report(errors, "memcmp", n, d, s);
+                    }
+                    ours[k] = src[k];
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+// The timings only once the results match newlib's: on a mismatch the
+// BENCH results are missing, which fails tools/bench.sh
+void memops_bench(void)
+{
+    unsigned fn, a, s;
+    uint32_t ours, newlib;
+    uint8_t *dst, *src;
+    size_t n;
+
+    if (memops_check()) {
+        printf("ERROR: memops: results differ from newlib, no timings\r\n");
+        return;
+    }
+
+    for (s = 0; s < sizeof(memops_src); ++s)
+        memops_src[s] = s;
+
+    printf("memops: cycles, ours/newlib:\r\n");
+    printf("  %-6s %-8s", "", "");
+    for (s = 0; s < sizeof(memops_sizes) / sizeof(memops_sizes[0]); ++s)
+        printf(" %13u", memops_sizes[s]);
+    printf("\r\n");
+
+    for (fn = 0; fn < MEMOPS_FNS; ++fn) {
+        for (a = 0; a < sizeof(memops_aligns) / sizeof(memops_aligns[0]); ++a) {
+            dst = memops_dst + memops_aligns[a].dst;
+            src = memops_src + memops_aligns[a].src;
+            if (fn == MEMOPS_CMP)
+                __real_memcpy(dst, src, MEMOPS_MAX);
+            printf("  %-6s %-8s", memops_names[fn], memops_aligns[a].name);
+            for (s = 0; s < sizeof(memops_sizes) / sizeof(memops_sizes[0]); ++s) {
+                n = memops_sizes[s];
+                ours = memops_run(fn, 1, dst, src, n);
+                newlib = memops_run(fn, 0, dst, src, n);
+                printf(" %6lu/%-6lu", ours, newlib);
+#ifdef BENCH
+                if (a == 0 || a == 2) { // aligned and mutually misaligned
+                    char name[32];
+                    snprintf(name, sizeof(name), "%s_%u_%s", memops_names[fn], n,
+                             memops_aligns[a].name);
+                    bench_result(name, ours);
+                }
+#endif
+            }
+            printf("\r\n");
+        }
+    }
+}
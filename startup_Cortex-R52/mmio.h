@@ -0,0 +1,29 @@
+#ifndef MMIO_H
+#define MMIO_H
+
+#include <stdint.h>
+
+// Device register access. On target these are plain volatile accesses. In
+// the host build (-DHOST) they are routed to the software models of the
+// devices (HPSC mailbox IP, Cadence UART) in host/mmio_model.c, by address.
+
+#ifdef HOST
+
+uint32_t mmio_read32(volatile uint32_t *addr);
+void mmio_write32(volatile uint32_t *addr, uint32_t val);
+
+#else // !HOST
+
+static inline uint32_t mmio_read32(volatile uint32_t *addr)
+{
+    return *addr;
+}
+
+static inline void mmio_write32(volatile uint32_t *addr, uint32_t val)
+{
+    *addr = val;
+}
+
+#endif // !HOST
+
+#endif // MMIO_H
@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "cache.h"
+#include "pmu.h"
+#include "mpu.h"
+#include "memmap.h"
+
+// Linker symbols (startup.ld)
+extern unsigned char __text_start__, __text_end__;
+extern unsigned char __data_start__, __data_end__;
+extern unsigned char __stack_start__;
+extern unsigned char __tcm_a_end__;
+extern unsigned char __tcm_b_start__, __tcm_b_end__;
+
+#define MAIR_ATTR_WB      0xFF // Normal inner/outer write-back non-transient, RW-allocate
+#define MAIR_ATTR_DEVICE  0x04 // Device nGnRnE
+#define MAIR_ATTR_WT      0xBB // Normal inner/outer write-through non-transient, RW-allocate
+#define MAIR_ATTR_NC      0x44 // Normal inner/outer non-cacheable
+
+#define PRBAR_XN          (1 << 0)
+#define PRBAR_AP_SHIFT    1
+#define PRBAR_AP_MASK     (0x3 << PRBAR_AP_SHIFT)
+#define PRBAR_SH_SHIFT    3
+#define PRBAR_SH_MASK     (0x3 << PRBAR_SH_SHIFT)
+#define PRLAR_EN          (1 << 0)
+#define PRLAR_ATTR_SHIFT  1
+#define PRLAR_ATTR_MASK   (0x7 << PRLAR_ATTR_SHIFT)
+#define PR_ADDR_MASK      (~0x3fu)
+
+#define SCTLR_C           (1 << 2)
+
+// Regions must not overlap: an access that hits more than one region faults.
+// Note that the cache attributes have no effect on the TCMs. HPPS DRAM is
+// non-cacheable, since HPPS reads and writes it too, except the buffers
+// of the benchmarks, which no other master touches, and the log ring,
+// which is handed to HPPS with cache maintenance (shmlog.c).
+const struct mpu_region mpu_regions[MPU_REGIONS] = {
+    [0] = { /* Code */
+        .base = (uintptr_t)&__text_start__, .end = (uintptr_t)&__text_end__,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RO, .sh = MPU_SH_NONE, .xn = false },
+    [1] = { /* Data */
+        .base = (uintptr_t)&__data_start__, .end = (uintptr_t)&__data_end__,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [2] = { /* Stack */
+        .base = (uintptr_t)&__stack_start__, .end = (uintptr_t)&__tcm_a_end__,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [3] = { /* LSIO peripherals: UART, RTPS-TRCH mailbox */
+        .base = 0x30000000, .end = HPPS_DRAM_WINDOW_BASE,
+        .prof = MPU_PROF_DEVICE, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [MPU_REGION_HPPS_DRAM] = { /* HPPS DRAM window, below the benchmark buffers */
+        .base = HPPS_DRAM_WINDOW_BASE, .end = BENCH_DRAM_BASE,
+        .prof = MPU_PROF_NC, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = false },
+    [5] = { /* BTCM */
+        .base = (uintptr_t)&__tcm_b_start__, .end = (uintptr_t)&__tcm_b_end__,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = false },
+    [MPU_REGION_BENCH_DRAM] = { /* Benchmark buffers in HPPS DRAM, see memmap.h */
+        .base = BENCH_DRAM_BASE, .end = BENCH_DRAM_END,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [7] = { /* HPPS peripherals: HPPS mailboxes, GIC */
+        .base = HPPS_DRAM_WINDOW_END, .end = 0x0 /* end of address space */,
+        .prof = MPU_PROF_DEVICE, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [MPU_REGION_HPPS_DRAM_HI] = { /* HPPS DRAM window, above the benchmark buffers */
+        .base = BENCH_DRAM_END, .end = SHMLOG_BASE,
+        .prof = MPU_PROF_NC, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = false },
+    [MPU_REGION_SHMLOG] = { /* Log ring in HPPS DRAM, see shmlog.h */
+        .base = SHMLOG_BASE, .end = SHMLOG_END,
+        .prof = MPU_PROF_WB, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = true },
+    [10] = { /* HPPS DRAM window, above the log ring */
+        .base = SHMLOG_END, .end = HPPS_DRAM_WINDOW_END,
+        .prof = MPU_PROF_NC, .ap = MPU_AP_RW, .sh = MPU_SH_NONE, .xn = false },
+};
+
+static const char *mpu_prof_names[MPU_PROFILES] = {
+    [MPU_PROF_WB]     = "write-back",
+    [MPU_PROF_DEVICE] = "device",
+    [MPU_PROF_WT]     = "write-through",
+    [MPU_PROF_NC]     = "non-cacheable",
+};
+
+static inline void mpu_select(unsigned idx)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c6, c2, 1" : : "r" (idx)); // PRSELR
+    __asm__ __volatile__("isb");
+}
+
+static inline void mpu_write(uint32_t prbar, uint32_t prlar)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c6, c3, 0" : : "r" (prbar)); // PRBAR
+    __asm__ __volatile__("mcr p15, 0, %0, c6, c3, 1" : : "r" (prlar)); // PRLAR
+}
+
+static inline void mpu_read(uint32_t *prbar, uint32_t *prlar)
+{
+    __asm__ __volatile__("mrc p15, 0, %0, c6, c3, 0" : "=r" (*prbar));
+    __asm__ __volatile__("mrc p15, 0, %0, c6, c3, 1" : "=r" (*prlar));
+}
+
+static bool dcache_enabled(void)
+{
+    uint32_t sctlr;
+    __asm__ __volatile__("mrc p15, 0, %0, c1, c0, 0" : "=r" (sctlr));
+    return sctlr & SCTLR_C;
+}
+
+static void mpu_encode(const struct mpu_region *r, uint32_t *prbar, uint32_t *prlar)
+{
+    *prbar = ((uint32_t)r->base & PR_ADDR_MASK) | (r->sh << PRBAR_SH_SHIFT) |
+             (r->ap << PRBAR_AP_SHIFT) | (r->xn ? PRBAR_XN : 0);
+    if (r->end == r->base)
+        *prlar = 0;
+    else
+        *prlar = ((uint32_t)(r->end - 1) & PR_ADDR_MASK) | (r->prof << PRLAR_ATTR_SHIFT) | PRLAR_EN;
+}
+
+void mpu_init(void)
+{
+    uint32_t mair0 = MAIR_ATTR_WB << (MPU_PROF_WB * 8) |
+                     MAIR_ATTR_DEVICE << (MPU_PROF_DEVICE * 8) |
+                     MAIR_ATTR_WT << (MPU_PROF_WT * 8) |
+                     MAIR_ATTR_NC << (MPU_PROF_NC * 8);
+    uint32_t prbar, prlar;
+    unsigned i;
+
+    __asm__ __volatile__("mcr p15, 0, %0, c10, c2, 0" : : "r" (mair0)); // MAIR0
+
+    for (i = 0; i < MPU_REGIONS; ++i) {
+        mpu_encode(&mpu_regions[i], &prbar, &prlar);
+        mpu_select(i);
+        mpu_write(prbar, prlar);
+    }
+    __asm__ __volatile__("dsb" : : : "memory");
+    __asm__ __volatile__("isb");
+}
+
+int mpu_set_region(unsigned idx, const struct mpu_region *region)
+{
+    uint32_t prbar, prlar;
+
+    if (idx >= MPU_REGIONS || region->prof >= MPU_PROFILES) {
+        printf("ERROR: mpu: invalid region %u or profile %u\r\n", idx, region->prof);
+        return 1;
+    }
+
+    mpu_encode(region, &prbar, &prlar);
+
+    // Dirty lines must reach memory before the attributes change under them,
+    // and no stale lines may survive if the region becomes cacheable again.
+    if (dcache_enabled())
+        dcache_clean_invalidate_all();
+
+    __asm__ __volatile__("dsb" : : : "memory");
+    mpu_select(idx);
+    mpu_write(prbar, prlar);
+    __asm__ __volatile__("dsb" : : : "memory");
+    __asm__ __volatile__("isb");
+    return 0;
+}
+
+int mpu_get_region(unsigned idx, struct mpu_region *region)
+{
+    uint32_t prbar, prlar;
+
+    if (idx >= MPU_REGIONS)
+        return 1;
+
+    mpu_select(idx);
+    mpu_read(&prbar, &prlar);
+
+    region->base = prbar & PR_ADDR_MASK;
+    region->sh = (prbar & PRBAR_SH_MASK) >> PRBAR_SH_SHIFT;
+    region->ap = (prbar & PRBAR_AP_MASK) >> PRBAR_AP_SHIFT;
+    region->xn = prbar & PRBAR_XN;
+    region->prof = (prlar & PRLAR_ATTR_MASK) >> PRLAR_ATTR_SHIFT;
+    region->end = (prlar & PRLAR_EN) ? (prlar & PR_ADDR_MASK) + 64 : region->base;
+    return 0;
+}
+
+int mpu_set_profile(unsigned idx, mpu_prof_t prof)
+{
+    struct mpu_region region;
+
+    if (mpu_get_region(idx, &region))
+        return 1;
+    if (region.end == region.base) {
+        printf("ERROR: mpu: region %u not enabled\r\n", idx);
+        return 1;
+    }
+    region.prof = prof;
+    return mpu_set_region(idx, &region);
+}
+
+int mpu_disable_region(unsigned idx)
+{
+    struct mpu_region region = { 0 };
+    return mpu_set_region(idx, &region);
+}
+
+const char *mpu_prof_name(mpu_prof_t prof)
+{
+    return prof < MPU_PROFILES ? mpu_prof_names[prof] : "?";
+}
+
+void mpu_print(void)
+{
+    struct mpu_region r;
+    unsigned i;
+
+    for (i = 0; i < MPU_REGIONS; ++i) {
+        mpu_get_region(i, &r);
+        if (r.end == r.base)
+            continue;
+        printf("MPU region %2u: %08lx-%08lx %-13s %s%s\r\n", i, r.base, r.end - 1,
+               mpu_prof_name(r.prof), r.ap == MPU_AP_RO ? "RO" : "RW", r.xn ? " XN" : "");
+    }
+}
+
+// Buffer for the sort workload: in HPPS DRAM, since the cache attributes
+// do not apply to the TCMs, where everything else lives.
+#define MPU_BENCH_SORTS ((char *)MPU_BENCH_BUF)
+
+extern unsigned long compare_sorts_in(char *buffer);
+
+void mpu_bench(void)
+{
+    static const mpu_prof_t profs[] = { MPU_PROF_WB, MPU_PROF_WT, MPU_PROF_NC };
+    struct mpu_region orig;
+    unsigned i;
+
+    mpu_get_region(MPU_REGION_BENCH_DRAM, &orig);
+
+    for (i = 0; i < sizeof(profs) / sizeof(profs[0]); ++i) {
+        printf("MPU bench: sorts in the benchmark DRAM (%p), %s:\r\n", MPU_BENCH_SORTS, mpu_prof_name(profs[i]));
+        if (mpu_set_profile(MPU_REGION_BENCH_DRAM, profs[i]))
+            break;
+        unsigned long cycles = compare_sorts_in(MPU_BENCH_SORTS);
+        printf("MPU bench: %-13s %lu cycles\r\n", mpu_prof_name(profs[i]), cycles);
+    }
+
+    mpu_set_region(MPU_REGION_BENCH_DRAM, &orig);
+}
@@ -0,0 +1,63 @@
+#ifndef MPU_H
+#define MPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MPU_REGIONS 16 // EL1-controlled regions implemented on our Cortex-R52
+
+#define MPU_REGION_HPPS_DRAM    4 // HPPS DRAM window, shared with HPPS
+#define MPU_REGION_BENCH_DRAM   6 // benchmark buffers in HPPS DRAM, the region the benchmarks vary
+#define MPU_REGION_HPPS_DRAM_HI 8 // HPPS DRAM window between the benchmark buffers and the log ring
+#define MPU_REGION_SHMLOG       9 // log ring in HPPS DRAM, cacheable, see shmlog.h
+
+// Memory attribute profiles. The value is the MAIR index programmed by mpu_init().
+typedef enum {
+    MPU_PROF_WB     = 0, // Normal, write-back, read/write-allocate
+    MPU_PROF_DEVICE = 1, // Device-nGnRnE
+    MPU_PROF_WT     = 2, // Normal, write-through, read/write-allocate
+    MPU_PROF_NC     = 3, // Normal, non-cacheable
+    MPU_PROFILES
+} mpu_prof_t;
+
+typedef enum {
+    MPU_AP_RW = 0x1, // read/write at any EL
+    MPU_AP_RO = 0x3, // read-only at any EL
+} mpu_ap_t;
+
+typedef enum {
+    MPU_SH_NONE  = 0x0,
+    MPU_SH_OUTER = 0x2,
+    MPU_SH_INNER = 0x3,
+} mpu_sh_t;
+
+struct mpu_region {
+    uintptr_t base; // 64-byte aligned
+    uintptr_t end;  // exclusive, 64-byte aligned, 0 means end of address space; end == base means unused
+    mpu_prof_t prof;
+    mpu_ap_t ap;
+    mpu_sh_t sh;
+    bool xn;       // execute never
+};
+
+// Boot-time layout, indexed by region number
+extern const struct mpu_region mpu_regions[MPU_REGIONS];
+
+// Program MAIR and all regions from mpu_regions[]; called from startup.s
+// before the MPU is enabled
+void mpu_init(void);
+
+// Runtime (re)configuration; safe with the MPU and caches enabled, as long
+// as the code and stack in use stay mapped
+int mpu_set_region(unsigned idx, const struct mpu_region *region);
+int mpu_get_region(unsigned idx, struct mpu_region *region);
+int mpu_set_profile(unsigned idx, mpu_prof_t prof);
+int mpu_disable_region(unsigned idx);
+
+const char *mpu_prof_name(mpu_prof_t prof);
+void mpu_print(void);
+
+// Run the sorts on a buffer in a region under each cacheable profile
+void mpu_bench(void);
+
+#endif // MPU_H
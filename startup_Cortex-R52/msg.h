@@ -0,0 +1,114 @@
+#ifndef MSG_H
+#define MSG_H
+
+#include <stdint.h>
+
+#include "mailbox.h"
+#include "msg_schema.h"
+
+// Typed messages generated from msg_schema.h. For each REQ(name, ...):
+//
+//     struct msg_name, struct msg_name_reply
+//         Wire layout, packed, word aligned so that a received buffer
+//         (uint32_t *) can be read in place.
+//     unsigned msg_name_encode(uint32_t *buf, fields...)
+//     unsigned msg_name_reply_encode(uint32_t *buf, fields...)
+//         Fill buf, return the length in words for mbox_request/reply().
+//         Array fields are passed as pointers to n elements.
+//     const struct msg_name *msg_name_decode(const uint32_t *buf)
+//     const struct msg_name_reply *msg_name_reply_decode(const uint32_t *buf)
+//         Views of a received buffer, no copy.
+//     int msg_handle_name(volatile uint32_t *mbox_base,
+//                         const struct msg_name *req, struct msg_name_reply *reply)
+//         Implemented by the server, dispatched by msg_dispatch(); fills the
+//         reply in place and returns 0 to send it, or non-zero to send no
+//         reply now (e.g. a coroutine replies later, see coro.h).
+
+#define MSG_MAX_WORDS HPSC_MBOX_DATA_REGS
+
+#define MSG_FIELD_DECL(type, name)   type name;
+#define MSG_FIELD_PARAM(type, name)  , type name
+#define MSG_FIELD_STORE(type, name)  m->name = name;
+
+#define MSG_ARRAY_DECL(type, name, n)  type name[n];
+#define MSG_ARRAY_PARAM(type, name, n) , const type *name
+#define MSG_ARRAY_STORE(type, name, n) \
+    for (unsigned i = 0; i < (n); ++i) \
+        m->name[i] = name[i];
+
+#define MSG_ATTRS __attribute__((packed, aligned(4)))
+
+#define MSG_GEN(name, id, fields, reply_fields) \
+    struct msg_##name { \
+        uint32_t cmd; \
+        fields(MSG_FIELD_DECL, MSG_ARRAY_DECL) \
+    } MSG_ATTRS; \
+    struct msg_##name##_reply { \
+        reply_fields(MSG_FIELD_DECL, MSG_ARRAY_DECL) \
+    } MSG_ATTRS; \
+    _Static_assert(sizeof(struct msg_##name) <= MSG_MAX_WORDS * 4, \
+                   "msg_" #name " exceeds the mailbox data registers"); \
+    _Static_assert(sizeof(struct msg_##name##_reply) <= MSG_MAX_WORDS * 4, \
+                   "msg_" #name "_reply exceeds the mailbox data registers"); \
+    \
+    static inline unsigned msg_##name##_encode(uint32_t *buf fields(MSG_FIELD_PARAM, MSG_ARRAY_PARAM)) \
+    { \
+        struct msg_##name *m = (struct msg_##name *)buf; \
+        m->cmd = id; \
+        fields(MSG_FIELD_STORE, MSG_ARRAY_STORE) \
+        return (sizeof(*m) + 3) / 4; \
+    } \
+    static inline unsigned msg_##name##_reply_encode(uint32_t *buf reply_fields(MSG_FIELD_PARAM, MSG_ARRAY_PARAM)) \
+    { \
+        struct msg_##name##_reply *m = (struct msg_##name##_reply *)buf; \
+        reply_fields(MSG_FIELD_STORE, MSG_ARRAY_STORE) \
+        return (sizeof(*m) + 3) / 4; \
+    } \
+    static inline const struct msg_##name *msg_##name##_decode(const uint32_t *buf) \
+    { \
+        return (const struct msg_##name *)buf; \
+    } \
+    static inline const struct msg_##name##_reply *msg_##name##_reply_decode(const uint32_t *buf) \
+    { \
+        return (const struct msg_##name##_reply *)buf; \
+    } \
+    \
+    int msg_handle_##name(volatile uint32_t *mbox_base, \
+                          const struct msg_##name *req, struct msg_##name##_reply *reply);
+
+MSG_REQUESTS(MSG_GEN)
+
+// Routes (msg_schema.h): the route of a request, and setting one on a
+// request already encoded
+static inline unsigned msg_route(const uint32_t *msg)
+{
+    return msg[0] >> MSG_ROUTE_SHIFT;
+}
+
+static inline void msg_set_route(uint32_t *msg, unsigned route)
+{
+    msg[0] = (msg[0] & ((1u << MSG_ROUTE_SHIFT) - 1)) | route << MSG_ROUTE_SHIFT;
+}
+
+// Case of a switch on the command word of msg (a received uint32_t *):
+// calls the handler and sends its reply on mbox_base
+#define MSG_DISPATCH_CASE(name, id, fields, reply_fields) \
+    case id: { \
+        uint32_t reply_buf[MSG_MAX_WORDS]; \
+        struct msg_##name##_reply *reply = (struct msg_##name##_reply *)reply_buf; \
+        if (!msg_handle_##name(mbox_base, msg_##name##_decode(msg), reply)) \
+            mbox_reply(mbox_base, reply_buf, (sizeof(*reply) + 3) / 4); \
+        return 0; \
+    }
+
+// Returns 0 if the command is in the schema
+static inline int msg_dispatch(volatile uint32_t *mbox_base, const uint32_t *msg)
+{
+    switch (msg[0]) {
+        MSG_REQUESTS(MSG_DISPATCH_CASE)
+        default:
+            return 1;
+    }
+}
+
+#endif // MSG_H
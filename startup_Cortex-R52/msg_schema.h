@@ -0,0 +1,69 @@
+#ifndef MSG_SCHEMA_H
+#define MSG_SCHEMA_H
+
+// Mailbox protocol schema, shared by both ends (RTPS, TRCH): msg.h turns it
+// into packed structs, encoders, zero-copy decoders and handler prototypes.
+//
+// A request is a command word followed by its fields; its reply has only
+// its fields. Fields are listed in wire order; a message is at most
+// HPSC_MBOX_DATA_REGS words.
+//
+//     REQ(name, command id, request fields, reply fields)
+//
+// Field lists take F(type, name) and A(type, name, n) for arrays.
+//
+// Command field length is limited to 4-bits right now.
+//
+// Routed requests: RTPS forwards a request whose command word carries a
+// route above MSG_ROUTE_SHIFT to that endpoint, with the route cleared, and
+// forwards the reply back prefixed with a MSG_ROUTE_* status word; the
+// endpoint's reply must then fit in HPSC_MBOX_DATA_REGS - 1 words.
+
+#define MSG_ROUTE_SHIFT     8
+#define MSG_ROUTE_LOCAL     0 // handled by RTPS
+#define MSG_ROUTE_TRCH      1 // from HPPS
+#define MSG_ROUTE_HPPS      2 // from TRCH
+#define MSG_ROUTES          3
+
+#define MSG_ROUTE_OK        0
+#define MSG_ROUTE_BUSY      1 // too many requests in flight
+#define MSG_ROUTE_TIMEOUT   2 // no free lane or no reply in time
+#define MSG_ROUTE_NO_ROUTE  3
+
+#define CMD_ECHO       0x1
+#define CMD_TRACE      0x2
+#define CMD_RELAY      0x3
+
+#define MSG_REQUESTS(REQ) \
+    REQ(echo, CMD_ECHO, MSG_ECHO_FIELDS, MSG_ECHO_REPLY_FIELDS) \
+    REQ(trace, CMD_TRACE, MSG_TRACE_FIELDS, MSG_TRACE_REPLY_FIELDS) \
+    REQ(relay, CMD_RELAY, MSG_RELAY_FIELDS, MSG_RELAY_REPLY_FIELDS)
+
+#define MSG_ECHO_FIELDS(F, A) \
+    F(uint32_t, arg)
+#define MSG_ECHO_REPLY_FIELDS(F, A) \
+    F(uint32_t, arg)
+
+// Read out the function trace (trace.h), MSG_TRACE_EVENTS events at a time
+// from index on, index 0 being the oldest event; index 0 stops the trace.
+// Events are (ts, fn) word pairs as struct trace_event.
+#define MSG_TRACE_EVENTS 7
+#define MSG_TRACE_FIELDS(F, A) \
+    F(uint32_t, index)
+#define MSG_TRACE_REPLY_FIELDS(F, A) \
+    F(uint32_t, count)     /* events in this reply */ \
+    F(uint32_t, remaining) /* events after these */ \
+    A(uint32_t, events, MSG_TRACE_EVENTS * 2)
+
+// Echo of arg by TRCH, relayed by RTPS: the reply comes once TRCH replied,
+// or with a status other than OK
+#define MSG_RELAY_OK        0
+#define MSG_RELAY_BUSY      1 // no free lane to TRCH
+#define MSG_RELAY_TIMEOUT   2 // no reply from TRCH in time
+#define MSG_RELAY_FIELDS(F, A) \
+    F(uint32_t, arg)
+#define MSG_RELAY_REPLY_FIELDS(F, A) \
+    F(uint32_t, status) \
+    F(uint32_t, arg)
+
+#endif // MSG_SCHEMA_H
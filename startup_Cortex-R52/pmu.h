@@ -0,0 +1,50 @@
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+
+// PMU cycle counter (PMCCNTR). The counter is started in the EL2 reset
+// handler (see startup.s), so it counts cycles since reset unless someone
+// resets it with pmu_cycles_enable().
+
+#define PMCR_E      (1 << 0)  // enable all counters
+#define PMCR_C      (1 << 2)  // reset cycle counter
+#define PMCNTEN_C   (1 << 31) // cycle counter enable
+
+#ifdef HOST
+#include <time.h>
+
+// Host build: nanoseconds stand in for cycles
+static inline uint32_t pmu_cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static inline void pmu_cycles_enable(void)
+{
+}
+
+#else // !HOST
+
+static inline uint32_t pmu_cycles(void)
+{
+    uint32_t cycles;
+    __asm__ __volatile__("mrc p15, 0, %0, c9, c13, 0" : "=r" (cycles)); // PMCCNTR
+    return cycles;
+}
+
+static inline void pmu_cycles_enable(void)
+{
+    uint32_t pmcr;
+    __asm__ __volatile__("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmcr)); // PMCR
+    pmcr |= PMCR_E | PMCR_C;
+    __asm__ __volatile__("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+    __asm__ __volatile__("mcr p15, 0, %0, c9, c12, 1" : : "r" (PMCNTEN_C)); // PMCNTENSET
+    __asm__ __volatile__("isb");
+}
+
+#endif // !HOST
+
+#endif // PMU_H
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "printf.h"
+#include "intr.h"
+#include "pool.h"
+
+#define POOL_COUNT_MSG      32
+
+// Not zeroed at boot (NOLOAD), pool_init() builds the free lists
+#define POOL_STORAGE __attribute__((section(".tcm_b.pool"), aligned(8)))
+
+struct pool_obj {
+    struct pool_obj *next;
+};
+
+struct pool {
+    size_t obj_size;
+    unsigned count;
+    uint8_t *storage;
+    struct pool_obj *free;
+    unsigned used;
+    unsigned hwm;
+    unsigned allocs;
+    unsigned exhausted;
+};
+
+static uint8_t pool_msg[POOL_COUNT_MSG * POOL_SIZE_MSG] POOL_STORAGE;
+
+// Ordered by object size
+static struct pool pools[POOL_CLASSES] = {
+    { .obj_size = POOL_SIZE_MSG, .count = POOL_COUNT_MSG, .storage = pool_msg },
+};
+
+void pool_init(void)
+{
+    unsigned c, i;
+
+    for (c = 0; c < POOL_CLASSES; ++c) {
+        struct pool *p = &pools[c];
+        uint32_t irq = intr_save();
+        p->free = NULL;
+        for (i = p->count; i > 0; --i) {
+            struct pool_obj *obj = (struct pool_obj *)(p->storage + (i - 1) * p->obj_size);
+            obj->next = p->free;
+            p->free = obj;
+        }
+        p->used = p->hwm = p->allocs = p->exhausted = 0;
+        intr_restore(irq);
+    }
+}
+
+void *pool_alloc(size_t size)
+{
+    struct pool *p = NULL;
+    struct pool_obj *obj;
+    unsigned c;
+
+    for (c = 0; c < POOL_CLASSES; ++c) {
+        if (size <= pools[c].obj_size) {
+            p = &pools[c];
+            break;
+        }
+    }
+    if (!p)
+        return NULL;
+
+    uint32_t irq = intr_save();
+    obj = p->free;
+    if (obj) {
+        p->free = obj->next;
+        p->allocs++;
+        if (++p->used > p->hwm)
+            p->hwm = p->used;
+    } else {
+        p->exhausted++;
+    }
+    intr_restore(irq);
+    return obj;
+}
+
+void pool_free(void *obj)
+{
+    struct pool_obj *o = obj;
+    unsigned c;
+
+    if (!obj)
+        return;
+
+    for (c = 0; c < POOL_CLASSES; ++c) {
+        struct pool *p = &pools[c];
+        if ((uint8_t *)obj >= p->storage && (uint8_t *)obj < p->storage + p->count * p->obj_size) {
+            uint32_t irq = intr_save();
+            o->next = p->free;
+            p->free = o;
+            p->used--;
+            intr_restore(irq);
+            return;
+        }
+    }
+    printf("ERROR: pool: free of foreign object %p\r\n", obj);
+}
+
+int pool_get_stats(unsigned cls, struct pool_stats *stats)
+{
+    if (cls >= POOL_CLASSES)
+        return 1;
+
+    uint32_t irq = intr_save();
+    stats->obj_size = pools[cls].obj_size;
+    stats->count = pools[cls].count;
+    stats->used = pools[cls].used;
+    stats->hwm = pools[cls].hwm;
+    stats->allocs = pools[cls].allocs;
+    stats->exhausted = pools[cls].exhausted;
+    intr_restore(irq);
+    return 0;
+}
+
+void pool_report(void)
+{
+    struct pool_stats st;
+    unsigned c;
+
+    for (c = 0; c < POOL_CLASSES; ++c) {
+        pool_get_stats(c, &st);
+        printf("pool %4u B: %2u/%2u used, hwm %2u, allocs %u, exhausted %u\r\n",
+               st.obj_size, st.used, st.count, st.hwm, st.allocs, st.exhausted);
+    }
+}
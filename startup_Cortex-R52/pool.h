@@ -0,0 +1,31 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Fixed-size object pools, one per size class, with the objects in TCM B.
+// Allocation and free are O(1) (free-list pop/push with IRQs masked), so
+// they may be called from ISRs. No fallback to a larger class: a request
+// fails (NULL) when its class is exhausted, which is counted. A class per
+// size that has users: add one along with its first user.
+
+#define POOL_SIZE_MSG       64  // mailbox messages (HPSC_MBOX_DATA_REGS words)
+
+#define POOL_CLASSES 1
+
+struct pool_stats {
+    size_t obj_size;
+    unsigned count;     // total objects
+    unsigned used;      // currently allocated
+    unsigned hwm;       // high-water mark of used
+    unsigned allocs;    // successful allocations
+    unsigned exhausted; // failed allocations
+};
+
+void pool_init(void);
+void *pool_alloc(size_t size);
+void pool_free(void *obj);
+int pool_get_stats(unsigned cls, struct pool_stats *stats);
+void pool_report(void);
+
+#endif // POOL_H
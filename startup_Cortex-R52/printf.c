@@ -36,8 +36,17 @@
 #include <stdint.h>
 
 #include "printf.h"
+#include "spinlock.h"
+#include "shmlog.h"
 
 void _putchar(char);
+void _putbuf(const char* buf, size_t len);
+uint32_t uart_lock_room(size_t len);
+void uart_drain(void);
+
+// serializes printf output chunks (PRINTF_OUT_BUFFER_SIZE) on the UART,
+// between cores, with ISRs and with telemetry frames (uart.c)
+extern struct spinlock uart_lock;
 
 // ntoa conversion buffer size, this must be big enough to hold
 // one converted numeric number including padded zeros (dynamically created on stack)
@@ -47,9 +56,21 @@ void _putchar(char);
 // ftoa conversion buffer size, this must be big enough to hold
 // one converted float number including padded zeros (dynamically created on stack)
 // 32 byte is a good default
-#define PRINTF_FTOA_BUFFER_SIZE    32U
+#define PRINTF_FTOA_BUFFER_SIZE    64U
+
+// maximum precision of %f, the digits are exact at any precision
+#define PRINTF_FTOA_MAX_PRECISION  32U
+
+// %f up to this precision, and below 2^31, takes the single 64-bit product
+// path: no digit loop over a remainder like the exact one (make PRINTF_BENCH=1)
+#define PRINTF_FTOA_FAST_PRECISION 9U
 
-// define this to support floating point (%f)
+// output staging buffer size for printf and fctprintf_chunked, characters are
+// pushed to the device in runs of up to this size (created on stack)
+// 64 byte matches the UART TX FIFO depth
+#define PRINTF_OUT_BUFFER_SIZE     64U
+
+// define this to support floating point (%f, and %g for the shortest form)
 #define PRINTF_SUPPORT_FLOAT
 
 // define this to support long long types (%llu or %p)
@@ -88,6 +109,15 @@ typedef struct {
 } out_fct_wrap_type;
 
 
+// staging buffer (used as buffer) for chunked output
+typedef struct {
+  char   buf[PRINTF_OUT_BUFFER_SIZE];
+  size_t len;
+  void   (*flush)(const char* buf, size_t len, void* arg);
+  void*  arg;
+} out_chunk_type;
+
+
 // internal buffer output
 static inline void _out_buffer(char character, void* buffer, size_t idx, size_t maxlen)
 {
@@ -114,6 +144,70 @@ static inline void _out_char(char character, void* buffer, size_t idx, size_t ma
 }
 
 
+// internal chunked output: flush the staged characters
+static void _chunk_flush(out_chunk_type* chunk)
+{
+  if (chunk->len) {
+    chunk->flush(chunk->buf, chunk->len, chunk->arg);
+    chunk->len = 0U;
+  }
+}
+
+
+// internal chunked output: stage a run of characters, flush when full
+static void _chunk_append(out_chunk_type* chunk, const char* str, size_t len)
+{
+  while (len) {
+    size_t n = PRINTF_OUT_BUFFER_SIZE - chunk->len;
+    if (n > len) {
+      n = len;
+    }
+    for (size_t i = 0U; i < n; i++) {
+      chunk->buf[chunk->len + i] = str[i];
+    }
+    chunk->len += n;
+    str += n;
+    len -= n;
+    if (chunk->len == PRINTF_OUT_BUFFER_SIZE) {
+      _chunk_flush(chunk);
+    }
+  }
+}
+
+
+// internal chunked output, buffer is the staging buffer
+static inline void _out_chunk(char character, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)idx; (void)maxlen;
+  if (character) {
+    _chunk_append((out_chunk_type*)buffer, &character, 1U);
+  }
+}
+
+
+// internal _putbuf wrapper, flush function for printf: to the UART and/or
+// the log ring in shared memory (shmlog.h). uart_lock with IRQs masked for
+// one chunk at a time, only to queue it (uart.h): output of a printf from an
+// ISR may land between two chunks of the interrupted one, never inside a
+// chunk. The UART is waited for without the lock.
+static void _flush_putbuf(const char* buf, size_t len, void* arg)
+{
+  (void)arg;
+  const bool uart = shmlog_console & SHMLOG_CONSOLE_UART;
+  const uint32_t flags = uart ? uart_lock_room(len) : spin_lock_irqsave(&uart_lock);
+  if (shmlog_console & SHMLOG_CONSOLE_RING) {
+    shmlog_write(buf, len);
+  }
+  if (uart) {
+    _putbuf(buf, len);
+  }
+  spin_unlock_irqrestore(&uart_lock, flags);
+  if (uart) {
+    uart_drain();
+  }
+}
+
+
 // internal output function wrapper
 static inline void _out_fct(char character, void* buffer, size_t idx, size_t maxlen)
 {
@@ -123,6 +217,34 @@ static inline void _out_fct(char character, void* buffer, size_t idx, size_t max
 }
 
 
+// internal output of a run of characters, in bulk where the output allows
+// \return The index after the run
+static size_t _out_str(out_fct_type out, char* buffer, size_t idx, size_t maxlen, const char* str, size_t len)
+{
+  if (out == _out_chunk) {
+    _chunk_append((out_chunk_type*)buffer, str, len);
+    return idx + len;
+  }
+  if (out == _out_buffer) {
+    size_t n = (idx < maxlen) ? maxlen - idx : 0U;
+    if (n > len) {
+      n = len;
+    }
+    for (size_t i = 0U; i < n; i++) {
+      buffer[idx + i] = str[i];
+    }
+    return idx + len;
+  }
+  if (out == _out_null) {
+    return idx + len;
+  }
+  for (size_t i = 0U; i < len; i++) {
+    out(str[i], buffer, idx++, maxlen);
+  }
+  return idx;
+}
+
+
 // internal strlen
 // \return The length of the string (excluding the terminating 0)
 static inline unsigned int _strlen(const char* str)
@@ -221,6 +343,116 @@ static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t ma
 }
 
 
+// two-digit lookup table for decimal conversion
+static const char _digits_lut[200] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+
+// internal division-free decimal conversion of a 32-bit value, two digits
+// per step (quotient by 100 via reciprocal multiplication)
+// digits are written least significant first, like the rest of ntoa
+// \return The number of digits written
+static size_t _utoa_dec32(uint32_t value, char* buf, size_t maxlen)
+{
+  size_t len = 0U;
+  while ((value >= 100U) && (len + 2U <= maxlen)) {
+    const uint32_t q = (uint32_t)(((uint64_t)value * 0x51EB851FU) >> 37U);  // value / 100
+    const uint32_t r = value - q * 100U;
+    buf[len++] = _digits_lut[2U * r + 1U];
+    buf[len++] = _digits_lut[2U * r];
+    value = q;
+  }
+  if ((value >= 10U) && (len + 2U <= maxlen)) {
+    buf[len++] = _digits_lut[2U * value + 1U];
+    buf[len++] = _digits_lut[2U * value];
+  }
+  else if ((value < 10U) && (len < maxlen)) {
+    buf[len++] = (char)('0' + value);
+  }
+  return len;
+}
+
+
+// internal upper 64 bits of a 64x64-bit product, from 32x32-bit products
+static inline uint64_t _umulh64(uint64_t a, uint64_t b)
+{
+  const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32U;
+  const uint64_t b_lo = (uint32_t)b, b_hi = b >> 32U;
+  const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi;
+  const uint64_t cross = (lo_lo >> 32U) + (uint32_t)hi_lo + lo_hi;
+  return a_hi * b_hi + (hi_lo >> 32U) + (cross >> 32U);
+}
+
+
+// internal division-free decimal conversion of a 64-bit value, eight digits
+// per step (quotient by 10^8 via reciprocal multiplication)
+// \return The number of digits written
+static size_t _utoa_dec64(uint64_t value, char* buf, size_t maxlen)
+{
+  size_t len = 0U;
+  while ((value >> 32U) && (len + 8U <= maxlen)) {
+    const uint64_t q = _umulh64(value, 0xABCC77118461CEFDULL) >> 26U;  // value / 10^8
+    size_t n = _utoa_dec32((uint32_t)(value - q * 100000000ULL), buf + len, 8U);
+    while (n < 8U) {
+      buf[len + n++] = '0';
+    }
+    len += 8U;
+    value = q;
+  }
+  return len + _utoa_dec32((uint32_t)value, buf + len, maxlen - len);
+}
+
+
+// internal conversion for power-of-2 bases, shift is log2(base)
+// \return The number of digits written
+static size_t _utoa_pow2(unsigned long long value, unsigned int shift, bool uppercase, char* buf, size_t maxlen)
+{
+  const char* digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+  const unsigned int mask = (1U << shift) - 1U;
+  size_t len = 0U;
+  if (value <= 0xFFFFFFFFULL) {
+    // avoid 64-bit shifts where not needed
+    uint32_t v = (uint32_t)value;
+    do {
+      buf[len++] = digits[v & mask];
+      v >>= shift;
+    } while (v && (len < maxlen));
+  }
+  else {
+    do {
+      buf[len++] = digits[value & mask];
+      value >>= shift;
+    } while (value && (len < maxlen));
+  }
+  return len;
+}
+
+
+// internal digit generation for any base
+// \return The number of digits written
+static size_t _utoa(unsigned long long value, unsigned int base, unsigned int flags, char* buf, size_t maxlen)
+{
+  switch (base) {
+    case 10U :
+      return (value <= 0xFFFFFFFFULL) ? _utoa_dec32((uint32_t)value, buf, maxlen) : _utoa_dec64(value, buf, maxlen);
+    case 16U :
+      return _utoa_pow2(value, 4U, flags & FLAGS_UPPERCASE, buf, maxlen);
+    case 8U :
+      return _utoa_pow2(value, 3U, false, buf, maxlen);
+    case 2U :
+      return _utoa_pow2(value, 1U, false, buf, maxlen);
+    default : {
+      size_t len = 0U;
+      do {
+        const char digit = (char)(value % base);
+        buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
+        value /= base;
+      } while (value && (len < maxlen));
+      return len;
+    }
+  }
+}
+
+
 // internal itoa for 'long' type
 static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxlen, unsigned long value, bool negative, unsigned long base, unsigned int prec, unsigned int width, unsigned int flags)
 {
@@ -229,11 +461,7 @@ static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxl
 
   // write if precision != 0 and value is != 0
   if (!(flags & FLAGS_PRECISION) || value) {
-    do {
-      const char digit = (char)(value % base);
-      buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-      value /= base;
-    } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+    len = _utoa(value, (unsigned int)base, flags, buf, PRINTF_NTOA_BUFFER_SIZE);
   }
 
   return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int)base, prec, width, flags);
@@ -249,11 +477,7 @@ static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t
 
   // write if precision != 0 and value is != 0
   if (!(flags & FLAGS_PRECISION) || value) {
-    do {
-      const char digit = (char)(value % base);
-      buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-      value /= base;
-    } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+    len = _utoa(value, (unsigned int)base, flags, buf, PRINTF_NTOA_BUFFER_SIZE);
   }
 
   return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int)base, prec, width, flags);
@@ -262,95 +486,236 @@ static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t
 
 
 #if defined(PRINTF_SUPPORT_FLOAT)
-static size_t _ftoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+
+// Float conversion works on the IEEE 754 single precision bits with integer
+// arithmetic only: the value is f * 2^e, with an integer f < 2^24. Digits
+// are exact, and rounding is to nearest, ties to even.
+
+#define FLOAT_MANT_BITS   23U
+#define FLOAT_EXP_MASK    0xFFU
+#define FLOAT_EXP_BIAS    150  // 127 + FLOAT_MANT_BITS
+#define FLOAT_MIN_EXP     (-149)
+#define FLOAT_HIDDEN_BIT  (1UL << FLOAT_MANT_BITS)
+
+// big unsigned integers, large enough for the scaled values of any float
+#define BN_WORDS 8U
+
+typedef struct {
+  uint32_t w[BN_WORDS];  // least significant first
+  unsigned int n;        // number of significant words
+} _bn_type;
+
+
+static void _bn_set(_bn_type* a, uint32_t v)
 {
-  char buf[PRINTF_FTOA_BUFFER_SIZE];
-  size_t len  = 0U;
-  double diff = 0.0;
+  a->w[0] = v;
+  a->n = v ? 1U : 0U;
+}
 
-  // if input is larger than thres_max, revert to exponential
-  const double thres_max = (double)0x7FFFFFFF;
 
-  // powers of 10
-  static const double pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+static void _bn_mul_small(_bn_type* a, uint32_t m)
+{
+  uint32_t carry = 0U;
+  for (unsigned int i = 0U; i < a->n; i++) {
+    const uint64_t t = (uint64_t)a->w[i] * m + carry;
+    a->w[i] = (uint32_t)t;
+    carry = (uint32_t)(t >> 32U);
+  }
+  if (carry && (a->n < BN_WORDS)) {
+    a->w[a->n++] = carry;
+  }
+}
 
-  // test for negative
-  bool negative = false;
-  if (value < 0) {
-    negative = true;
-    value = 0 - value;
+
+static void _bn_mul_pow10(_bn_type* a, unsigned int n)
+{
+  static const uint32_t pow10[] = { 1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U, 100000000U };
+  while (n >= 9U) {
+    _bn_mul_small(a, 1000000000U);
+    n -= 9U;
   }
+  if (n) {
+    _bn_mul_small(a, pow10[n]);
+  }
+}
 
-  // limit precision
-  if (!(flags & FLAGS_PRECISION)) {
-    prec = 6U;  // by default, precesion is 6
+
+static void _bn_shl(_bn_type* a, unsigned int bits)
+{
+  const unsigned int words = bits / 32U, shift = bits % 32U;
+  unsigned int n = a->n + words + 1U;
+  if (!a->n) {
+    return;
   }
-  if (prec > 9U) {
-    // precision of >= 10 can lead to overflow errors
-    prec = 9U;
+  if (n > BN_WORDS) {
+    n = BN_WORDS;
   }
+  for (unsigned int i = n; i-- > 0U; ) {
+    const uint32_t hi = ((i >= words) && (i - words < a->n)) ? a->w[i - words] : 0U;
+    const uint32_t lo = ((i >= words + 1U) && (i - words - 1U < a->n)) ? a->w[i - words - 1U] : 0U;
+    a->w[i] = shift ? (hi << shift) | (lo >> (32U - shift)) : hi;
+  }
+  while (n && !a->w[n - 1U]) {
+    n--;
+  }
+  a->n = n;
+}
 
-  int whole = (int)value;
-  double tmp = (value - whole) * pow10[prec];
-  unsigned long frac = (unsigned long)tmp;
-  diff = tmp - frac;
 
-  if (diff > 0.5) {
-    ++frac;
-    // handle rollover, e.g. case 0.99 with prec 1 is 1.0
-    if (frac >= pow10[prec]) {
-      frac = 0;
-      ++whole;
+static int _bn_cmp(const _bn_type* a, const _bn_type* b)
+{
+  if (a->n != b->n) {
+    return a->n < b->n ? -1 : 1;
+  }
+  for (unsigned int i = a->n; i-- > 0U; ) {
+    if (a->w[i] != b->w[i]) {
+      return a->w[i] < b->w[i] ? -1 : 1;
     }
   }
-  else if ((diff == 0.5) && ((frac == 0U) || (frac & 1U))) {
-    // if halfway, round up if odd, OR if last digit is 0
-    ++frac;
+  return 0;
+}
+
+
+// r = a + b, r may be a
+static void _bn_add(_bn_type* r, const _bn_type* a, const _bn_type* b)
+{
+  const unsigned int n = a->n > b->n ? a->n : b->n;
+  uint32_t carry = 0U;
+  for (unsigned int i = 0U; i < n; i++) {
+    const uint64_t t = (uint64_t)(i < a->n ? a->w[i] : 0U) + (i < b->n ? b->w[i] : 0U) + carry;
+    r->w[i] = (uint32_t)t;
+    carry = (uint32_t)(t >> 32U);
+  }
+  r->n = n;
+  if (carry && (r->n < BN_WORDS)) {
+    r->w[r->n++] = carry;
   }
+}
 
-  // TBD: for very large numbers switch back to native sprintf for exponentials. Anyone want to write code to replace this?
-  // Normal printf behavior is to print EVERY whole number digit which can be 100s of characters overflowing your buffers == bad
-  if (value > thres_max) {
-    return 0U;
+
+// a -= b, a must be >= b
+static void _bn_sub(_bn_type* a, const _bn_type* b)
+{
+  uint32_t borrow = 0U;
+  for (unsigned int i = 0U; i < a->n; i++) {
+    const uint64_t t = (uint64_t)a->w[i] - (i < b->n ? b->w[i] : 0U) - borrow;
+    a->w[i] = (uint32_t)t;
+    borrow = (uint32_t)(t >> 32U) & 1U;
+  }
+  while (a->n && !a->w[a->n - 1U]) {
+    a->n--;
   }
+}
+
 
-  if (prec == 0U) {
-    diff = value - (double)whole;
-    if (diff > 0.5) {
-      // greater than 0.5, round up, e.g. 1.6 -> 2
-      ++whole;
+// internal shortest digits that read back as the same float (free-format
+// algorithm of Steele & White, as formulated by Burger & Dybvig)
+// value = 0.d1d2...dn * 10^k, f must be != 0
+// \return The number of digits n (at most 9)
+static unsigned int _ftoa_shortest(uint32_t f, int e, char* digits, int* k)
+{
+  _bn_type r, s, mp, mm, t;
+  const bool even = !(f & 1U);  // the interval bounds read back as f when f is even
+  unsigned int n = 0U;
+
+  _bn_set(&r, f);
+  if (e >= 0) {
+    if (f != FLOAT_HIDDEN_BIT) {
+      _bn_shl(&r, (unsigned int)e + 1U);
+      _bn_set(&s, 2U);
+      _bn_set(&mp, 1U);
+      _bn_shl(&mp, (unsigned int)e);
+      mm = mp;
     }
-    else if ((diff == 0.5) && (whole & 1)) {
-      // exactly 0.5 and ODD, then round up
-      // 1.5 -> 2, but 2.5 -> 2
-      ++whole;
+    else {
+      // the gap below a power of 2 is half the gap above
+      _bn_shl(&r, (unsigned int)e + 2U);
+      _bn_set(&s, 4U);
+      _bn_set(&mm, 1U);
+      _bn_shl(&mm, (unsigned int)e);
+      mp = mm;
+      _bn_shl(&mp, 1U);
     }
   }
   else {
-    unsigned int count = prec;
-    // now do fractional part, as an unsigned number
-    do {
-      --count;
-      buf[len++] = (char)(48U + (frac % 10U));
-    } while ((len < PRINTF_FTOA_BUFFER_SIZE) && (frac /= 10U));
-    // add extra 0s
-    while ((len < PRINTF_FTOA_BUFFER_SIZE) && (count-- > 0U)) {
-      buf[len++] = '0';
+    if ((e == FLOAT_MIN_EXP) || (f != FLOAT_HIDDEN_BIT)) {
+      _bn_shl(&r, 1U);
+      _bn_set(&s, 1U);
+      _bn_shl(&s, 1U - (unsigned int)e);
+      _bn_set(&mp, 1U);
+      _bn_set(&mm, 1U);
     }
-    if (len < PRINTF_FTOA_BUFFER_SIZE) {
-      // add decimal
-      buf[len++] = '.';
+    else {
+      _bn_shl(&r, 2U);
+      _bn_set(&s, 1U);
+      _bn_shl(&s, 2U - (unsigned int)e);
+      _bn_set(&mp, 2U);
+      _bn_set(&mm, 1U);
     }
   }
 
-  // do whole part, number is reversed
-  while (len < PRINTF_FTOA_BUFFER_SIZE) {
-    buf[len++] = (char)(48 + (whole % 10));
-    if (!(whole /= 10)) {
+  // estimate k = ceil(log10(value)) from below, from the binary exponent
+  const int bits = e + (int)(32U - (unsigned int)__builtin_clz(f)) - 1;  // floor(log2(value))
+  int est = (bits * 1233) >> 12;  // floor(bits * log10(2)), may be up to 2 low
+  if (est >= 0) {
+    _bn_mul_pow10(&s, (unsigned int)est);
+  }
+  else {
+    _bn_mul_pow10(&r, (unsigned int)-est);
+    _bn_mul_pow10(&mp, (unsigned int)-est);
+    _bn_mul_pow10(&mm, (unsigned int)-est);
+  }
+  // fix up the estimate
+  while (1) {
+    _bn_add(&t, &r, &mp);
+    const int c = _bn_cmp(&t, &s);
+    if (even ? (c < 0) : (c <= 0)) {
       break;
     }
+    _bn_mul_small(&s, 10U);
+    est++;
+  }
+  *k = est;
+
+  // generate digits until the rest is within the rounding interval
+  while (n < 9U) {
+    char d = 0;
+    _bn_mul_small(&r, 10U);
+    _bn_mul_small(&mp, 10U);
+    _bn_mul_small(&mm, 10U);
+    while (_bn_cmp(&r, &s) >= 0) {
+      _bn_sub(&r, &s);
+      d++;
+    }
+    const int c1 = _bn_cmp(&r, &mm);
+    _bn_add(&t, &r, &mp);
+    const int c2 = _bn_cmp(&t, &s);
+    const bool low = even ? (c1 <= 0) : (c1 < 0);
+    const bool high = even ? (c2 >= 0) : (c2 > 0);
+    if (!low && !high) {
+      digits[n++] = (char)('0' + d);
+      continue;
+    }
+    if (low && high) {
+      // closer to which end? 2r vs s
+      _bn_add(&t, &r, &r);
+      if (_bn_cmp(&t, &s) >= 0) {
+        d++;
+      }
+    }
+    else if (high) {
+      d++;
+    }
+    digits[n++] = (char)('0' + d);
+    break;
   }
+  return n;
+}
+
 
+// internal output of a float conversion: padding, sign, reversal
+static size_t _ftoa_format(out_fct_type out, char* buffer, size_t idx, size_t maxlen, char* buf, size_t len, bool negative, unsigned int width, unsigned int flags)
+{
   // pad leading zeros
   while (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD) && (len < width) && (len < PRINTF_FTOA_BUFFER_SIZE)) {
     buf[len++] = '0';
@@ -393,6 +758,275 @@ static size_t _ftoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, d
 
   return idx;
 }
+
+
+// internal inf/nan output
+// \return The index after the output, or 0 if value is finite
+static size_t _ftoa_special(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t bits, unsigned int width, unsigned int flags)
+{
+  char buf[4];
+  const char* str;
+  if (((bits >> FLOAT_MANT_BITS) & FLOAT_EXP_MASK) != FLOAT_EXP_MASK) {
+    return 0U;
+  }
+  if (bits & (FLOAT_HIDDEN_BIT - 1U)) {
+    str = (flags & FLAGS_UPPERCASE) ? "NAN" : "nan";
+  }
+  else {
+    str = (flags & FLAGS_UPPERCASE) ? "INF" : "inf";
+  }
+  buf[0] = str[2]; buf[1] = str[1]; buf[2] = str[0];
+  return _ftoa_format(out, buffer, idx, maxlen, buf, 3U, bits >> 31U, width, flags & ~FLAGS_ZEROPAD);
+}
+
+
+// internal shortest round-trip format (%g): fixed notation for moderate
+// exponents, else d.ddde+XX; precision is ignored
+static size_t _gtoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t bits, unsigned int width, unsigned int flags)
+{
+  char buf[PRINTF_FTOA_BUFFER_SIZE];
+  char str[PRINTF_FTOA_BUFFER_SIZE];  // forward, reversed into buf at the end
+  char digits[9];
+  size_t len = 0U;
+  int k = 1;
+  unsigned int n;
+
+  size_t ret = _ftoa_special(out, buffer, idx, maxlen, bits, width, flags);
+  if (ret) {
+    return ret;
+  }
+
+  const int exp_field = (int)((bits >> FLOAT_MANT_BITS) & FLOAT_EXP_MASK);
+  const uint32_t f = (bits & (FLOAT_HIDDEN_BIT - 1U)) | (exp_field ? FLOAT_HIDDEN_BIT : 0U);
+  if (f) {
+    n = _ftoa_shortest(f, exp_field ? exp_field - FLOAT_EXP_BIAS : FLOAT_MIN_EXP, digits, &k);
+  }
+  else {
+    digits[0] = '0';
+    n = 1U;
+  }
+
+  const int x = k - 1;  // decimal exponent in scientific notation
+  if ((x >= -4) && (x < 9)) {
+    if (k <= 0) {
+      str[len++] = '0';
+      str[len++] = '.';
+      for (int i = k; i < 0; i++) {
+        str[len++] = '0';
+      }
+      for (unsigned int i = 0U; i < n; i++) {
+        str[len++] = digits[i];
+      }
+    }
+    else {
+      for (int i = 0; i < k || i < (int)n; i++) {
+        if (i == k) {
+          str[len++] = '.';
+        }
+        str[len++] = i < (int)n ? digits[i] : '0';
+      }
+    }
+  }
+  else {
+    str[len++] = digits[0];
+    if (n > 1U) {
+      str[len++] = '.';
+      for (unsigned int i = 1U; i < n; i++) {
+        str[len++] = digits[i];
+      }
+    }
+    str[len++] = (flags & FLAGS_UPPERCASE) ? 'E' : 'e';
+    str[len++] = x < 0 ? '-' : '+';
+    const unsigned int ax = (unsigned int)(x < 0 ? -x : x);
+    if (ax >= 100U) {
+      str[len++] = (char)('0' + ax / 100U);
+    }
+    str[len++] = (char)('0' + ax / 10U % 10U);
+    str[len++] = (char)('0' + ax % 10U);
+  }
+
+  for (size_t i = 0U; i < len; i++) {
+    buf[i] = str[len - 1U - i];
+  }
+  return _ftoa_format(out, buffer, idx, maxlen, buf, len, bits >> 31U, width, flags);
+}
+
+
+// internal fixed notation digits in 32x32-bit integer arithmetic, the %f
+// fast path: bits finite, below 2^31, prec <= PRINTF_FTOA_FAST_PRECISION
+// the fraction bits times 10^prec fit 64 bits (24 + 30), so a single
+// multiply and shift gives all the digits, rounded like _ftoa_exact
+// digits are written reversed, like ntoa, without the sign
+// \return The number of characters written
+static size_t _ftoa_fast(uint32_t bits, unsigned int prec, char* buf)
+{
+  // powers of 10
+  static const uint32_t pow10[] = { 1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U, 100000000U, 1000000000U };
+  const int exp_field = (int)((bits >> FLOAT_MANT_BITS) & FLOAT_EXP_MASK);
+  const uint32_t f = (bits & (FLOAT_HIDDEN_BIT - 1U)) | (exp_field ? FLOAT_HIDDEN_BIT : 0U);
+  const int e = exp_field ? exp_field - FLOAT_EXP_BIAS : FLOAT_MIN_EXP;
+  uint32_t whole = 0U, frac = 0U;
+  size_t len = 0U;
+
+  if (e >= 0) {
+    whole = f << e;
+  }
+  else if (e > -64) {
+    // fraction bits below the binary point: (f & mask) / 2^nbits
+    const unsigned int nbits = (unsigned int)-e;
+    const uint64_t mask = (1ULL << nbits) - 1U;
+    const uint64_t tmp = (uint64_t)(uint32_t)(f & mask) * pow10[prec];
+    const uint64_t rem = tmp & mask, half = 1ULL << (nbits - 1U);
+    whole = (nbits < 32U) ? (f >> nbits) : 0U;
+    frac = (uint32_t)(tmp >> nbits);
+
+    // round to nearest, ties to even on the last digit printed
+    if ((rem > half) || ((rem == half) && ((prec ? frac : whole) & 1U))) {
+      if (++frac >= pow10[prec]) {
+        // rollover, e.g. case 0.99 with prec 1 is 1.0
+        frac = 0U;
+        ++whole;
+      }
+    }
+  }
+  // else below 2^-40: tmp < 2^54 is under half of 2^nbits, rounds to 0
+
+  if (prec) {
+    // fractional part, as an unsigned number, then the leading 0s
+    len = _utoa_dec32(frac, buf, prec);
+    while (len < prec) {
+      buf[len++] = '0';
+    }
+    buf[len++] = '.';
+  }
+
+  // whole part
+  return len + _utoa_dec32(whole, buf + len, PRINTF_FTOA_BUFFER_SIZE - len);
+}
+
+
+// internal fixed notation (%f), exact digits at any precision, bits are the
+// float's bits, finite
+static size_t _ftoa_exact(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t bits, unsigned int prec, unsigned int width, unsigned int flags)
+{
+  char buf[PRINTF_FTOA_BUFFER_SIZE];
+  char frac_digits[PRINTF_FTOA_MAX_PRECISION];
+  size_t len = 0U;
+  uint64_t whole;
+  bool round_up;
+
+  if (prec > PRINTF_FTOA_MAX_PRECISION) {
+    prec = PRINTF_FTOA_MAX_PRECISION;
+  }
+
+  const int exp_field = (int)((bits >> FLOAT_MANT_BITS) & FLOAT_EXP_MASK);
+  const uint32_t f = (bits & (FLOAT_HIDDEN_BIT - 1U)) | (exp_field ? FLOAT_HIDDEN_BIT : 0U);
+  const int e = exp_field ? exp_field - FLOAT_EXP_BIAS : FLOAT_MIN_EXP;
+
+  if (e >= 0) {
+    if (e > 40) {
+      // integer part does not fit 64 bits: use exponential notation
+      return _gtoa(out, buffer, idx, maxlen, bits, width, flags);
+    }
+    whole = (uint64_t)f << e;
+    for (unsigned int i = 0U; i < prec; i++) {
+      frac_digits[i] = '0';
+    }
+    round_up = false;
+  }
+  else {
+    // fraction bits below the binary point: frac / 2^nbits
+    const unsigned int nbits = (unsigned int)-e;
+    whole = (nbits < 32U) ? (f >> nbits) : 0U;
+    if (nbits <= 60U) {
+      // fast path: frac * 10 fits 64 bits
+      const uint64_t mask = (1ULL << nbits) - 1U;
+      uint64_t frac = f & mask;
+      for (unsigned int i = 0U; i < prec; i++) {
+        frac *= 10U;
+        frac_digits[i] = (char)('0' + (frac >> nbits));
+        frac &= mask;
+      }
+      const uint64_t half = 1ULL << (nbits - 1U);
+      round_up = (frac > half) || ((frac == half) && ((prec ? frac_digits[prec - 1U] : (char)whole) & 1));
+    }
+    else {
+      _bn_type frac, half;
+      _bn_set(&frac, (nbits < 32U) ? (f & ((1UL << nbits) - 1U)) : f);
+      for (unsigned int i = 0U; i < prec; i++) {
+        _bn_mul_small(&frac, 10U);
+        // the digit is in the bits at and above nbits
+        const unsigned int word = nbits / 32U, shift = nbits % 32U;
+        uint32_t d = 0U;
+        if (word < frac.n) {
+          d = frac.w[word] >> shift;
+          if (shift && (word + 1U < frac.n)) {
+            d |= frac.w[word + 1U] << (32U - shift);
+          }
+          frac.w[word] &= (1UL << shift) - 1U;
+          frac.n = word + 1U;
+          while (frac.n && !frac.w[frac.n - 1U]) {
+            frac.n--;
+          }
+        }
+        frac_digits[i] = (char)('0' + d);
+      }
+      _bn_set(&half, 1U);
+      _bn_shl(&half, nbits - 1U);
+      const int c = _bn_cmp(&frac, &half);
+      round_up = (c > 0) || ((c == 0) && ((prec ? frac_digits[prec - 1U] : (char)whole) & 1));
+    }
+  }
+
+  // round to nearest, ties to even
+  if (round_up) {
+    unsigned int i = prec;
+    while (i > 0U) {
+      if (frac_digits[--i] != '9') {
+        frac_digits[i]++;
+        break;
+      }
+      frac_digits[i] = '0';
+    }
+    if ((i == 0U) && ((prec == 0U) || (frac_digits[0] == '0'))) {
+      // rollover, e.g. case 0.99 with prec 1 is 1.0
+      whole++;
+    }
+  }
+
+  // number is reversed
+  for (unsigned int i = prec; i > 0U; i--) {
+    buf[len++] = frac_digits[i - 1U];
+  }
+  if (prec) {
+    buf[len++] = '.';
+  }
+  len += _utoa_dec64(whole, buf + len, PRINTF_FTOA_BUFFER_SIZE - len);
+
+  return _ftoa_format(out, buffer, idx, maxlen, buf, len, bits >> 31U, width, flags);
+}
+
+
+// internal fixed notation (%f), bits are the float's bits
+static size_t _ftoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t bits, unsigned int prec, unsigned int width, unsigned int flags)
+{
+  char buf[PRINTF_FTOA_BUFFER_SIZE];
+
+  size_t ret = _ftoa_special(out, buffer, idx, maxlen, bits, width, flags);
+  if (ret) {
+    return ret;
+  }
+
+  // limit precision
+  if (!(flags & FLAGS_PRECISION)) {
+    prec = 6U;  // by default, precesion is 6
+  }
+  if ((prec > PRINTF_FTOA_FAST_PRECISION) || ((bits & 0x7FFFFFFFU) >= 0x4F000000U)) {  // 2^31
+    return _ftoa_exact(out, buffer, idx, maxlen, bits, prec, width, flags);
+  }
+  const size_t len = _ftoa_fast(bits, prec, buf);
+  return _ftoa_format(out, buffer, idx, maxlen, buf, len, bits >> 31U, width, flags);
+}
 #endif  // PRINTF_SUPPORT_FLOAT
 
 
@@ -411,9 +1045,12 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
   {
     // format specifier?  %[flags][width][.precision][length]
     if (*format != '%') {
-      // no
-      out(*format, buffer, idx++, maxlen);
-      format++;
+      // no, output the literal run up to the next specifier at once
+      const char* run = format;
+      while (*format && (*format != '%')) {
+        format++;
+      }
+      idx = _out_str(out, buffer, idx, maxlen, run, (size_t)(format - run));
       continue;
     }
     else {
@@ -577,7 +1214,20 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
       case 'F' : {
             //double v = va_arg(va, double);
             unsigned v = va_arg(va, unsigned);
-            idx = _ftoa(out, buffer, idx, maxlen, *(float *)&v, precision, width, flags);
+            if (*format == 'F') {
+              flags |= FLAGS_UPPERCASE;
+            }
+            idx = _ftoa(out, buffer, idx, maxlen, v, precision, width, flags);
+            format++;
+        }
+        break;
+      case 'g' :
+      case 'G' : {
+            unsigned v = va_arg(va, unsigned);
+            if (*format == 'G') {
+              flags |= FLAGS_UPPERCASE;
+            }
+            idx = _gtoa(out, buffer, idx, maxlen, v, width, flags);
             format++;
         }
         break;
@@ -609,15 +1259,14 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
         if (flags & FLAGS_PRECISION) {
           l = (l < precision ? l : precision);
         }
+        const unsigned int len = l;
         if (!(flags & FLAGS_LEFT)) {
           while (l++ < width) {
             out(' ', buffer, idx++, maxlen);
           }
         }
         // string output
-        while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--)) {
-          out(*(p++), buffer, idx++, maxlen);
-        }
+        idx = _out_str(out, buffer, idx, maxlen, p, len);
         // post padding
         if (flags & FLAGS_LEFT) {
           while (l++ < width) {
@@ -673,8 +1322,10 @@ int printf(const char* format, ...)
 {
   va_list va;
   va_start(va, format);
-  char buffer[1];
-  const int ret = _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+  out_chunk_type chunk = { .len = 0U, .flush = _flush_putbuf, .arg = NULL };
+  // formatted without the lock, see _flush_putbuf()
+  const int ret = _vsnprintf(_out_chunk, (char*)&chunk, (size_t)-1, format, va);
+  _chunk_flush(&chunk);
   va_end(va);
   return ret;
 }
@@ -715,3 +1366,51 @@ int fctprintf(void (*out)(char character, void* arg), void* arg, const char* for
   va_end(va);
   return ret;
 }
+
+
+int fctprintf_chunked(void (*out)(const char* buf, size_t len, void* arg), void* arg, const char* format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  out_chunk_type chunk = { .len = 0U, .flush = out, .arg = arg };
+  const int ret = _vsnprintf(_out_chunk, (char*)&chunk, (size_t)-1, format, va);
+  _chunk_flush(&chunk);
+  va_end(va);
+  return ret;
+}
+
+
+#if defined(PRINTF_BENCH)
+///////////////////////////////////////////////////////////////////////////////
+// The conversions on their own, into buf, for printf_bench.c
+
+size_t printf_bench_ntoa_format(char* buf, size_t maxlen, char* digits, size_t len, unsigned int base, unsigned int width, bool zeropad)
+{
+  return _ntoa_format(_out_buffer, buf, 0U, maxlen, digits, len, false, base, 0U, width, zeropad ? FLAGS_ZEROPAD : 0U);
+}
+
+
+size_t printf_bench_conv(unsigned int conv, uint64_t value, char* buf, size_t maxlen)
+{
+  switch (conv) {
+    case PRINTF_CONV_DEC32 :
+      return _ntoa_long(_out_buffer, buf, 0U, maxlen, (uint32_t)value, false, 10U, 0U, 0U, 0U);
+    case PRINTF_CONV_HEX32 :
+      return _ntoa_long(_out_buffer, buf, 0U, maxlen, (uint32_t)value, false, 16U, 0U, 8U, FLAGS_ZEROPAD);
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+    case PRINTF_CONV_DEC64 :
+      return _ntoa_long_long(_out_buffer, buf, 0U, maxlen, value, false, 10U, 0U, 0U, 0U);
+#endif
+#if defined(PRINTF_SUPPORT_FLOAT)
+    case PRINTF_CONV_FLOAT :
+      return _ftoa(_out_buffer, buf, 0U, maxlen, (uint32_t)value, 6U, 0U, 0U);
+    case PRINTF_CONV_FLOAT_EXACT :
+      return _ftoa_exact(_out_buffer, buf, 0U, maxlen, (uint32_t)value, 6U, 0U, 0U);
+    case PRINTF_CONV_SHORTEST :
+      return _gtoa(_out_buffer, buf, 0U, maxlen, (uint32_t)value, 0U, 0U);
+#endif
+    default :
+      return 0U;
+  }
+}
+#endif  // PRINTF_BENCH
@@ -3,19 +3,51 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-// Workaround for GCC bug with variadic arguments for ARMv8 Aarch32
-// Wrap float arguments to printf with this macro like so:
+// %f and %g take a float's bits, not the double a float argument is
+// promoted to. Wrap float arguments to printf with this macro like so:
 //    float f = 4.2;
 //    printf("a floating value: %f\n", FLOAT_ARG(f));
-// The implementation of the workaround is to pass float arguments as unsigned,
-// and cast them back to float on the printf side.
-#define FLOAT_ARG(v) (*(unsigned *)&v)
+// This works around a GCC bug with variadic double arguments for ARMv8
+// AArch32: floats go as unsigned instead, and the conversions work on the
+// float's bits, which the exact %f and %g paths need anyway.
+static inline unsigned float_arg_bits(float v)
+{
+    const union { float value; unsigned bits; } u = { .value = v };
+    return u.bits;
+}
+#define FLOAT_ARG(v) float_arg_bits(v)
 
 int printf(const char* format, ...);
 int sprintf(char* buffer, const char* format, ...);
 int snprintf(char* buffer, size_t count, const char* format, ...);
 int vsnprintf(char* buffer, size_t count, const char* format, va_list va);
 int fctprintf(void (*out)(char character, void* arg), void* arg, const char* format, ...);
+// Like fctprintf, but out receives runs of up to 64 characters (not terminated)
+int fctprintf_chunked(void (*out)(const char* buf, size_t len, void* arg), void* arg, const char* format, ...);
+
+
+// Times the integer and float conversions against the previous routines,
+// built with make PRINTF_BENCH=1 (printf_bench.c)
+void printf_bench(void);
+
+#ifdef PRINTF_BENCH
+// The conversions of printf.c on their own, for printf_bench.c: output
+// into buf, returns its length (not terminated)
+enum {
+    PRINTF_CONV_DEC32,
+    PRINTF_CONV_HEX32,       // %08x
+    PRINTF_CONV_DEC64,
+    PRINTF_CONV_FLOAT,       // %f, value is the float's bits
+    PRINTF_CONV_FLOAT_EXACT, // %f always on the exact integer path
+    PRINTF_CONV_SHORTEST,    // %g
+};
+size_t printf_bench_conv(unsigned int conv, uint64_t value, char* buf, size_t maxlen);
+// Pads and reverses digits (least significant first) like the integer
+// conversions do
+size_t printf_bench_ntoa_format(char* buf, size_t maxlen, char* digits, size_t len, unsigned int base, unsigned int width, bool zeropad);
+#endif // PRINTF_BENCH
 
 #endif // PRINTF_H
@@ -0,0 +1,163 @@
+#ifdef PRINTF_BENCH
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "bench.h"
+
+// Times the conversions of printf.c (printf_bench_conv()) against the
+// previous integer routines, one division per digit, kept here for
+// reference, and %f against its exact path
+
+#define PRINTF_BENCH_ITERS  200
+#define PRINTF_BENCH_BUF    64
+#define PRINTF_BENCH_DIGITS 32
+
+typedef size_t (*bench_conv_t)(char *buf, size_t maxlen, unsigned i);
+
+static const uint32_t bench_u32[] = { 0, 7, 42, 1000, 65535, 123456789, 4000000000U, 4294967295U };
+static const uint64_t bench_u64[] = { 1, 1234567890123ULL, 9223372036854775807ULL, 18446744073709551615ULL };
+static const uint32_t bench_f32[] = { 0x3f700000, 0x40490fd0, 0xc2f6e979, 0x3727c5ac, 0x447a0000, 0x4479ffff };
+
+#define N_U32 (sizeof(bench_u32) / sizeof(bench_u32[0]))
+#define N_U64 (sizeof(bench_u64) / sizeof(bench_u64[0]))
+#define N_F32 (sizeof(bench_f32) / sizeof(bench_f32[0]))
+
+// Previous itoa: one division per digit
+static size_t ntoa_ref(char *buf, size_t maxlen, uint64_t value, unsigned base, unsigned width, bool zeropad)
+{
+    char digits[PRINTF_BENCH_DIGITS];
+    size_t len = 0;
+
+    do {
+        const char digit = (char)(value % base);
+        digits[len++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value && len < PRINTF_BENCH_DIGITS);
+    return printf_bench_ntoa_format(buf, maxlen, digits, len, base, width, zeropad);
+}
+
+// Previous itoa for 'long' type: the division on 32 bits
+static size_t ntoa_long_ref(char *buf, size_t maxlen, uint32_t value, unsigned base, unsigned width, bool zeropad)
+{
+    char digits[PRINTF_BENCH_DIGITS];
+    size_t len = 0;
+
+    do {
+        const char digit = (char)(value % base);
+        digits[len++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value && len < PRINTF_BENCH_DIGITS);
+    return printf_bench_ntoa_format(buf, maxlen, digits, len, base, width, zeropad);
+}
+
+static size_t dec32_new(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_DEC32, bench_u32[i % N_U32], buf, maxlen);
+}
+static size_t dec32_ref(char *buf, size_t maxlen, unsigned i)
+{
+    return ntoa_long_ref(buf, maxlen, bench_u32[i % N_U32], 10, 0, false);
+}
+static size_t hex32_new(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_HEX32, bench_u32[i % N_U32], buf, maxlen);
+}
+static size_t hex32_ref(char *buf, size_t maxlen, unsigned i)
+{
+    return ntoa_long_ref(buf, maxlen, bench_u32[i % N_U32], 16, 8, true);
+}
+static size_t dec64_new(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_DEC64, bench_u64[i % N_U64], buf, maxlen);
+}
+static size_t dec64_ref(char *buf, size_t maxlen, unsigned i)
+{
+    return ntoa_ref(buf, maxlen, bench_u64[i % N_U64], 10, 0, false);
+}
+static size_t float_new(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_FLOAT, bench_f32[i % N_F32], buf, maxlen);
+}
+static size_t float_exact(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_FLOAT_EXACT, bench_f32[i % N_F32], buf, maxlen);
+}
+static size_t shortest_new(char *buf, size_t maxlen, unsigned i)
+{
+    return printf_bench_conv(PRINTF_CONV_SHORTEST, bench_f32[i % N_F32], buf, maxlen);
+}
+
+static uint32_t bench_run(bench_conv_t conv)
+{
+    char buf[PRINTF_BENCH_BUF];
+    const uint32_t start = pmu_cycles();
+    unsigned i;
+
+    for (i = 0; i < PRINTF_BENCH_ITERS; ++i)
+        conv(buf, sizeof(buf), i);
+    return (pmu_cycles() - start) / PRINTF_BENCH_ITERS;
+}
+
+// Returns the number of inputs for which both conversions differ
+static unsigned bench_check(bench_conv_t conv, bench_conv_t ref, unsigned inputs)
+{
+    char buf[PRINTF_BENCH_BUF], buf_ref[PRINTF_BENCH_BUF];
+    unsigned mismatches = 0, i;
+    size_t len, len_ref, j;
+    bool same;
+
+    for (i = 0; i < inputs; ++i) {
+        len = conv(buf, sizeof(buf) - 1, i);
+        len_ref = ref(buf_ref, sizeof(buf_ref) - 1, i);
+        same = len == len_ref;
+        for (j = 0; same && j < len; ++j)
+            same = buf[j] == buf_ref[j];
+        if (!same) {
+            buf[len < sizeof(buf) ? len : sizeof(buf) - 1] = '\0';
+            buf_ref[len_ref < sizeof(buf_ref) ? len_ref : sizeof(buf_ref) - 1] = '\0';
+            printf("ERROR: printf bench: mismatch: '%s' != '%s'\r\n", buf, buf_ref);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static void bench_report(const char *name, bench_conv_t conv, bench_conv_t ref, const char *ref_name)
+{
+    const uint32_t t = bench_run(conv);
+
+    if (ref)
+        printf("printf bench: %-8s %6lu cycles/conv (%s %6lu)\r\n", name, t, ref_name, bench_run(ref));
+    else
+        printf("printf bench: %-8s %6lu cycles/conv\r\n", name, t);
+#ifdef BENCH
+    char bench_name[24];
+    snprintf(bench_name, sizeof(bench_name), "printf_%s", name);
+    bench_result(bench_name, t);
+#endif
+}
+
+void printf_bench(void)
+{
+    unsigned mismatches = 0;
+
+    // The previous routines are the reference for the integer conversions,
+    // the exact path for the fast %f one
+    mismatches += bench_check(dec32_new, dec32_ref, N_U32);
+    mismatches += bench_check(hex32_new, hex32_ref, N_U32);
+    mismatches += bench_check(dec64_new, dec64_ref, N_U64);
+    mismatches += bench_check(float_new, float_exact, N_F32);
+    printf("printf bench: outputs %s\r\n", mismatches ? "DIFFER" : "match");
+
+    bench_report("dec32", dec32_new, dec32_ref, "was");
+    bench_report("hex32", hex32_new, hex32_ref, "was");
+    bench_report("dec64", dec64_new, dec64_ref, "was");
+    bench_report("float", float_new, float_exact, "exact");
+    bench_report("shortest", shortest_new, NULL, NULL);
+}
+
+#endif // PRINTF_BENCH
@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "atomic.h"
+#include "ring.h"
+
+static bool is_pow2(unsigned n)
+{
+    return n && !(n & (n - 1));
+}
+
+int ring_spsc_init(struct ring_spsc *r, void **slots, unsigned size)
+{
+    if (!is_pow2(size)) {
+        printf("ERROR: ring: size not a power of 2: %u\r\n", size);
+        return 1;
+    }
+    r->head = r->tail = 0;
+    r->mask = size - 1;
+    r->slots = slots;
+    return 0;
+}
+
+unsigned ring_spsc_enqueue(struct ring_spsc *r, void * const *objs, unsigned n)
+{
+    uint32_t head = r->head;
+    uint32_t free = r->mask + 1 - (head - r->tail);
+    unsigned i;
+
+    if (n > free)
+        n = free;
+    if (!n)
+        return 0;
+
+    dmb(); // don't overwrite slots before the consumer is done with them (tail read)
+    for (i = 0; i < n; ++i)
+        r->slots[(head + i) & r->mask] = objs[i];
+    dmb(); // publish the objects before the index
+    r->head = head + n;
+    return n;
+}
+
+unsigned ring_spsc_dequeue(struct ring_spsc *r, void **objs, unsigned n)
+{
+    uint32_t tail = r->tail;
+    uint32_t avail = r->head - tail;
+    unsigned i;
+
+    if (n > avail)
+        n = avail;
+    if (!n)
+        return 0;
+
+    dmb(); // read the objects only after the index that published them
+    for (i = 0; i < n; ++i)
+        objs[i] = r->slots[(tail + i) & r->mask];
+    dmb(); // done reading the slots before handing them back
+    r->tail = tail + n;
+    return n;
+}
+
+unsigned ring_spsc_count(struct ring_spsc *r)
+{
+    return r->head - r->tail;
+}
+
+int ring_mpsc_init(struct ring_mpsc *r, struct ring_mpsc_slot *slots, unsigned size)
+{
+    unsigned i;
+
+    if (!is_pow2(size)) {
+        printf("ERROR: ring: size not a power of 2: %u\r\n", size);
+        return 1;
+    }
+    for (i = 0; i < size; ++i)
+        slots[i].seq = 0; // never equals position + 1 for the first lap
+    r->head = r->tail = 0;
+    r->mask = size - 1;
+    r->slots = slots;
+    return 0;
+}
+
+unsigned ring_mpsc_enqueue(struct ring_mpsc *r, void * const *objs, unsigned n)
+{
+    uint32_t head, free;
+    unsigned i;
+
+    // Reserve [head, head + n). Slots below tail have been fully consumed,
+    // so the free count derived from tail is conservative.
+    do {
+        head = r->head;
+        dmb();
+        free = r->mask + 1 - (head - r->tail);
+        if (n > free)
+            n = free;
+        if (!n)
+            return 0;
+    } while (!atomic_cas(&r->head, head, head + n));
+    dmb();
+
+    // Publish each slot separately: the consumer stops at the first slot
+    // whose producer has not finished yet.
+    for (i = 0; i < n; ++i) {
+        struct ring_mpsc_slot *slot = &r->slots[(head + i) & r->mask];
+        slot->obj = objs[i];
+        dmb();
+        slot->seq = head + i + 1;
+    }
+    return n;
+}
+
+unsigned ring_mpsc_dequeue(struct ring_mpsc *r, void **objs, unsigned n)
+{
+    uint32_t tail = r->tail;
+    unsigned i;
+
+    for (i = 0; i < n; ++i) {
+        struct ring_mpsc_slot *slot = &r->slots[(tail + i) & r->mask];
+        if (slot->seq != tail + i + 1)
+            break;
+        dmb(); // read the object only after its sequence number
+        objs[i] = slot->obj;
+    }
+    if (!i)
+        return 0;
+
+    dmb(); // done reading the slots before handing them back
+    r->tail = tail + i;
+    return i;
+}
+
+unsigned ring_mpsc_count(struct ring_mpsc *r)
+{
+    return r->head - r->tail;
+}
+
+#define RING_BENCH_SIZE     64
+#define RING_BENCH_OPS      4096
+#define RING_BENCH_BATCH    16
+
+static struct ring_spsc bench_spsc;
+static struct ring_mpsc bench_mpsc;
+static void *bench_spsc_slots[RING_BENCH_SIZE];
+static struct ring_mpsc_slot bench_mpsc_slots[RING_BENCH_SIZE];
+
+static void ring_bench_print(const char *name, unsigned batch, uint32_t cycles)
+{
+    printf("ring bench: %s batch %2u: %lu cycles for %u objs, %lu cycles/obj\r\n",
+           name, batch, cycles, RING_BENCH_OPS, cycles / RING_BENCH_OPS);
+}
+
+// Throughput of a producer/consumer pair taking turns on one core: the
+// cost of the ring operations themselves, without contention.
+void ring_bench(void)
+{
+    void *objs[RING_BENCH_BATCH];
+    unsigned batch, i, n;
+    uint32_t start;
+
+    for (i = 0; i < RING_BENCH_BATCH; ++i)
+        objs[i] = (void *)(uintptr_t)(i + 1);
+
+    for (batch = 1; batch <= RING_BENCH_BATCH; batch *= 4) {
+        ring_spsc_init(&bench_spsc, bench_spsc_slots, RING_BENCH_SIZE);
+        start = pmu_cycles();
+        for (n = 0; n < RING_BENCH_OPS; n += batch) {
+            ring_spsc_enqueue(&bench_spsc, objs, batch);
+            ring_spsc_dequeue(&bench_spsc, objs, batch);
+        }
+        ring_bench_print("SPSC", batch, pmu_cycles() - start);
+
+        ring_mpsc_init(&bench_mpsc, bench_mpsc_slots, RING_BENCH_SIZE);
+        start = pmu_cycles();
+        for (n = 0; n < RING_BENCH_OPS; n += batch) {
+            ring_mpsc_enqueue(&bench_mpsc, objs, batch);
+            ring_mpsc_dequeue(&bench_mpsc, objs, batch);
+        }
+        ring_bench_print("MPSC", batch, pmu_cycles() - start);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#include "cache.h"
+
+// Lock-free bounded rings of pointers, for handing work from ISRs to the
+// main loop. The size must be a power of two. The producer and consumer
+// indexes are on separate cache lines, so that the two sides do not
+// contend for a line when the ring lives in cacheable memory.
+//
+// Enqueue/dequeue are "burst" operations: they move as many objects as fit
+// (or are available), up to n, and return how many were moved.
+//
+// SPSC: one producer and one consumer, e.g. one ISR to the main loop.
+// MPSC: any number of producers (ISRs, nested ISRs, thread context, other
+//       cores), one consumer. A producer never waits for another one (a
+//       preempted producer delays only the consumer), so it is safe to
+//       enqueue from an ISR that interrupted an enqueue in progress.
+
+struct ring_spsc {
+    volatile uint32_t head CACHE_ALIGNED; // written by producer
+    volatile uint32_t tail CACHE_ALIGNED; // written by consumer
+    uint32_t mask CACHE_ALIGNED;
+    void **slots;
+};
+
+struct ring_mpsc_slot {
+    volatile uint32_t seq; // position + 1 once the object is published
+    void *obj;
+};
+
+struct ring_mpsc {
+    volatile uint32_t head CACHE_ALIGNED; // reserved by producers (LDREX/STREX)
+    volatile uint32_t tail CACHE_ALIGNED; // written by consumer
+    uint32_t mask CACHE_ALIGNED;
+    struct ring_mpsc_slot *slots;
+};
+
+int ring_spsc_init(struct ring_spsc *r, void **slots, unsigned size);
+unsigned ring_spsc_enqueue(struct ring_spsc *r, void * const *objs, unsigned n);
+unsigned ring_spsc_dequeue(struct ring_spsc *r, void **objs, unsigned n);
+unsigned ring_spsc_count(struct ring_spsc *r);
+
+int ring_mpsc_init(struct ring_mpsc *r, struct ring_mpsc_slot *slots, unsigned size);
+unsigned ring_mpsc_enqueue(struct ring_mpsc *r, void * const *objs, unsigned n);
+unsigned ring_mpsc_dequeue(struct ring_mpsc *r, void **objs, unsigned n);
+unsigned ring_mpsc_count(struct ring_mpsc *r);
+
+void ring_bench(void);
+
+#endif // RING_H
@@ -0,0 +1,197 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "mailbox.h"
+#include "msg.h"
+#include "busid.h"
+#include "timer.h"
+#include "coro.h"
+
+#include "router.h"
+
+struct route {
+    const char *name;
+    volatile uint32_t *ip_base;
+    unsigned first_instance;
+    unsigned lanes;
+    struct coro_client client;
+    // Stats
+    uint32_t requests;
+    uint32_t replies;       // with MSG_ROUTE_OK
+    uint32_t busy, timeouts;
+    unsigned inflight, inflight_max;
+    uint64_t lat_total, lat_min, lat_max; // in timer ticks
+    uint64_t first, last;   // the first request, the last reply
+};
+
+struct txn {
+    struct coro coro; // first, see txn_run()
+    bool busy;
+    struct route *route;
+    volatile uint32_t *mbox_base; // to reply on
+    uint32_t msg[MSG_MAX_WORDS];  // the request, then the reply to it
+    struct coro_call *call;
+    uint64_t start;
+};
+
+// To TRCH: the TRCH instances after the relay lanes of command.c, served
+// by the same echo server on TRCH. To HPPS: the HPPS instances after the
+// HPPS lanes (main.c), served by HPPS.
+static struct route routes[MSG_ROUTES] = {
+    [MSG_ROUTE_TRCH] = {
+        .name = "trch",
+        .ip_base = RTPS_TRCH_MBOX_BASE,
+        .first_instance = 4,
+        .lanes = 4,
+    },
+    [MSG_ROUTE_HPPS] = {
+        .name = "hpps",
+        .ip_base = HPPS_RTPS_MBOX_BASE,
+        .first_instance = 4,
+        .lanes = 2,
+    },
+};
+
+static struct txn txns[ROUTER_TXNS];
+
+int router_init(void)
+{
+    struct route *rt;
+    unsigned i;
+    int rc = 0;
+
+    for (i = 0; i < MSG_ROUTES; ++i) {
+        rt = &routes[i];
+        if (!rt->lanes)
+            continue;
+        rt->lat_min = UINT64_MAX;
+        if (coro_client_init(&rt->client, rt->ip_base, rt->first_instance, rt->lanes,
+                             MASTER_ID_RTPS_CPU0)) {
+            printf("ERROR: router: route %s: no client\r\n", rt->name);
+            rt->lanes = 0; // requests get MSG_ROUTE_NO_ROUTE
+            rc = 1;
+        }
+    }
+    return rc;
+}
+
+static void route_reply(volatile uint32_t *mbox_base, uint32_t status)
+{
+    mbox_reply(mbox_base, &status, 1);
+}
+
+static int txn_run(struct coro *c)
+{
+    struct txn *t = (struct txn *)c;
+    struct route *rt = t->route;
+    uint64_t lat;
+    unsigned i;
+
+    CORO_BEGIN(c);
+    coro_timeout_start(c, coro_ms(ROUTER_TIMEOUT_MS));
+    CORO_WAIT_UNTIL(c, (t->call = coro_call_get(&rt->client, c)) != NULL || c->timed_out);
+    if (t->call) {
+        coro_call_send(t->call, t->msg, MSG_MAX_WORDS);
+        CORO_WAIT_UNTIL(c, coro_call_replied(t->call) || c->timed_out);
+    }
+    coro_timeout_stop(c);
+
+    if (t->call && coro_call_replied(t->call)) {
+        t->msg[0] = MSG_ROUTE_OK;
+        for (i = 1; i < MSG_MAX_WORDS; ++i)
+            t->msg[i] = t->call->reply[i - 1];
+        mbox_reply(t->mbox_base, t->msg, MSG_MAX_WORDS);
+
+        rt->replies++;
+        rt->last = timer_now();
+        lat = rt->last - t->start;
+        rt->lat_total += lat;
+        if (lat < rt->lat_min)
+            rt->lat_min = lat;
+        if (lat > rt->lat_max)
+            rt->lat_max = lat;
+    } else {
+        route_reply(t->mbox_base, MSG_ROUTE_TIMEOUT);
+        rt->timeouts++;
+    }
+    if (t->call)
+        coro_call_put(t->call);
+    CORO_END(c);
+}
+
+static void txn_done(struct coro *c)
+{
+    struct txn *t = (struct txn *)c;
+
+    t->route->inflight--;
+    t->busy = false;
+}
+
+void router_request(volatile uint32_t *mbox_base, const uint32_t *msg)
+{
+    unsigned route = msg_route(msg);
+    struct route *rt;
+    struct txn *t;
+    unsigned i;
+
+    if (route >= MSG_ROUTES || !routes[route].lanes) {
+        printf("ERROR: router: no route %u: cmd %x\r\n", route, msg[0]);
+        route_reply(mbox_base, MSG_ROUTE_NO_ROUTE);
+        return;
+    }
+    rt = &routes[route];
+    rt->requests++;
+
+    for (i = 0; i < ROUTER_TXNS && txns[i].busy; ++i)
+        ;
+    if (i == ROUTER_TXNS) {
+        rt->busy++;
+        route_reply(mbox_base, MSG_ROUTE_BUSY);
+        return;
+    }
+    t = &txns[i];
+    t->busy = true;
+    t->route = rt;
+    t->mbox_base = mbox_base;
+    for (i = 0; i < MSG_MAX_WORDS; ++i)
+        t->msg[i] = msg[i];
+    msg_set_route(t->msg, MSG_ROUTE_LOCAL); // for the endpoint
+    t->call = NULL;
+    t->start = timer_now();
+    if (rt->requests == 1)
+        rt->first = t->start;
+    if (++rt->inflight > rt->inflight_max)
+        rt->inflight_max = rt->inflight;
+    coro_start(&t->coro, txn_run, EVENT_PRIO_NORMAL, txn_done);
+}
+
+static uint32_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_freq();
+}
+
+void router_report(void)
+{
+    struct route *rt;
+    uint64_t span;
+    unsigned i;
+
+    printf("router: %-5s %8s %8s %5s %8s %8s %7s %7s %8s %8s %8s %10s\r\n", "route", "requests",
+           "replies", "busy", "timeouts", "inflight", "no lane", "reclaim", "lat min", "lat avg",
+           "lat max", "replies/s");
+    for (i = 0; i < MSG_ROUTES; ++i) {
+        rt = &routes[i];
+        if (!rt->lanes)
+            continue;
+        span = rt->replies ? rt->last - rt->first : 0;
+        printf("        %-5s %8lu %8lu %5lu %8lu %8u %7lu %7lu %8lu %8lu %8lu %10lu\r\n", rt->name,
+               rt->requests, rt->replies, rt->busy, rt->timeouts, rt->inflight_max,
+               rt->client.no_lane, rt->client.reclaimed,
+               rt->replies ? ticks_to_us(rt->lat_min) : 0,
+               rt->replies ? ticks_to_us(rt->lat_total / rt->replies) : 0,
+               ticks_to_us(rt->lat_max),
+               span ? (uint32_t)((uint64_t)rt->replies * timer_freq() / span) : 0);
+    }
+    printf("        inflight: max, reclaim: lanes reused without their reply, latencies in us\r\n");
+}
@@ -0,0 +1,32 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdint.h>
+
+// Request router: RTPS forwards requests that HPPS or TRCH tagged with a
+// route (msg_schema.h) to the route's endpoint and sends its replies back:
+// HPPS to TRCH (MSG_ROUTE_TRCH) and TRCH to HPPS (MSG_ROUTE_HPPS), both
+// through cmd_handle() (command.h). Each request is a transaction run by a
+// coroutine (coro.h), so that requests from all lanes of the requester are
+// in flight to the endpoint at once, one per lane of the endpoint; a
+// request that finds no free lane waits for one.
+//
+// Replies carry no tag: the endpoint replies on the lane of the request,
+// and the transaction that holds the lane replies on the lane that the
+// request came in on. A request that timed out holds its lane until
+// the endpoint replies to it (coro.h).
+//
+// Per route, counted: requests, replies, refusals (busy, timeout, no
+// route), the high-water mark of transactions in flight, the latency from
+// the request to the reply to the requester and the reply throughput.
+
+#define ROUTER_TXNS         8   // transactions in flight, over all routes
+#define ROUTER_TIMEOUT_MS   100 // for a lane and the reply, together
+
+int router_init(void);
+// Takes a routed request (msg_route(msg) != MSG_ROUTE_LOCAL) received on
+// mbox_base, replies to it on mbox_base now or once routed
+void router_request(volatile uint32_t *mbox_base, const uint32_t *msg);
+void router_report(void);
+
+#endif // ROUTER_H
@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "cache.h"
+#include "shmlog.h"
+
+_Static_assert((SHMLOG_SIZE & (SHMLOG_SIZE - 1)) == 0, "SHMLOG_SIZE must be a power of 2");
+_Static_assert(SHMLOG_HDR_SIZE + SHMLOG_SIZE <= SHMLOG_REGION_SIZE, "the ring must fit its place in memmap.h");
+_Static_assert(SHMLOG_READER_OFFSET == CACHE_LINE_SIZE && SHMLOG_HDR_SIZE == 2 * CACHE_LINE_SIZE,
+               "the writer's and the reader's fields each in their own cache line");
+_Static_assert(SHMLOG_BASE >= BENCH_DRAM_END && SHMLOG_BASE + SHMLOG_REGION_SIZE <= RTPS_DRAM_END,
+               "the ring must be in the RTPS carve-out, clear of the benchmark buffers");
+
+#ifdef HOST
+// Host build: a buffer stands in for the HPPS DRAM
+static uint32_t shmlog_mem[(SHMLOG_HDR_SIZE + SHMLOG_SIZE) / 4];
+#define SHMLOG ((struct shmlog *)shmlog_mem)
+#else // !HOST
+#define SHMLOG ((struct shmlog *)SHMLOG_BASE)
+#endif // !HOST
+
+#define SHMLOG_BENCH_LINES 100
+
+unsigned shmlog_console = SHMLOG_CONSOLE_UART;
+
+static uint32_t shmlog_writes;
+
+void shmlog_init(void)
+{
+    struct shmlog *log = SHMLOG;
+
+    log->magic = 0; // not valid while resetting
+    shbuf_release(log, SHMLOG_HDR_SIZE);
+    log->size = SHMLOG_SIZE;
+    log->write = 0;
+    log->wraps = 0;
+    log->read = 0;
+    shbuf_release(log, SHMLOG_HDR_SIZE);
+    log->magic = SHMLOG_MAGIC;
+    shbuf_release(log, SHMLOG_HDR_SIZE);
+}
+
+// The text first, then write: a reader that sees the new write sees the text
+void shmlog_write(const char *buf, size_t len)
+{
+    struct shmlog *log = SHMLOG;
+    uint32_t write = log->write;
+    size_t n, i, off;
+
+    while (len) {
+        n = len < SHMLOG_MAX_WRITE ? len : SHMLOG_MAX_WRITE;
+        off = write & (SHMLOG_SIZE - 1);
+        if (off + n > SHMLOG_SIZE) { // wraps: in two runs
+            for (i = 0; i < SHMLOG_SIZE - off; ++i)
+                log->text[off + i] = buf[i];
+            for (; i < n; ++i)
+                log->text[i - (SHMLOG_SIZE - off)] = buf[i];
+            shbuf_release(&log->text[off], SHMLOG_SIZE - off);
+            shbuf_release(&log->text[0], n - (SHMLOG_SIZE - off));
+        } else {
+            for (i = 0; i < n; ++i)
+                log->text[off + i] = buf[i];
+            shbuf_release(&log->text[off], n);
+        }
+        if (off + n >= SHMLOG_SIZE)
+            log->wraps++;
+        write += n;
+        log->write = write;
+        shbuf_release(log, SHMLOG_READER_OFFSET); // not the reader's line
+        buf += n;
+        len -= n;
+    }
+    shmlog_writes++;
+}
+
+const struct shmlog *shmlog_ring(void)
+{
+    return SHMLOG;
+}
+
+uint32_t shmlog_reader(void)
+{
+    struct shmlog *log = SHMLOG;
+
+    shbuf_acquire((uint8_t *)log + SHMLOG_READER_OFFSET, CACHE_LINE_SIZE);
+    return log->read;
+}
+
+void shmlog_report(void)
+{
+    struct shmlog *log = SHMLOG;
+    uint32_t read = shmlog_reader();
+
+    printf("shmlog: %p: %lu bytes in %lu writes, %lu wraps, reader at %lu (%lu behind)\r\n",
+           log, log->write, shmlog_writes, log->wraps, read, log->write - read);
+}
+
+static uint32_t bench_lines(unsigned console)
+{
+    unsigned saved = shmlog_console;
+    uint32_t start;
+    unsigned i;
+
+    shmlog_console = console;
+    start = pmu_cycles();
+    for (i = 0; i < SHMLOG_BENCH_LINES; ++i)
+        printf("shmlog bench: line %u of %u\r\n", i, SHMLOG_BENCH_LINES);
+    start = pmu_cycles() - start;
+    shmlog_console = saved;
+    return start / SHMLOG_BENCH_LINES;
+}
+
+void shmlog_bench(void)
+{
+    uint32_t uart = bench_lines(SHMLOG_CONSOLE_UART);
+    uint32_t ring = bench_lines(SHMLOG_CONSOLE_RING);
+
+    printf("shmlog bench: cycles per printf line: uart %lu, ring %lu\r\n", uart, ring);
+    shmlog_report();
+}
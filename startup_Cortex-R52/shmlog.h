@@ -0,0 +1,137 @@
+#ifndef SHMLOG_H
+#define SHMLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memmap.h" // SHMLOG_BASE, in the RTPS carve-out of HPPS DRAM
+
+// Console log ring in HPPS DRAM, read by HPPS Linux through /dev/mem
+// (tools/shmlogcat.c) while RTPS keeps writing: printf output at memory speed
+// instead of UART speed, collected without a UART capture.
+//
+// Layout at SHMLOG_BASE, the same physical address for RTPS and HPPS (RTPS
+// has an MPU, not an MMU: identity-mapped, no translation on RTPS), all
+// fields little-endian:
+//
+//     magic   u32     SHMLOG_MAGIC once initialized
+//     size    u32     bytes of text, a power of 2
+//     write   u32     bytes written in total, mod 2^32: the next byte goes
+//                     to text[write % size]
+//     wraps   u32     times the write position went back to text[0]
+//     ...             padding to SHMLOG_READER_OFFSET (the next cache line)
+//     read    u32     position of the reader that follows the ring
+//                     (shmlogcat -f), written by it, for shmlog_report()
+//     ...             padding to SHMLOG_HDR_SIZE
+//     text    size bytes, not terminated
+//
+// One writer, the RTPS printf (under uart_lock), no lock with the readers:
+// the writer stores up to SHMLOG_MAX_WRITE bytes of text, then publishes
+// them by advancing write. A reader copies from its own position up to
+// write and re-reads write after the copy: text that the writer may have
+// overwritten meanwhile is counted as lost, not returned.
+//
+// On RTPS the ring is MPU region MPU_REGION_SHMLOG (mpu.c), covering
+// [SHMLOG_BASE, SHMLOG_END): Normal, write-back read/write-allocate,
+// non-shareable, read/write, execute-never. The writer hands the text it
+// stored, then its header line, to HPPS with shbuf_release() (cache.h,
+// cleaned and invalidated) before the new write is visible, and reads the
+// reader's line after shbuf_acquire() (invalidated). Readers map the ring
+// non-cacheable (/dev/mem with O_SYNC).
+//
+// This header is shared with the host reader in tools/shmlogcat.c.
+
+#define SHMLOG_MAGIC        0x474f4c52 // "RLOG"
+#define SHMLOG_READER_OFFSET 64        // the reader's cache line
+#define SHMLOG_HDR_SIZE     128        // the writer's and the reader's lines
+#define SHMLOG_SIZE         (64 * 1024)
+#define SHMLOG_MAX_WRITE    64         // bytes stored per advance of write
+
+struct shmlog {
+    uint32_t magic;
+    uint32_t size;
+    volatile uint32_t write;
+    volatile uint32_t wraps;
+    uint8_t pad[SHMLOG_READER_OFFSET - 16];
+    volatile uint32_t read;
+    uint8_t pad_read[SHMLOG_HDR_SIZE - SHMLOG_READER_OFFSET - 4];
+    char text[];
+};
+
+// The writer stores at most SHMLOG_MAX_WRITE bytes before it advances
+// write, so the SHMLOG_MAX_WRITE bytes after write - size may be being
+// overwritten: readers see the size - SHMLOG_MAX_WRITE bytes before write.
+static inline uint32_t shmlog_window(const struct shmlog *log)
+{
+    return log->size - SHMLOG_MAX_WRITE;
+}
+
+// Position of the oldest text in the ring
+static inline uint32_t shmlog_oldest(const struct shmlog *log)
+{
+    uint32_t write = log->write;
+
+    return log->wraps || write > shmlog_window(log) ? write - shmlog_window(log) : 0;
+}
+
+// Reads the text after *pos, up to len bytes, into buf and advances *pos.
+// Returns the bytes read; *lost gets the bytes skipped because the writer
+// overwrote them before they were read.
+static inline size_t shmlog_read(const struct shmlog *log, uint32_t *pos,
+                                 char *buf, size_t len, uint32_t *lost)
+{
+    uint32_t size = log->size, window = shmlog_window(log), write, gone;
+    size_t n, i;
+
+    write = log->write;
+    __sync_synchronize(); // the text up to write, after write
+    *lost = 0;
+    if (write - *pos > window) {
+        *lost = write - window - *pos;
+        *pos = write - window;
+    }
+    n = write - *pos;
+    if (n > len)
+        n = len;
+    for (i = 0; i < n; ++i)
+        buf[i] = log->text[(*pos + i) & (size - 1)];
+    __sync_synchronize();
+
+    // The writer may have gone on over the start of the copy meanwhile
+    gone = log->write - window - *pos;
+    if ((int32_t)gone > 0) {
+        if (gone > n)
+            gone = n;
+        for (i = gone; i < n; ++i)
+            buf[i - gone] = buf[i];
+        n -= gone;
+        *lost += gone;
+        *pos += gone;
+    }
+    *pos += n;
+    return n;
+}
+
+#ifndef SHMLOG_HOST
+
+#define SHMLOG_CONSOLE_UART (1 << 0)
+#define SHMLOG_CONSOLE_RING (1 << 1)
+
+// Where printf output goes, SHMLOG_CONSOLE_* bits, the UART at reset
+extern unsigned shmlog_console;
+
+// Initializes the ring, empty, at SHMLOG_BASE
+void shmlog_init(void);
+// Appends text to the ring: callers serialize, as printf does with uart_lock
+void shmlog_write(const char *buf, size_t len);
+// The ring, for a reader on this side (shmlog_read())
+const struct shmlog *shmlog_ring(void);
+// Position of the reader that follows the ring, as it last wrote it
+uint32_t shmlog_reader(void);
+void shmlog_report(void);
+// Cycles per printf line to the UART and to the ring
+void shmlog_bench(void);
+
+#endif // SHMLOG_HOST
+
+#endif // SHMLOG_H
@@ -0,0 +1,144 @@
+#ifndef SORTGEN_H
+#define SORTGEN_H
+
+#include <stddef.h>
+
+// Sorts specialized per element type and comparator, generated by
+// SORT_DEFINE(name, type, lt): the comparator is expanded in place, no
+// indirect call per comparison as with qsort(). lt(a, b) is an expression
+// on two elements (lvalues of type), true if a sorts before b. Generates:
+//
+//     void name_insertion(type *a, size_t n)
+//         Stable, for small or nearly sorted arrays.
+//     void name_introsort(type *a, size_t n)
+//         Quicksort (median of three, Hoare partition) that switches to
+//         heapsort past 2*log2(n) levels, so O(n log n) worst case; small
+//         partitions are left to insertion sort. Not stable. Recursion
+//         depth is bounded by log2(n): the smaller side is recursed into.
+//     void name_mergesort(type *a, size_t n, type *scratch)
+//         Stable, O(n log n); scratch holds n / 2 elements, supplied by
+//         the caller so that nothing is allocated.
+//     void name_heapsort(type *a, size_t n)
+//
+// All are static, instantiate in the .c that uses them.
+
+#define SORT_SMALL 16 // partitions and runs up to this size go to insertion sort
+
+#define SORT_UNUSED __attribute__((unused))
+
+#define SORT_SWAP(type, x, y) \
+    do { type t_ = (x); (x) = (y); (y) = t_; } while (0)
+
+#define SORT_DEFINE(name, type, lt) \
+static SORT_UNUSED void name##_insertion(type *a, size_t n) \
+{ \
+    size_t i, j; \
+    type v; \
+    for (i = 1; i < n; ++i) { \
+        v = a[i]; \
+        for (j = i; j > 0 && lt(v, a[j - 1]); --j) \
+            a[j] = a[j - 1]; \
+        a[j] = v; \
+    } \
+} \
+\
+static SORT_UNUSED void name##_sift(type *a, size_t root, size_t n) \
+{ \
+    size_t child; \
+    type v = a[root]; \
+    while ((child = 2 * root + 1) < n) { \
+        if (child + 1 < n && lt(a[child], a[child + 1])) \
+            child++; \
+        if (!lt(v, a[child])) \
+            break; \
+        a[root] = a[child]; \
+        root = child; \
+    } \
+    a[root] = v; \
+} \
+\
+static SORT_UNUSED void name##_heapsort(type *a, size_t n) \
+{ \
+    size_t i; \
+    if (n < 2) \
+        return; \
+    for (i = n / 2; i-- > 0; ) \
+        name##_sift(a, i, n); \
+    for (i = n - 1; i > 0; --i) { \
+        SORT_SWAP(type, a[0], a[i]); \
+        name##_sift(a, 0, i); \
+    } \
+} \
+\
+static SORT_UNUSED void name##_introsort_r(type *a, size_t n, unsigned depth) \
+{ \
+    size_t i, j, mid; \
+    type p; \
+    while (n > SORT_SMALL) { \
+        if (depth-- == 0) { \
+            name##_heapsort(a, n); \
+            return; \
+        } \
+        /* Median of three, which also bounds the scans below */ \
+        mid = (n - 1) / 2; \
+        if (lt(a[mid], a[0])) \
+            SORT_SWAP(type, a[mid], a[0]); \
+        if (lt(a[n - 1], a[mid])) { \
+            SORT_SWAP(type, a[n - 1], a[mid]); \
+            if (lt(a[mid], a[0])) \
+                SORT_SWAP(type, a[mid], a[0]); \
+        } \
+        p = a[mid]; \
+        for (i = 0, j = n - 1; ; ++i, --j) { \
+            while (lt(a[i], p)) \
+                ++i; \
+            while (lt(p, a[j])) \
+                --j; \
+            if (i >= j) \
+                break; \
+            SORT_SWAP(type, a[i], a[j]); \
+        } \
+        /* [0, j] and [j + 1, n): recurse into the smaller */ \
+        if (j + 1 < n - j - 1) { \
+            name##_introsort_r(a, j + 1, depth); \
+            a += j + 1; \
+            n -= j + 1; \
+        } else { \
+            name##_introsort_r(a + j + 1, n - j - 1, depth); \
+            n = j + 1; \
+        } \
+    } \
+    name##_insertion(a, n); \
+} \
+\
+static SORT_UNUSED void name##_introsort(type *a, size_t n) \
+{ \
+    unsigned depth = 0; \
+    size_t m; \
+    for (m = n; m > 1; m >>= 1) \
+        depth += 2; \
+    name##_introsort_r(a, n, depth); \
+} \
+\
+static SORT_UNUSED void name##_mergesort(type *a, size_t n, type *scratch) \
+{ \
+    size_t mid, i, j, k; \
+    if (n <= SORT_SMALL) { \
+        name##_insertion(a, n); \
+        return; \
+    } \
+    mid = n / 2; \
+    name##_mergesort(a, mid, scratch); \
+    name##_mergesort(a + mid, n - mid, scratch); \
+    if (!lt(a[mid], a[mid - 1])) \
+        return; /* halves already in order */ \
+    for (i = 0; i < mid; ++i) \
+        scratch[i] = a[i]; \
+    /* Ties go to the left half: stable. k < j, a[j...] is not overwritten */ \
+    for (i = 0, j = mid, k = 0; i < mid && j < n; ) \
+        a[k++] = lt(a[j], scratch[i]) ? a[j++] : scratch[i++]; \
+    while (i < mid) \
+        a[k++] = scratch[i++]; \
+}
+
+#endif // SORTGEN_H
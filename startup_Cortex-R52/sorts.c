@@ -10,6 +10,11 @@
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#include "pmu.h"
+#include "bench.h"
+#include "sortgen.h"
 
 #define N               1000
 
@@ -22,8 +27,54 @@
 
 static char buffer[N*(LOG10_N+1)];
 
+/* Typed keys for the specialized sorts (sortgen.h) against qsort() */
+#define TYPED_N         256
+
+struct fixstr {
+    char s[LOG10_N+2];  /* N_FORMAT, zero padded */
+};
+
+struct rec {
+    uint32_t key;
+    uint32_t seq;       /* input order, to check stability */
+};
+
+static inline int fixstr_cmp(const struct fixstr *a, const struct fixstr *b)
+{
+    int i;
+
+    for (i = 0; i < (int)sizeof(a->s); i++)
+        if (a->s[i] != b->s[i])
+            return (unsigned char)a->s[i] - (unsigned char)b->s[i];
+    return 0;
+}
+
+#define STR_LT(a, b)    (strcmp((a), (b)) < 0)
+#define U32_LT(a, b)    ((a) < (b))
+#define FIXSTR_LT(a, b) (fixstr_cmp(&(a), &(b)) < 0)
+#define REC_LT(a, b)    ((a).key < (b).key)
+
+SORT_DEFINE(sort_str, char *, STR_LT)
+SORT_DEFINE(sort_u32, uint32_t, U32_LT)
+SORT_DEFINE(sort_fixstr, struct fixstr, FIXSTR_LT)
+SORT_DEFINE(sort_rec, struct rec, REC_LT)
+
+/* Merge sort scratch and the typed arrays, one phase at a time */
+static union {
+    char *strings[N/2];
+    struct {
+        uint32_t src[TYPED_N], work[TYPED_N], scratch[TYPED_N/2];
+    } u32;
+    struct {
+        struct fixstr src[TYPED_N], work[TYPED_N];
+    } fixstr;
+    struct {
+        struct rec src[TYPED_N], work[TYPED_N], scratch[TYPED_N/2];
+    } rec;
+} work;
+
 clock_t clock() {
-    return 0; // NOT IMPLEMENTED
+    return pmu_cycles();
 }
 
 #if N <= 10000
@@ -53,15 +104,14 @@ static void shell_sort(char *strings[], int n)
     int h, i, j;
     char *v;
 
-    strings--;        /* Make array 1 origin */
     h = 1;
     do {h = h * 3 + 1;} while (h <= n);
     do {
         h = h / 3;
-        for (i = h + 1; i <= n; i++) {
+        for (i = h; i < n; i++) {
             v = strings[i];
             j = i;
-            while (j > h && strcmp(strings[j-h], v) > 0) {
+            while (j >= h && strcmp(strings[j-h], v) > 0) {
                 strings[j] = strings[j-h];
                 j = j-h;
             }
@@ -103,14 +153,43 @@ int qs_string_compare(const void *a, const void *b)
     return strcmp(*(char **)a, *(char **)b);
 }
 
-void compare_sorts(void)
+static int qs_u32_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int qs_fixstr_compare(const void *a, const void *b)
+{
+    return fixstr_cmp(a, b);
+}
+
+static int qs_rec_compare(const void *a, const void *b)
+{
+    uint32_t x = ((const struct rec *)a)->key, y = ((const struct rec *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *sort_type, const char *bench, unsigned long ticks)
+{
+    printf("%s sort took %lu clock ticks\r\n", sort_type, ticks);
+#ifdef BENCH
+    bench_result(bench, ticks);
+#else
+    (void)bench;
+#endif
+}
+
+/* Sort strings stored in the given buffer, returns total clock ticks */
+unsigned long compare_sorts_in(char *buf)
 {
     char *strings[N], *strings_copy[N];
     char *p;
     clock_t starttime, endtime;
+    unsigned long total = 0;
     int i;
 
-    p = buffer;
+    p = buf;
     for (i = 0; i < N; i++) {
         sprintf(p, N_FORMAT, i);
         strings[i] = p;
@@ -125,7 +204,8 @@ void compare_sorts(void)
     insert_sort(strings_copy, N);
     endtime = clock();
     check_order("Insertion", strings_copy, N);
-    printf("Insertion sort took %d clock ticks\r\n", endtime - starttime);
+    report("Insertion", "sort_insertion", endtime - starttime);
+    total += endtime - starttime;
 #else
     printf("Value of N too big to use insertion sort, must be <= 10000\r\n");
 #endif
@@ -136,7 +216,8 @@ void compare_sorts(void)
     shell_sort(strings_copy, N);
     endtime = clock();
     check_order("Shell", strings_copy, N);
-    printf("Shell sort took %d clock ticks\r\n", endtime - starttime);
+    report("Shell", "sort_shell", endtime - starttime);
+    total += endtime - starttime;
 
     /* Do quick sort - use built-in C library sort */
     memcpy(strings_copy, strings, sizeof(strings));
@@ -144,5 +225,141 @@ void compare_sorts(void)
     qsort(strings_copy, N, sizeof(char *), qs_string_compare);
     endtime = clock();
     check_order("Quick", strings_copy, N);
-    printf("Quick sort took %d clock ticks\r\n", endtime - starttime);
+    report("Quick", "sort_qsort", endtime - starttime);
+    total += endtime - starttime;
+
+    /* Do introsort and merge sort - specialized, strcmp called directly */
+    memcpy(strings_copy, strings, sizeof(strings));
+    starttime = clock();
+    sort_str_introsort(strings_copy, N);
+    endtime = clock();
+    check_order("Intro", strings_copy, N);
+    report("Intro", "sort_intro", endtime - starttime);
+    total += endtime - starttime;
+
+    memcpy(strings_copy, strings, sizeof(strings));
+    starttime = clock();
+    sort_str_mergesort(strings_copy, N, work.strings);
+    endtime = clock();
+    check_order("Merge", strings_copy, N);
+    report("Merge", "sort_merge", endtime - starttime);
+    total += endtime - starttime;
+
+    return total;
+}
+
+static void check_sorted(const char *sort_type, int sorted)
+{
+    if (!sorted) {
+        printf("%s sort failed - exiting\r\n", sort_type);
+        exit(1);
+    }
+}
+
+static int u32_sorted(const uint32_t *a, int n)
+{
+    int i;
+
+    for (i = 1; i < n; i++)
+        if (a[i] < a[i-1])
+            return 0;
+    return 1;
+}
+
+static int fixstr_sorted(const struct fixstr *a, int n)
+{
+    int i;
+
+    for (i = 1; i < n; i++)
+        if (fixstr_cmp(&a[i], &a[i-1]) < 0)
+            return 0;
+    return 1;
+}
+
+static int rec_sorted(const struct rec *a, int n, int stable)
+{
+    int i;
+
+    for (i = 1; i < n; i++) {
+        if (a[i].key < a[i-1].key)
+            return 0;
+        if (stable && a[i].key == a[i-1].key && a[i].seq < a[i-1].seq)
+            return 0;
+    }
+    return 1;
+}
+
+/* Integer, fixed-string and struct keys: qsort() against the sorts
+   specialized per type, which expand the comparison in place */
+static void compare_typed_sorts(void)
+{
+    clock_t starttime;
+    int i;
+
+    srand(2);
+    for (i = 0; i < TYPED_N; i++)
+        work.u32.src[i] = rand();
+
+    memcpy(work.u32.work, work.u32.src, sizeof(work.u32.src));
+    starttime = clock();
+    qsort(work.u32.work, TYPED_N, sizeof(uint32_t), qs_u32_compare);
+    report("u32 quick", "sort_u32_qsort", clock() - starttime);
+    check_sorted("u32 quick", u32_sorted(work.u32.work, TYPED_N));
+
+    memcpy(work.u32.work, work.u32.src, sizeof(work.u32.src));
+    starttime = clock();
+    sort_u32_introsort(work.u32.work, TYPED_N);
+    report("u32 intro", "sort_u32_intro", clock() - starttime);
+    check_sorted("u32 intro", u32_sorted(work.u32.work, TYPED_N));
+
+    memcpy(work.u32.work, work.u32.src, sizeof(work.u32.src));
+    starttime = clock();
+    sort_u32_mergesort(work.u32.work, TYPED_N, work.u32.scratch);
+    report("u32 merge", "sort_u32_merge", clock() - starttime);
+    check_sorted("u32 merge", u32_sorted(work.u32.work, TYPED_N));
+
+    for (i = 0; i < TYPED_N; i++)
+        sprintf(work.fixstr.src[i].s, N_FORMAT, rand() % N);
+
+    memcpy(work.fixstr.work, work.fixstr.src, sizeof(work.fixstr.src));
+    starttime = clock();
+    qsort(work.fixstr.work, TYPED_N, sizeof(struct fixstr), qs_fixstr_compare);
+    report("fixstr quick", "sort_fixstr_qsort", clock() - starttime);
+    check_sorted("fixstr quick", fixstr_sorted(work.fixstr.work, TYPED_N));
+
+    memcpy(work.fixstr.work, work.fixstr.src, sizeof(work.fixstr.src));
+    starttime = clock();
+    sort_fixstr_introsort(work.fixstr.work, TYPED_N);
+    report("fixstr intro", "sort_fixstr_intro", clock() - starttime);
+    check_sorted("fixstr intro", fixstr_sorted(work.fixstr.work, TYPED_N));
+
+    /* Few distinct keys, where stability shows */
+    for (i = 0; i < TYPED_N; i++) {
+        work.rec.src[i].key = rand() % 16;
+        work.rec.src[i].seq = i;
+    }
+
+    memcpy(work.rec.work, work.rec.src, sizeof(work.rec.src));
+    starttime = clock();
+    qsort(work.rec.work, TYPED_N, sizeof(struct rec), qs_rec_compare);
+    report("rec quick", "sort_rec_qsort", clock() - starttime);
+    check_sorted("rec quick", rec_sorted(work.rec.work, TYPED_N, 0));
+
+    memcpy(work.rec.work, work.rec.src, sizeof(work.rec.src));
+    starttime = clock();
+    sort_rec_introsort(work.rec.work, TYPED_N);
+    report("rec intro", "sort_rec_intro", clock() - starttime);
+    check_sorted("rec intro", rec_sorted(work.rec.work, TYPED_N, 0));
+
+    memcpy(work.rec.work, work.rec.src, sizeof(work.rec.src));
+    starttime = clock();
+    sort_rec_mergesort(work.rec.work, TYPED_N, work.rec.scratch);
+    report("rec merge (stable)", "sort_rec_merge", clock() - starttime);
+    check_sorted("rec merge (stable)", rec_sorted(work.rec.work, TYPED_N, 1));
+}
+
+void compare_sorts(void)
+{
+    compare_sorts_in(buffer);
+    compare_typed_sorts();
 }
@@ -0,0 +1,196 @@
+#include <stdint.h>
+
+#include "printf.h"
+#include "atomic.h"
+#include "intr.h"
+#include "pmu.h"
+#include "spinlock.h"
+
+#ifdef LOCK_STATS
+// Called with the lock held (for rwlock readers: concurrently, hence atomics)
+static inline void stats_acquired(struct lock_stats *st, uint32_t spins)
+{
+    atomic_fetch_add(&st->acquisitions, 1);
+    if (spins) {
+        atomic_fetch_add(&st->contended, 1);
+        atomic_fetch_add(&st->spins, spins);
+    }
+}
+
+static inline void stats_released(struct lock_stats *st, uint32_t acquired_at)
+{
+    uint32_t hold = pmu_cycles() - acquired_at;
+    if (hold > st->max_hold)
+        st->max_hold = hold;
+}
+#endif // LOCK_STATS
+
+void spin_lock(struct spinlock *lock)
+{
+    uint32_t ticket = atomic_fetch_add(&lock->next, 1);
+    uint32_t spins = 0;
+
+    while (lock->owner != ticket) {
+        wfe();
+        spins++;
+    }
+    dmb(); // critical section accesses after the acquisition
+
+#ifdef LOCK_STATS
+    stats_acquired(&lock->stats, spins);
+    lock->acquired_at = pmu_cycles();
+#else
+    (void)spins;
+#endif
+}
+
+int spin_trylock(struct spinlock *lock)
+{
+    uint32_t owner = lock->owner;
+
+    if (!atomic_cas(&lock->next, owner, owner + 1))
+        return 1;
+    dmb();
+
+#ifdef LOCK_STATS
+    stats_acquired(&lock->stats, 0);
+    lock->acquired_at = pmu_cycles();
+#endif
+    return 0;
+}
+
+void spin_unlock(struct spinlock *lock)
+{
+#ifdef LOCK_STATS
+    stats_released(&lock->stats, lock->acquired_at);
+#endif
+    dmb(); // critical section accesses before the release
+    lock->owner++;
+    dsb(); // the release must be visible before the waiters wake up
+    sev();
+}
+
+uint32_t spin_lock_irqsave(struct spinlock *lock)
+{
+    uint32_t flags = intr_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(struct spinlock *lock, uint32_t flags)
+{
+    spin_unlock(lock);
+    intr_restore(flags);
+}
+
+void read_lock(struct rwlock *lock)
+{
+    uint32_t count, spins = 0;
+
+    while (1) {
+        count = lock->count;
+        if (!(count & RWLOCK_WRITER) && atomic_cas(&lock->count, count, count + 1))
+            break;
+        if (count & RWLOCK_WRITER)
+            wfe();
+        spins++;
+    }
+    dmb();
+
+#ifdef LOCK_STATS
+    stats_acquired(&lock->stats, spins);
+#else
+    (void)spins;
+#endif
+}
+
+void read_unlock(struct rwlock *lock)
+{
+    dmb();
+    if (atomic_fetch_add(&lock->count, -1) == 1) { // last reader: a writer may be waiting
+        dsb();
+        sev();
+    }
+}
+
+// Note: writers can be starved by a continuous stream of readers
+void write_lock(struct rwlock *lock)
+{
+    uint32_t spins = 0;
+
+    while (!atomic_cas(&lock->count, 0, RWLOCK_WRITER)) {
+        wfe();
+        spins++;
+    }
+    dmb();
+
+#ifdef LOCK_STATS
+    stats_acquired(&lock->stats, spins);
+    lock->acquired_at = pmu_cycles();
+#else
+    (void)spins;
+#endif
+}
+
+void write_unlock(struct rwlock *lock)
+{
+#ifdef LOCK_STATS
+    stats_released(&lock->stats, lock->acquired_at);
+#endif
+    dmb();
+    lock->count = 0;
+    dsb();
+    sev();
+}
+
+uint32_t read_lock_irqsave(struct rwlock *lock)
+{
+    uint32_t flags = intr_save();
+    read_lock(lock);
+    return flags;
+}
+
+void read_unlock_irqrestore(struct rwlock *lock, uint32_t flags)
+{
+    read_unlock(lock);
+    intr_restore(flags);
+}
+
+uint32_t write_lock_irqsave(struct rwlock *lock)
+{
+    uint32_t flags = intr_save();
+    write_lock(lock);
+    return flags;
+}
+
+void write_unlock_irqrestore(struct rwlock *lock, uint32_t flags)
+{
+    write_unlock(lock);
+    intr_restore(flags);
+}
+
+#ifdef LOCK_STATS
+static void lock_stats_print(const char *name, const struct lock_stats *st)
+{
+    printf("lock %s: acquisitions %lu, contended %lu, spins %lu, max hold %lu cycles\r\n",
+           name, st->acquisitions, st->contended, st->spins, st->max_hold);
+}
+#endif // LOCK_STATS
+
+void spin_lock_report(const char *name, struct spinlock *lock)
+{
+#ifdef LOCK_STATS
+    lock_stats_print(name, &lock->stats);
+#else
+    (void)name; (void)lock;
+#endif
+}
+
+void rwlock_report(const char *name, struct rwlock *lock)
+{
+#ifdef LOCK_STATS
+    lock_stats_print(name, &lock->stats);
+#else
+    (void)name; (void)lock;
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+// Ticket spinlocks and reader-writer spinlocks. Waiters sleep in WFE and
+// are woken by the SEV on release. Locks taken both from ISRs and from
+// thread context must use the _irqsave variants, or an ISR that spins on a
+// lock held by the code it interrupted never returns.
+//
+// Build with -DLOCK_STATS to count acquisitions, contended acquisitions,
+// spins (WFE wakeups while waiting) and the maximum hold time in cycles.
+
+struct lock_stats {
+    uint32_t acquisitions;
+    uint32_t contended;
+    uint32_t spins;
+    uint32_t max_hold;
+};
+
+struct spinlock {
+    volatile uint32_t next;  // next ticket to hand out
+    volatile uint32_t owner; // ticket being served
+#ifdef LOCK_STATS
+    uint32_t acquired_at;
+    struct lock_stats stats;
+#endif
+};
+
+#define RWLOCK_WRITER 0x80000000 // in count: held by a writer, else number of readers
+
+struct rwlock {
+    volatile uint32_t count;
+#ifdef LOCK_STATS
+    uint32_t acquired_at; // by the writer
+    struct lock_stats stats;
+#endif
+};
+
+#define SPINLOCK_INIT { 0 }
+#define RWLOCK_INIT { 0 }
+
+void spin_lock(struct spinlock *lock);
+int spin_trylock(struct spinlock *lock); // returns 0 if acquired
+void spin_unlock(struct spinlock *lock);
+uint32_t spin_lock_irqsave(struct spinlock *lock);
+void spin_unlock_irqrestore(struct spinlock *lock, uint32_t flags);
+
+void read_lock(struct rwlock *lock);
+void read_unlock(struct rwlock *lock);
+void write_lock(struct rwlock *lock);
+void write_unlock(struct rwlock *lock);
+uint32_t read_lock_irqsave(struct rwlock *lock);
+void read_unlock_irqrestore(struct rwlock *lock, uint32_t flags);
+uint32_t write_lock_irqsave(struct rwlock *lock);
+void write_unlock_irqrestore(struct rwlock *lock, uint32_t flags);
+
+void spin_lock_report(const char *name, struct spinlock *lock);
+void rwlock_report(const char *name, struct rwlock *lock);
+
+#endif // SPINLOCK_H
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "stack.h"
+
+// Linker symbols (startup.ld)
+extern unsigned char __stack_start__, __stack_end__;
+
+struct stack_desc {
+    const char *name;
+    unsigned top; // below the top of the core's region
+    unsigned size;
+};
+
+static const struct stack_desc stacks[STACK_MODES] = {
+    [STACK_ABT] = { "ABT", STACK_ABT_TOP, STACK_ABT_SIZE },
+    [STACK_IRQ] = { "IRQ", STACK_IRQ_TOP, STACK_IRQ_SIZE },
+    [STACK_FIQ] = { "FIQ", STACK_FIQ_TOP, STACK_FIQ_SIZE },
+    [STACK_UND] = { "UND", STACK_UND_TOP, STACK_UND_SIZE },
+    [STACK_SVC] = { "SVC", STACK_SVC_TOP, STACK_SVC_SIZE },
+};
+
+static unsigned stack_clobbered; // canaries already reported
+
+static unsigned stack_core(void)
+{
+    uint32_t mpidr;
+    __asm__ __volatile__("mrc p15, 0, %0, c0, c0, 5" : "=r" (mpidr)); // MPIDR
+    return mpidr & (STACK_CORES - 1);
+}
+
+static uintptr_t stack_top(unsigned core, enum stack_mode mode)
+{
+    return ((uintptr_t)&__stack_end__ & ~7u) - core * STACK_CORE_SIZE - stacks[mode].top;
+}
+
+// Returns false if the stack overlaps the image, startup.s does not paint it
+static bool stack_painted(unsigned core, enum stack_mode mode)
+{
+    return stack_top(core, mode) - stacks[mode].size >= (uintptr_t)&__stack_start__;
+}
+
+unsigned stack_used(unsigned core, enum stack_mode mode)
+{
+    uintptr_t top;
+    const uint32_t *w;
+
+    if (core >= STACK_CORES || mode >= STACK_MODES || !stack_painted(core, mode))
+        return 0;
+    top = stack_top(core, mode);
+    w = (const uint32_t *)(top - stacks[mode].size);
+    if (*w++ != STACK_CANARY)
+        return stacks[mode].size;
+    while ((uintptr_t)w < top && *w == STACK_PAINT)
+        ++w;
+    return top - (uintptr_t)w;
+}
+
+unsigned stack_check(void)
+{
+    unsigned core = stack_core();
+    unsigned mode, clobbered = 0;
+
+    for (mode = 0; mode < STACK_MODES; ++mode) {
+        if (!stack_painted(core, mode))
+            continue;
+        if (*(const uint32_t *)(stack_top(core, mode) - stacks[mode].size) != STACK_CANARY)
+            clobbered |= 1 << mode;
+    }
+    for (mode = 0; mode < STACK_MODES; ++mode) {
+        if ((clobbered & ~stack_clobbered) & (1 << mode))
+            printf("ERROR: stack overflow: core %u %s (%u bytes)\r\n",
+                   core, stacks[mode].name, stacks[mode].size);
+    }
+    stack_clobbered |= clobbered;
+    return clobbered;
+}
+
+void stack_report(void)
+{
+    unsigned core, mode, used;
+
+    printf("stack: high-water marks, bytes used/size:\r\n");
+    for (core = 0; core < STACK_CORES; ++core) {
+        if (!stack_painted(core, STACK_ABT))
+            continue;
+        printf("  core %u:", core);
+        for (mode = 0; mode < STACK_MODES; ++mode) {
+            if (!stack_painted(core, mode)) {
+                printf(" %s -", stacks[mode].name);
+                continue;
+            }
+            used = stack_used(core, mode);
+            printf(" %s %u/%u%s", stacks[mode].name, used, stacks[mode].size,
+                   used == stacks[mode].size ? "!" : "");
+        }
+        printf("\r\n");
+    }
+}
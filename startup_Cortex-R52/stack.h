@@ -0,0 +1,56 @@
+#ifndef STACK_H
+#define STACK_H
+
+// Per-core exception mode stacks, carved by startup.s from the top of
+// TCM_A (__stack_end__, rounded down to 8 bytes) down: one STACK_CORE_SIZE region per core, in it
+// ABT, IRQ, FIQ, UND from the top and SVC (main) the rest. Sizes must
+// keep the stacks 8-byte aligned. Also included in asm.
+//
+// At reset each core paints its region with STACK_PAINT and puts
+// STACK_CANARY in the lowest word of each stack: stack_used() scans for
+// the high-water mark, stack_check() for a clobbered canary.
+
+#define STACK_CORES         4
+#define STACK_CORE_SHIFT    14
+#define STACK_CORE_SIZE     (1 << STACK_CORE_SHIFT)
+
+#define STACK_ABT_SIZE      512
+#define STACK_IRQ_SIZE      512
+#define STACK_FIQ_SIZE      512
+#define STACK_UND_SIZE      512
+
+// Offsets of the top of each stack below the top of the core's region
+#define STACK_ABT_TOP       0
+#define STACK_IRQ_TOP       (STACK_ABT_TOP + STACK_ABT_SIZE)
+#define STACK_FIQ_TOP       (STACK_IRQ_TOP + STACK_IRQ_SIZE)
+#define STACK_UND_TOP       (STACK_FIQ_TOP + STACK_FIQ_SIZE)
+#define STACK_SVC_TOP       (STACK_UND_TOP + STACK_UND_SIZE)
+#define STACK_SVC_SIZE      (STACK_CORE_SIZE - STACK_SVC_TOP)
+
+#define STACK_PAINT         0xcdcdcdcd
+#define STACK_CANARY        0x5ca1ab1e
+
+#ifndef __ASSEMBLER__
+
+enum stack_mode {
+    STACK_ABT,
+    STACK_IRQ,
+    STACK_FIQ,
+    STACK_UND,
+    STACK_SVC,
+    STACK_MODES
+};
+
+// High-water mark in bytes (the size if the canary is gone), 0 if the
+// stack was not painted (e.g. it overlaps the image)
+unsigned stack_used(unsigned core, enum stack_mode mode);
+
+// Checks the canaries of the current core, reports each clobbered one
+// once; returns the mask (1 << mode) of the clobbered ones
+unsigned stack_check(void);
+
+void stack_report(void);
+
+#endif // __ASSEMBLER__
+
+#endif // STACK_H
@@ -7,6 +7,9 @@
 // and your compliance with all applicable terms and conditions of such licence agreement.
 //----------------------------------------------------------------
 
+#include "boot.h"
+#include "stack.h"
+
 #define DK_GIC
 #ifdef DK_GIC
 #define GICD_BASE 0xF9A00000
@@ -73,11 +76,34 @@
 #define I_Bit 0x80 // when I bit is set, IRQ is disabled
 #define F_Bit 0x40 // when F bit is set, FIQ is disabled
 
+//----------------------------------------------------------------
+// Record a boot phase timestamp from the cycle counter (see boot.h)
+// Clobbers r0, r1
 //----------------------------------------------------------------
 
-/*    .section  VECTORS,"ax"
-    .align 3
-    .cfi_sections .debug_frame  // put stack frame info into .debug_frame instead of .eh_frame
+    .macro BOOT_MARK mark
+        MRC p15, 0, r1, c9, c13, 0      // Read PMCCNTR
+        LDR r0, =boot_ts
+        STR r1, [r0, #(\mark * 4)]
+    .endm
+
+// Stores r3 at \offset below the top of the CPU's stacks (r0), unless
+// that is below the painted region (r1)
+    .macro STACK_CANARY_AT offset
+        SUB r2, r0, #\offset
+        CMP r2, r1
+        BLO 1f
+        STR r3, [r2]
+1:
+    .endm
+
+//----------------------------------------------------------------
+
+// The EL2 vectors are at address 0, where the core starts from reset:
+// their section is placed first by startup.ld
+    .section .vectors, "ax", %progbits
+    .align 5
+/*    .cfi_sections .debug_frame  // put stack frame info into .debug_frame instead of .eh_frame
 */
 
 //----------------------------------------------------------------
@@ -114,6 +140,8 @@ EL2_HypModeEntry_Addr:  .word    EL2_HypModeEntry_Handler
 EL2_IRQ_Addr:           .word    EL2_IRQ_Handler
 EL2_FIQ_Addr:           .word    EL2_FIQ_Handler
 
+    .text
+
 
 //----------------------------------------------------------------
 // EL2 Exception Handlers
@@ -191,18 +219,36 @@ EL1_Reserved:
 EL1_IRQ_Handler:
         SUB lr, #4  // undo auto offset to get preferred ret address (ARMv8-A/R Reference, Table B1-7, IRQ/FIQ row)
         SRSDB sp!, #0b10010
-        PUSH {r0} // save, because we are going to use
-        MRC p15, 0, r0, c12, c12, 0 // r1 <- IRCC_IAR1 (INTID)	// coproc, #opcode1, Rt, CRn, CRm{, #opcode2}
+        // The caller-saved registers, which irq_handler may clobber: the
+        // interrupted code may be an event handler or coroutine in the
+        // middle of using them. 8 (SRS) + 20 + 4 (INTID) bytes: SP stays
+        // 8-byte aligned for the call.
+        PUSH {r0-r3, r12}
+        MRC p15, 0, r0, c12, c12, 0 // r0 <- ICC_IAR1 (INTID)	// coproc, #opcode1, Rt, CRn, CRm{, #opcode2}
         PUSH {r0} // save INTID before we modify it and before irq_handler clobbers it
         SUB r0, #32 /* convert INTID to IRQ # (as in Qemu device tree) TODO: does this offset have a name? */
         BL irq_handler // arg passed in r0 (IRQ #)
         POP {r0} // restore INTID
         MCR p15, 0, r0, c12, c12, 1 // ICC_EOIR1 <- r0 (INTID)	// coproc, #opcode1, Rt, CRn, CRm{, #opcode2}
-        POP {r0} // restore the registers we used
+        POP {r0-r3, r12} // restore the interrupted code's registers
         RFEIA sp!
+// Group 0 interrupts (gic_set_group0()), see fiq.h. FIQ mode banks r8-r12
+// and lr: the INTID and the return address stay in banked callee-saved
+// registers across the call, so only r0-r3 are saved (8-byte aligned) and
+// SPSR is not (FIQs are masked until the return).
 .type EL1_FIQ_Handler, "function"
 EL1_FIQ_Handler:
-        B   EL1_FIQ_Handler
+        PUSH {r0-r3} // the caller-saved registers that FIQ mode does not bank
+        MOV r10, lr // return address + 4, kept by the call (BL clobbers lr_fiq)
+        MRC p15, 0, r8, c12, c8, 0 // r8 <- ICC_IAR0 (INTID)
+        CMP r8, #1020 // 1020-1023: spurious, nothing to handle nor to EOI
+        BHS 1f
+        MOV r0, r8
+        BL fiq_handler // arg passed in r0 (INTID)
+        MCR p15, 0, r8, c12, c8, 1 // ICC_EOIR0 <- r8 (INTID)
+1:      POP {r0-r3}
+        MOV lr, r10
+        SUBS pc, lr, #4 // return, CPSR <- SPSR_fiq
 
 //----------------------------------------------------------------
 // EL2 Reset Handler
@@ -218,6 +264,23 @@ EL1_FIQ_Handler:
 .type EL2_Reset_Handler, "function"
 EL2_Reset_Handler:
 
+    // Start the cycle counter, for boot phase timing
+        MRC p15, 0, r0, c9, c12, 0      // Read PMCR
+        ORR r0, r0, #0x5                // Enable counters (E) and reset cycle counter (C)
+        MCR p15, 0, r0, c9, c12, 0      // Write PMCR
+        MOV r0, #0x80000000
+        MCR p15, 0, r0, c9, c12, 1      // Write PMCNTENSET: enable cycle counter
+        ISB
+
+    // Forget the boot markers left over from before a warm restart
+        LDR r0, =boot_ts
+        MVN r1, #0                      // BOOT_TS_NONE
+        MOV r2, #BOOT_MARKS
+1:      STR r1, [r0], #4
+        SUBS r2, r2, #1
+        BNE 1b
+        BOOT_MARK BOOT_MARK_RESET
+
     // Change EL2 exception base address
         LDR r0, =EL2_Vectors
         MCR p15, 4, r0, c12, c0, 0      //  Write to HVBAR
@@ -360,6 +423,7 @@ EL1_Reset_Handler:
         MCR p15, 0, r0, c1, c0, 0       // Write System Control Register
         ISB                             // Ensure subsequent insts execute wrt new MPU settings
 
+        BOOT_MARK BOOT_MARK_EL1
 
 //----------------------------------------------------------------
 // Cortex-R52 implementation-specific configuration
@@ -383,39 +447,69 @@ EL1_Reset_Handler:
 
 //----------------------------------------------------------------
 // Initialize Stacks using Linker symbol from scatter file.
-// ABT, IRQ, FIQ, UNDEF size = STACKSIZE, SVC the rest.
+// ABT, IRQ, FIQ, UND, then SVC the rest of this CPU's region, see stack.h.
 // Stacks must be 8 byte aligned.
 //----------------------------------------------------------------
 
-#define STACKSIZE 512
         //
         // Setup the stack(s) for this CPU
-        // the scatter file allocates 2^14 bytes per stack
+        // each CPU has STACK_CORE_SIZE bytes, down from __stack_end__
         //
         MRC  p15, 0, r1, c0, c0, 5      // Read CPU ID register
-        AND  r1, r1, #0x03              // Mask off, leaving the CPU ID field
+        AND  r1, r1, #(STACK_CORES - 1) // Mask off, leaving the CPU ID field
         LDR  r0, =__stack_end__
-        SUB  r0, r0, r1, lsl #14
+        BIC  r0, r0, #7                 // __stack_end__ is not 8 byte aligned
+        SUB  r0, r0, r1, lsl #STACK_CORE_SHIFT
+
+        // Paint the region for the high-water marks (stack_used()), and
+        // put a canary at the bottom of each stack (stack_check()). Only
+        // the part above the image: r1 = max(bottom, __stack_start__).
+        SUB  r1, r0, #STACK_CORE_SIZE
+        LDR  r3, =__stack_start__
+        CMP  r1, r3
+        BHS  1f
+        MOV  r1, r3
+1:      LDR  r3, =STACK_PAINT
+        MOV  r2, r0
+2:      CMP  r2, r1
+        BLS  3f
+        STR  r3, [r2, #-4]!
+        B    2b
+3:      LDR  r3, =STACK_CANARY
+        STACK_CANARY_AT (STACK_ABT_TOP + STACK_ABT_SIZE)
+        STACK_CANARY_AT (STACK_IRQ_TOP + STACK_IRQ_SIZE)
+        STACK_CANARY_AT (STACK_FIQ_TOP + STACK_FIQ_SIZE)
+        STACK_CANARY_AT (STACK_UND_TOP + STACK_UND_SIZE)
+        STACK_CANARY_AT STACK_CORE_SIZE
 
         CPS #Mode_ABT
-        MOV SP, r0
+        SUB r2, r0, #STACK_ABT_TOP
+        MOV SP, r2
 
         CPS #Mode_IRQ
-        SUB r0, r0, #STACKSIZE
-        MOV SP, r0
+        SUB r2, r0, #STACK_IRQ_TOP
+        MOV SP, r2
 
         CPS #Mode_FIQ
-        SUB r0, r0, #STACKSIZE
-        MOV SP, r0
+        SUB r2, r0, #STACK_FIQ_TOP
+        MOV SP, r2
+
+        CPS #Mode_UND
+        SUB r2, r0, #STACK_UND_TOP
+        MOV SP, r2
 
         CPS #Mode_SVC
-        SUB r0, r0, #STACKSIZE
-        MOV SP, r0
+        SUB r2, r0, #STACK_SVC_TOP
+        MOV SP, r2
 
 
 //----------------------------------------------------------------
 // Cache invalidation. However Cortex-R52 provides CFG signals to 
 // invalidate cache automatically out of reset (CFGL1CACHEINVDISx)
+//
+// With FAST_BOOT, the set/way walk is skipped: the platform must tie
+// CFGL1CACHEINVDISx low so that the caches are invalidated by hardware
+// on every reset (including the warm restart after a fault).
 //----------------------------------------------------------------
 
         DSB             // Complete all outstanding explicit memory operations
@@ -424,6 +518,7 @@ EL1_Reset_Handler:
 
         MCR p15, 0, r0, c7, c5, 0       // Invalidate entire instruction cache
 
+#ifndef FAST_BOOT
         // Invalidate Data/Unified Caches
 
         MRC     p15, 1, r0, c0, c0, 1      // Read CLIDR
@@ -468,8 +563,10 @@ Loop3:  ORR     r11, r10, r9, LSL r5       // Factor in the Way number and cache
 Skip:   ADD     r10, r10, #2               // Increment the cache number
         CMP     r3, r10
         BGT     Loop1
+#endif // !FAST_BOOT
 
 Finished:
+        BOOT_MARK BOOT_MARK_CACHE_INV
 
 //----------------------------------------------------------------
 // TCM Configuration
@@ -494,8 +591,9 @@ Finished:
 
         MRC p15, 0, r0, c9, c1, 1       // Read BTCM Region Register
         // r0 now contains BTCM size in bits [5:2]
-#DK        LDR r0, =Image$$BTCM$$Base      // Set BTCM base address
-	LDR r0, =0x00004014
+        AND r0, r0, #0x7c               // Keep the size (bits [6:2])
+        LDR r1, =__tcm_b_start__        // Set BTCM base address: TCM_B in startup.ld
+        ORR r0, r0, r1
         ORR r0, r0, #1                  // Enable it
         MCR p15, 0, r0, c9, c1, 1       // Write BTCM Region Register
 
@@ -509,135 +607,6 @@ Finished:
 #endif
 
 
-//----------------------------------------------------------------
-// MPU Configuration
-//----------------------------------------------------------------
-
-// Notes:
-// * Regions apply to both instruction and data accesses.
-// * Each region base address must be a multiple of its size
-// * Any address range not covered by an enabled region will abort
-// * The region at 0x0 over the Vector table is needed to support semihosting
-
-// Region 0: Code          Base = See scatter file  Limit = Based on usage   Normal  Non-shared  Read-only    Executable
-// Region 1: Data          Base = See scatter file  Limit = Based on usage   Normal  Non-shared  Full access  Not Executable
-// Region 2: Stack/Heap    Base = See scatter file  Limit = Based on usage   Normal  Non-shared  Full access  Not Executable
-// Region 3: Peripherals   Base = 0x9A000000        Limit = 0xAFFFFFC0       Device              Full access  Not Executable
-// Region 4: ATCM          Base = Configurable      Limit = Based on usage   Normal  Non-shared  Full access  Executable
-// Region 5: BTCM          Base = Configurable      Limit = Based on usage   Normal  Non-shared  Full access  Executable
-// Region 6: CTCM          Base = Configurable      Limit = Based on usage   Normal  Non-shared  Full access  Executable
-// DK: Region 7: Peripherals Base = 0x30000000      Limit = 0xFFFFFFFF	     Device              Full access  Executable
-
-        LDR     r0, =64
-        // Region 0 - Code
-        LDR     r1, =__text_start__
-        LDR     r2, =((Non_Shareable<<3) | (RO_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c8, 0                   // write PRBAR0
-        LDR     r1, =__text_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c8, 1                   // write PRLAR0
-
-        // Region 1 - Data
-        LDR     r1, =__data_start__
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c8, 4                   // write PRBAR1
-        LDR     r1, =__data_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c8, 5                   // write PRLAR1
-
-        // Region 2 - Stack-Heap
-        LDR     r1, =__stack_start__
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c9, 0                   // write PRBAR2
-        LDR     r1, =__stack_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c9, 1                   // write PRLAR2
-
-        // Region 3 - Peripherals
-        LDR     r1, =0x9A000000
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c9, 4                   // write PRBAR3
-        LDR     r1, =0xAFFFFFC0
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c9, 5                   // write PRLAR3
-
-#ifdef TCM
-#if 0 // Disabling this definition of ATCM, because the above .text, .data, and stack are in TCM A
-        // Region 4 - ATCM
-	LDR	r1, =__tcm_a_start__
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c10, 0                  // write PRBAR4
-	LDR	r1, =__tcm_a_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx1<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c10, 1                  // write PRLAR4
-#endif // ATCM
-
-        // Region 5 - BTCM
-	LDR	r1, =__tcm_b_start__
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c10, 4                  // write PRBAR5
-	LDR	r1, =__tcm_b_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c10, 5                  // write PRLAR5
-
-#if 0 // Disabling CTCM because not in device tree
-        // Region 6 - CTCM
-	LDR	r1, =__tcm_c_start__
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c11, 0                  // write PRBAR6
-	LDR	r1, =__tcm_c_end__
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c11, 1                  // write PRLAR6
-#endif // CTCM
-#endif // TCM
-
-        // Region 7 - Peripherals
-        LDR     r1, =0x30000000
-        LDR     r2, =((Non_Shareable<<3) | (RW_Access<<1))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c11, 4                   // write PRBAR7
-        LDR     r1, =0xFFFFFF00
-        ADD     r1, r1, #63
-        BFC     r1, #0, #6                              // align Limit to 64bytes
-        LDR     r2, =((AttrIndx0<<1) | (ENable))
-        ORR     r1, r1, r2
-        MCR     p15, 0, r1, c6, c11, 5                   // write PRLAR7
-
-    // MAIR0 configuration
-        MRC p15, 0, r0, c10, c2, 0      // Read MAIR0 into r0
-        LDR r1, =0xBB                   // Normal inner/outer RW cacheable, write-through
-        BFI r0, r1, #0, #8              // Update Attr0
-        LDR r1, =0x04                   // Device nGnRnE
-        BFI r0, r1, #8, #8              // Update Attr1
-        MCR p15,0,r0,c10,c2,0           // Write r0 to MAIR0
 #ifdef __ARM_FP
 //----------------------------------------------------------------
 // Enable access to VFP by enabling access to Coprocessors 10 and 11.
@@ -658,6 +627,17 @@ Finished:
 #endif
 
 
+//----------------------------------------------------------------
+// MPU Configuration
+//----------------------------------------------------------------
+
+// The regions and memory attributes (MAIR) are programmed from the
+// mpu_regions[] table in mpu.c, which can also be modified at runtime.
+// The stack and VFP are set up, so the C code can run (it must not use .bss).
+
+        BL      mpu_init
+
+
 #ifdef DK_GIC /* gotten from U-boot for GICV3 */
 /*	B ret_secure_percpu */
 	B	gic_init_secure
@@ -667,15 +647,22 @@ ret_secure_percpu:
 #endif
 //----------------------------------------------------------------
 // Enable MPU and branch to C library init
-// Leaving the caches disabled until after scatter loading.
+// Leaving the caches disabled until after scatter loading,
+// except with FAST_BOOT, where the image is already in place (TCM)
+// and the C runtime init (.bss zeroing) benefits from the caches.
 //----------------------------------------------------------------
 
         MRC     p15, 0, r0, c1, c0, 0       // Read System Control Register
         ORR     r0, r0, #0x01               // Set M bit to enable MPU
+#ifdef FAST_BOOT
+        ORR     r0, r0, #(0x1 << 12)        // enable I Cache
+        ORR     r0, r0, #(0x1 << 2)         // enable D Cache
+#endif
         DSB                                 // Ensure all previous loads/stores have completed
         MCR     p15, 0, r0, c1, c0, 0       // Write System Control Register
         ISB                                 // Ensure subsequent insts execute wrt new MPU settings
 			// DK: this ISB instruction causes exception.
+        BOOT_MARK BOOT_MARK_MPU
 
 //Check which CPU I am
         MRC p15, 0, r0, c0, c0, 5       // Read MPIDR
@@ -704,8 +691,25 @@ cpu0:
 #DK's test to switch from SVC mode to User mode. it works.
 # but it is disabled for now.
 #	MSR     CPSR_c, #0x10
-#DK's test to set up stack poointer
-        LDR     r13, =__stack_end__ - 0x2000 /* 0x200 (STACKSIZE) * 5 (ABT,IRQ,FIQ,UNDEF,SVC) = 0xA00, and per-CPU offset 0x1000 * cpuidx */
+
+    // Zero .bss, 32 bytes per store (bounds are 64-byte aligned, see startup.ld)
+        LDR     r0, =__bss_start__
+        LDR     r1, =__bss_end__
+        MOV     r2, #0
+        MOV     r3, #0
+        MOV     r4, #0
+        MOV     r5, #0
+        MOV     r6, #0
+        MOV     r7, #0
+        MOV     r8, #0
+        MOV     r9, #0
+        CMP     r0, r1
+        BHS     2f
+1:      STMIA   r0!, {r2-r9}
+        CMP     r0, r1
+        BLO     1b
+2:
+        BOOT_MARK BOOT_MARK_CRT
         B       main
 
 //    .size Reset_Handler, . - Reset_Handler	// Original
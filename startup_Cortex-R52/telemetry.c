@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "spinlock.h"
+#include "uart.h"
+#include "telemetry.h"
+
+static uint8_t tlm_seq;
+static uint32_t tlm_frames[TLM_STREAMS];
+static uint32_t tlm_bytes; // encoded bytes on the wire
+
+// Encodes len bytes of src into dst, which must hold len + len / 254 + 1
+// bytes. Returns the encoded length; the output contains no zero bytes.
+static size_t cobs_encode(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t code_idx = 0, out = 1, i;
+    uint8_t code = 1;
+
+    for (i = 0; i < len; ++i) {
+        if (src[i]) {
+            dst[out++] = src[i];
+            ++code;
+        }
+        if (!src[i] || code == 0xff) {
+            dst[code_idx] = code;
+            code = 1;
+            code_idx = out++;
+        }
+    }
+    dst[code_idx] = code;
+    return out;
+}
+
+int tlm_send(unsigned stream, const void *payload, size_t len)
+{
+    uint8_t frame[TLM_MAX_FRAME];
+    uint8_t enc[TLM_MAX_ENCODED];
+    uint16_t crc;
+    uint32_t ts, flags;
+    size_t n;
+
+    if (stream >= TLM_STREAMS || len > TLM_MAX_PAYLOAD) {
+        printf("ERROR: tlm_send: invalid stream %u or length %u\r\n",
+               stream, (unsigned)len);
+        return 1;
+    }
+
+    flags = uart_lock_room(TLM_MAX_ENCODED);
+
+    ts = pmu_cycles();
+    frame[0] = stream;
+    frame[1] = tlm_seq++;
+    frame[2] = ts;
+    frame[3] = ts >> 8;
+    frame[4] = ts >> 16;
+    frame[5] = ts >> 24;
+    for (n = 0; n < len; ++n)
+        frame[TLM_HDR_SIZE + n] = ((const uint8_t *)payload)[n];
+    n += TLM_HDR_SIZE;
+    crc = tlm_crc16(TLM_CRC_INIT, frame, n);
+    frame[n++] = crc;
+    frame[n++] = crc >> 8;
+
+    enc[0] = 0;
+    n = cobs_encode(enc + 1, frame, n) + 1;
+    enc[n++] = 0;
+    _putbuf((const char *)enc, n);
+
+    tlm_frames[stream]++;
+    tlm_bytes += n;
+    spin_unlock_irqrestore(&uart_lock, flags);
+    uart_drain();
+    return 0;
+}
+
+int tlm_log(const char *fmt, ...)
+{
+    char text[TLM_MAX_PAYLOAD + 1];
+    va_list va;
+    int len;
+
+    va_start(va, fmt);
+    len = vsnprintf(text, sizeof(text), fmt, va);
+    va_end(va);
+    if (len > TLM_MAX_PAYLOAD)
+        len = TLM_MAX_PAYLOAD; // truncated
+    return tlm_send(TLM_STREAM_LOG, text, len);
+}
+
+static int tlm_send_id_word(unsigned stream, uint16_t id, uint32_t word)
+{
+    uint8_t payload[6] = {
+        id, id >> 8, word, word >> 8, word >> 16, word >> 24,
+    };
+    return tlm_send(stream, payload, sizeof(payload));
+}
+
+int tlm_counter(uint16_t id, uint32_t value)
+{
+    return tlm_send_id_word(TLM_STREAM_COUNTER, id, value);
+}
+
+int tlm_trace(uint16_t id, uint32_t arg)
+{
+    return tlm_send_id_word(TLM_STREAM_TRACE, id, arg);
+}
+
+void tlm_report(void)
+{
+    printf("telemetry: frames: log %u counter %u trace %u, %u bytes\r\n",
+           tlm_frames[TLM_STREAM_LOG], tlm_frames[TLM_STREAM_COUNTER],
+           tlm_frames[TLM_STREAM_TRACE], tlm_bytes);
+}
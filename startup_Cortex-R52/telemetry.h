@@ -0,0 +1,64 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary telemetry over the UART, interleaved with the printf text.
+//
+// Each frame is COBS-encoded (no zero bytes inside) and delimited by a zero
+// byte on both sides, so that a decoder resynchronizes on the next frame
+// and text between frames can be passed through. Before encoding a frame is:
+//
+//     stream  u8       TLM_STREAM_*
+//     seq     u8       incremented per frame, gaps mean lost frames
+//     ts      u32      PMU cycle counter at the time of the send
+//     payload          up to TLM_MAX_PAYLOAD bytes, per stream below
+//     crc     u16      CRC-16/CCITT-FALSE of all of the above
+//
+// All multi-byte fields are little-endian. Payloads:
+//
+//     LOG      text, not terminated
+//     COUNTER  id u16, value u32
+//     TRACE    id u16, arg u32
+//
+// This header is shared with the host decoder in tools/tlmdecode.c.
+
+#define TLM_STREAM_LOG      0
+#define TLM_STREAM_COUNTER  1
+#define TLM_STREAM_TRACE    2
+#define TLM_STREAMS         3
+
+#define TLM_HDR_SIZE        6
+#define TLM_CRC_SIZE        2
+#define TLM_MAX_PAYLOAD     64
+#define TLM_MAX_FRAME       (TLM_HDR_SIZE + TLM_MAX_PAYLOAD + TLM_CRC_SIZE)
+// COBS adds one byte per 254 and the two delimiters
+#define TLM_MAX_ENCODED     (TLM_MAX_FRAME + TLM_MAX_FRAME / 254 + 1 + 2)
+
+#define TLM_CRC_INIT        0xffff
+
+// CRC-16/CCITT-FALSE (poly 0x1021), nibble table, continues from crc
+static inline uint16_t tlm_crc16(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    static const uint16_t tbl[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    };
+    while (len--) {
+        crc = (crc << 4) ^ tbl[(crc >> 12) ^ (*buf >> 4)];
+        crc = (crc << 4) ^ tbl[(crc >> 12) ^ (*buf & 0xf)];
+        buf++;
+    }
+    return crc;
+}
+
+#ifndef TLM_HOST
+int tlm_send(unsigned stream, const void *payload, size_t len);
+int tlm_log(const char *fmt, ...);
+int tlm_counter(uint16_t id, uint32_t value);
+int tlm_trace(uint16_t id, uint32_t arg);
+void tlm_report(void);
+#endif // TLM_HOST
+
+#endif // TELEMETRY_H
@@ -0,0 +1,124 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Generic timer: the system counter (CNTPCT) and the EL1 physical timer
+// (CNTP_*). The system counter keeps counting while the core sleeps in WFI,
+// unlike the PMU cycle counter (pmu.h); it ticks timer_freq() times per
+// second. The timer interrupt is a PPI, enabled with gic_enable_ppi().
+
+#define TIMER_PPI           30 // INTID of the EL1 physical timer
+
+#define CNTP_CTL_ENABLE     (1 << 0)
+#define CNTP_CTL_IMASK      (1 << 1)
+#define CNTP_CTL_ISTATUS    (1 << 2) // condition met (read-only)
+
+#define CNTKCTL_EVNTEN      (1 << 2) // event stream enable
+#define CNTKCTL_EVNTI_SHIFT 4        // event on a transition of counter bit EVNTI
+#define CNTKCTL_EVNTI_MASK  (0xf << CNTKCTL_EVNTI_SHIFT)
+
+#ifdef HOST
+#include <time.h>
+
+// Host build: nanoseconds stand in for ticks, the timer is modeled in
+// host/mmio_model.c (timer_model_poll() delivers its interrupt)
+extern uint32_t timer_model_ctl;
+extern uint64_t timer_model_cval;
+
+static inline uint64_t timer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint32_t timer_freq(void)
+{
+    return 1000000000;
+}
+
+static inline uint32_t timer_ctl(void)
+{
+    uint32_t ctl = timer_model_ctl;
+    if ((ctl & CNTP_CTL_ENABLE) && timer_now() >= timer_model_cval)
+        ctl |= CNTP_CTL_ISTATUS;
+    return ctl;
+}
+
+static inline uint64_t timer_cval(void)
+{
+    return timer_model_cval;
+}
+
+static inline void timer_arm(uint64_t cval)
+{
+    timer_model_cval = cval;
+    timer_model_ctl = CNTP_CTL_ENABLE;
+}
+
+static inline void timer_disarm(void)
+{
+    timer_model_ctl = 0;
+}
+
+#else // !HOST
+
+static inline uint64_t timer_now(void)
+{
+    uint64_t cnt;
+    __asm__ __volatile__("isb\n"
+                         "mrrc p15, 0, %Q0, %R0, c14" // CNTPCT
+                         : "=r" (cnt) : : "memory");
+    return cnt;
+}
+
+static inline uint32_t timer_freq(void)
+{
+    uint32_t freq;
+    __asm__ __volatile__("mrc p15, 0, %0, c14, c0, 0" : "=r" (freq)); // CNTFRQ
+    return freq;
+}
+
+static inline uint32_t timer_ctl(void)
+{
+    uint32_t ctl;
+    __asm__ __volatile__("mrc p15, 0, %0, c14, c2, 1" : "=r" (ctl)); // CNTP_CTL
+    return ctl;
+}
+
+static inline uint64_t timer_cval(void)
+{
+    uint64_t cval;
+    __asm__ __volatile__("mrrc p15, 2, %Q0, %R0, c14" : "=r" (cval)); // CNTP_CVAL
+    return cval;
+}
+
+// Fire when the system counter reaches cval
+static inline void timer_arm(uint64_t cval)
+{
+    __asm__ __volatile__("mcrr p15, 2, %Q0, %R0, c14" : : "r" (cval)); // CNTP_CVAL
+    __asm__ __volatile__("mcr p15, 0, %0, c14, c2, 1" : : "r" (CNTP_CTL_ENABLE)); // CNTP_CTL
+    __asm__ __volatile__("isb");
+}
+
+// Also deasserts the (level) interrupt
+static inline void timer_disarm(void)
+{
+    __asm__ __volatile__("mcr p15, 0, %0, c14, c2, 1" : : "r" (0)); // CNTP_CTL
+    __asm__ __volatile__("isb");
+}
+
+#endif // !HOST
+
+// Returns true, and the deadline, if the timer is armed with its interrupt unmasked
+static inline bool timer_deadline(uint64_t *cval)
+{
+    if ((timer_ctl() & (CNTP_CTL_ENABLE | CNTP_CTL_IMASK)) != CNTP_CTL_ENABLE)
+        return false;
+    *cval = timer_cval();
+    return true;
+}
+
+#endif // TIMER_H
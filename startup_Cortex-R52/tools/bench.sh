@@ -0,0 +1,121 @@
+#!/bin/sh
+#
+# Boot the benchmark image (make bench) in QEMU in deterministic -icount
+# mode, collect the BENCH lines from the UART and compare them against a
+# baseline. Exits non-zero on a regression or a missing benchmark.
+#
+#   tools/bench.sh [-b baseline] [-t percent] [-u] [image]
+#
+#   -b  baseline file, lines "<name> <value> [<threshold percent>]"
+#       (default: tools/bench_baseline.txt)
+#   -t  default threshold in percent (default: 2)
+#   -u  write the results as the new baseline instead of comparing
+#
+# Environment:
+#   QEMU         QEMU binary (default: qemu-system-aarch64)
+#   QEMU_ARGS    machine, serial and loader arguments for the HPSC model,
+#                with the RTPS UART on stdio and the image loaded on the
+#                RTPS core, e.g.
+#                  -M arm-generic-fdt -hw-dtb hpsc-arch.dtb -serial null
+#                  -serial stdio -device loader,file=$IMAGE,cpu-num=4
+#                ($IMAGE is substituted with the image path)
+#   ICOUNT       -icount shift (default: 0, one instruction per ns)
+#   TIMEOUT      seconds to wait for BENCH_DONE (default: 120)
+
+TOOLS_DIR=$(dirname "$0")
+BASELINE=$TOOLS_DIR/bench_baseline.txt
+THRESHOLD=2
+UPDATE=
+QEMU=${QEMU:-qemu-system-aarch64}
+ICOUNT=${ICOUNT:-0}
+TIMEOUT=${TIMEOUT:-120}
+
+while getopts b:t:u opt; do
+    case $opt in
+        b) BASELINE=$OPTARG ;;
+        t) THRESHOLD=$OPTARG ;;
+        u) UPDATE=1 ;;
+        *) sed -n '7,12p' "$0" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+IMAGE=${1:-startup_Cortex-R52_bench.axf}
+
+if [ -z "$QEMU_ARGS" ]; then
+    echo "bench.sh: set QEMU_ARGS for the HPSC machine (see the header)" >&2
+    exit 2
+fi
+if [ ! -f "$IMAGE" ]; then
+    echo "bench.sh: no image $IMAGE, build it with make bench" >&2
+    exit 2
+fi
+
+LOG=$(mktemp)
+RESULTS=$(mktemp)
+trap 'rm -f "$LOG" "$RESULTS"' EXIT
+
+ARGS=$(echo "$QEMU_ARGS" | sed "s|\$IMAGE|$IMAGE|g")
+# shellcheck disable=SC2086
+"$QEMU" $ARGS -icount shift="$ICOUNT",align=off,sleep=off -display none \
+    -monitor none > "$LOG" 2>&1 &
+PID=$!
+
+t=0
+while ! grep -q '^BENCH_DONE' "$LOG"; do
+    if ! kill -0 $PID 2>/dev/null; then
+        echo "bench.sh: QEMU exited before BENCH_DONE" >&2
+        break
+    fi
+    if [ $t -ge "$TIMEOUT" ]; then
+        echo "bench.sh: timeout after ${TIMEOUT}s" >&2
+        break
+    fi
+    sleep 1
+    t=$((t + 1))
+done
+kill $PID 2>/dev/null
+wait $PID 2>/dev/null
+
+tr -d '\r' < "$LOG" | awk '$1 == "BENCH" && NF == 3 { print $2, $3 }' > "$RESULTS"
+if [ ! -s "$RESULTS" ]; then
+    echo "bench.sh: no results, UART log:" >&2
+    cat "$LOG" >&2
+    exit 1
+fi
+
+if [ -n "$UPDATE" ]; then
+    cp "$RESULTS" "$BASELINE"
+    echo "bench.sh: baseline $BASELINE updated with $(wc -l < "$RESULTS") results"
+    exit 0
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "bench.sh: no baseline $BASELINE, create it with -u" >&2
+    cat "$RESULTS"
+    exit 1
+fi
+
+awk -v thr="$THRESHOLD" '
+    FNR == NR { base[$1] = $2; lim[$1] = NF > 2 ? $3 : thr; next }
+    {
+        seen[$1] = 1
+        if (!($1 in base)) {
+            printf "%-24s %10d %10s %8s  new\n", $1, $2, "-", "-"
+            next
+        }
+        d = base[$1] ? 100.0 * ($2 - base[$1]) / base[$1] : 0
+        if (d > lim[$1]) { st = "REGRESSION"; fail = 1 }
+        else if (d < -lim[$1]) st = "improved"
+        else st = "ok"
+        printf "%-24s %10d %10d %+7.1f%%  %s\n", $1, $2, base[$1], d, st
+    }
+    END {
+        for (n in base) if (!(n in seen)) {
+            printf "%-24s %10s %10d %8s  MISSING\n", n, "-", base[n], "-"
+            fail = 1
+        }
+        exit fail
+    }
+' "$BASELINE" "$RESULTS"
+STATUS=$?
+[ $STATUS -eq 0 ] && echo "bench.sh: no regressions" || echo "bench.sh: FAILED" >&2
+exit $STATUS
@@ -0,0 +1,165 @@
+/*
+ * Reader of the R52 console log ring in shared DRAM (see shmlog.h), run on
+ * HPPS Linux.
+ *
+ * Maps the ring through /dev/mem, non-cacheable (O_SYNC), and prints its
+ * text, or reads a copy of the ring from a file (e.g. a memory dump).
+ *
+ *   shmlogcat [-f] [-a addr] [image]
+ *
+ *   default: prints the text in the ring and exits
+ *   -f:      then follows the ring, printing new text as it is written, and
+ *            stores its position in the ring for the R52's report
+ *   -a:      physical address of the ring, default SHMLOG_BASE
+ *
+ * Text overwritten by the R52 before it was read is counted on stderr.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SHMLOG_HOST
+#include "../shmlog.h"
+
+#define POLL_US 10000
+
+static unsigned long lost_total;
+
+/* Writable with -f, for the reader position */
+static struct shmlog *map_ring(unsigned long addr, int follow)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    unsigned long base = addr & ~(page - 1);
+    int prot = follow ? PROT_READ | PROT_WRITE : PROT_READ;
+    struct shmlog *log;
+    uint8_t *p;
+    size_t len;
+    int fd;
+
+    fd = open("/dev/mem", (follow ? O_RDWR : O_RDONLY) | O_SYNC);
+    if (fd < 0) {
+        perror("/dev/mem");
+        return NULL;
+    }
+    /* The header first, for the size */
+    len = addr - base + SHMLOG_HDR_SIZE;
+    p = mmap(NULL, len, prot, MAP_SHARED, fd, base);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return NULL;
+    }
+    log = (struct shmlog *)(p + (addr - base));
+    if (log->magic != SHMLOG_MAGIC || !log->size || (log->size & (log->size - 1))) {
+        fprintf(stderr, "shmlogcat: no log ring at 0x%lx (magic 0x%08x)\n", addr, log->magic);
+        close(fd);
+        return NULL;
+    }
+    munmap(p, len);
+    len = addr - base + SHMLOG_HDR_SIZE + log->size;
+    p = mmap(NULL, len, prot, MAP_SHARED, fd, base);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    return (struct shmlog *)(p + (addr - base));
+}
+
+static const struct shmlog *load_ring(const char *path)
+{
+    const struct shmlog *log;
+    uint8_t *buf;
+    long len;
+    FILE *f;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    rewind(f);
+    buf = malloc(len > SHMLOG_HDR_SIZE ? len : SHMLOG_HDR_SIZE);
+    if (!buf || fread(buf, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "shmlogcat: %s: read failed\n", path);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    log = (const struct shmlog *)buf;
+    if (len < SHMLOG_HDR_SIZE || log->magic != SHMLOG_MAGIC || !log->size ||
+        (log->size & (log->size - 1)) || (unsigned long)len < SHMLOG_HDR_SIZE + log->size) {
+        fprintf(stderr, "shmlogcat: %s: not a log ring\n", path);
+        return NULL;
+    }
+    return log;
+}
+
+/* Prints the text up to the current write position, returns its length */
+static size_t drain(const struct shmlog *log, uint32_t *pos)
+{
+    static char buf[4096];
+    size_t n, total = 0;
+    uint32_t lost;
+
+    do {
+        n = shmlog_read(log, pos, buf, sizeof(buf), &lost);
+        if (lost) {
+            fflush(stdout);
+            fprintf(stderr, "[shmlogcat: %u bytes lost]\n", lost);
+            lost_total += lost;
+        }
+        fwrite(buf, 1, n, stdout);
+        total += n;
+    } while (n == sizeof(buf));
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long addr = SHMLOG_BASE;
+    struct shmlog *live = NULL;
+    const struct shmlog *log;
+    int follow = 0, i;
+    uint32_t pos;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        if (!strcmp(argv[i], "-f")) {
+            follow = 1;
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            addr = strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-f] [-a addr] [image]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (i < argc && follow) {
+        fprintf(stderr, "shmlogcat: -f needs the live ring, not an image\n");
+        return 1;
+    }
+    if (i < argc)
+        log = load_ring(argv[i]);
+    else
+        log = live = map_ring(addr, follow);
+    if (!log)
+        return 1;
+
+    pos = shmlog_oldest(log);
+    drain(log, &pos);
+    while (follow) {
+        live->read = pos;
+        fflush(stdout);
+        if (!drain(log, &pos))
+            usleep(POLL_US);
+    }
+
+    if (lost_total)
+        fprintf(stderr, "shmlogcat: %lu bytes lost\n", lost_total);
+    return 0;
+}
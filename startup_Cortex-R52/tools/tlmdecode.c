@@ -0,0 +1,170 @@
+/*
+ * Host decoder for the R52 telemetry frames (see telemetry.h).
+ *
+ * Reads a raw capture of the UART (file argument or stdin), decodes the
+ * COBS frames and checks their CRC. Text between frames (printf output)
+ * is passed through.
+ *
+ *   tlmdecode [-c] [capture]
+ *
+ *   default: one line per frame, "<cycles> <stream> ...", and the text
+ *   -c:      CSV "cycles,stream,seq,id,value,text" of the frames only
+ *
+ * Lost frames (sequence gaps) and bad frames are counted on stderr.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TLM_HOST
+#include "../telemetry.h"
+
+static const char *stream_names[TLM_STREAMS] = { "log", "counter", "trace" };
+
+static int csv;
+static int have_seq;
+static uint8_t last_seq;
+static unsigned long frames, bad, lost, text_bytes;
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/* Returns the decoded length, or 0 if the encoding is invalid */
+static size_t cobs_decode(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t in = 0, out = 0, i;
+
+    while (in < len) {
+        uint8_t code = src[in++];
+        if (!code || in + code - 1 > len)
+            return 0;
+        for (i = 1; i < code; ++i)
+            dst[out++] = src[in++];
+        if (code != 0xff && in < len)
+            dst[out++] = 0;
+    }
+    return out;
+}
+
+static void print_text(const uint8_t *buf, size_t len)
+{
+    text_bytes += len;
+    if (!csv)
+        fwrite(buf, 1, len, stdout);
+}
+
+static int decode_frame(const uint8_t *enc, size_t len)
+{
+    uint8_t frame[TLM_MAX_FRAME];
+    size_t n, plen;
+    unsigned stream;
+    uint8_t seq;
+    uint32_t ts;
+    const uint8_t *payload;
+
+    if (len > TLM_MAX_ENCODED)
+        return 1;
+    n = cobs_decode(frame, enc, len);
+    if (n < TLM_HDR_SIZE + TLM_CRC_SIZE || n > TLM_MAX_FRAME)
+        return 1;
+    plen = n - TLM_HDR_SIZE - TLM_CRC_SIZE;
+    if (tlm_crc16(TLM_CRC_INIT, frame, n - TLM_CRC_SIZE) != le16(frame + n - TLM_CRC_SIZE))
+        return 1;
+    stream = frame[0];
+    if (stream >= TLM_STREAMS)
+        return 1;
+
+    seq = frame[1];
+    if (have_seq && seq != (uint8_t)(last_seq + 1))
+        lost += (uint8_t)(seq - last_seq - 1);
+    have_seq = 1;
+    last_seq = seq;
+    ts = le32(frame + 2);
+    payload = frame + TLM_HDR_SIZE;
+    frames++;
+
+    if (stream == TLM_STREAM_LOG) {
+        if (csv) {
+            printf("%u,%s,%u,,,\"", ts, stream_names[stream], seq);
+            for (n = 0; n < plen; ++n) {
+                if (payload[n] == '"')
+                    putchar('"');
+                if (payload[n] != '\r' && payload[n] != '\n')
+                    putchar(payload[n]);
+            }
+            printf("\"\n");
+        } else {
+            printf("%10u log ", ts);
+            fwrite(payload, 1, plen, stdout);
+            if (!plen || payload[plen - 1] != '\n')
+                putchar('\n');
+        }
+    } else {
+        if (plen != 6)
+            return 1;
+        if (csv)
+            printf("%u,%s,%u,%u,%u,\n", ts, stream_names[stream], seq,
+                   le16(payload), le32(payload + 2));
+        else
+            printf("%10u %s %u = %u (0x%08x)\n", ts, stream_names[stream],
+                   le16(payload), le32(payload + 2), le32(payload + 2));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t chunk[1 << 16];
+    FILE *in = stdin;
+    size_t len = 0;
+    int c, i;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        if (!strcmp(argv[i], "-c")) {
+            csv = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-c] [capture]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (i < argc) {
+        in = fopen(argv[i], "rb");
+        if (!in) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    if (csv)
+        printf("cycles,stream,seq,id,value,text\n");
+
+    /* Zero bytes delimit frames; a chunk that does not decode is text */
+    while ((c = getc(in)) != EOF) {
+        if (c) {
+            if (len < sizeof(chunk))
+                chunk[len++] = c;
+            continue;
+        }
+        if (len && decode_frame(chunk, len)) {
+            /* Text, or a frame corrupted or cut by text */
+            if (len <= TLM_MAX_ENCODED && memchr(chunk, '\n', len) == NULL)
+                bad++;
+            print_text(chunk, len);
+        }
+        len = 0;
+    }
+    if (len)
+        print_text(chunk, len);
+
+    fprintf(stderr, "tlmdecode: %lu frames, %lu lost, %lu bad, %lu text bytes\n",
+            frames, lost, bad, text_bytes);
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Folded stacks from the R52 function trace (see trace.h), for flame graphs
+ * (flamegraph.pl, speedscope, ...).
+ *
+ * Reads the "TR" lines of a UART capture (file argument or stdin), other
+ * lines are skipped, and symbolizes the function addresses with the
+ * symbols of the image, listed with nm.
+ *
+ *   tracefold [-n nm] image.axf [capture]
+ *
+ *   -n:  nm to run, default arm-none-eabi-nm
+ *
+ * Prints "caller;...;function cycles" lines: the cycles between two events
+ * go to the stack that was current, so a function's own cycles exclude its
+ * callees'. The trace starts in the middle of the call stack: exits of
+ * functions entered before the trace started are dropped.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_EXIT      0x1 /* trace.h */
+
+#define MAX_DEPTH       256
+#define MAX_STACKS      (1 << 14) /* distinct stacks, power of 2 */
+#define MAX_LINE        4096
+
+struct sym {
+    uint32_t addr;
+    char *name;
+};
+
+struct folded {
+    char *stack;
+    unsigned long long cycles;
+};
+
+static struct sym *syms;
+static size_t nsyms;
+static struct folded stacks[MAX_STACKS];
+static size_t nstacks;
+
+static int sym_cmp(const void *a, const void *b)
+{
+    const struct sym *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+/* Function symbols of the image, by address */
+static int load_syms(const char *nm, const char *image)
+{
+    char cmd[MAX_LINE], line[MAX_LINE], name[MAX_LINE];
+    size_t cap = 0;
+    unsigned long addr;
+    char type;
+    FILE *p;
+
+    snprintf(cmd, sizeof(cmd), "%s %s", nm, image);
+    p = popen(cmd, "r");
+    if (!p) {
+        perror(nm);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), p)) {
+        if (sscanf(line, "%lx %c %4095s", &addr, &type, name) != 3)
+            continue;
+        if (type != 'T' && type != 't' && type != 'W' && type != 'w')
+            continue;
+        if (nsyms == cap) {
+            cap = cap ? 2 * cap : 1024;
+            syms = realloc(syms, cap * sizeof(*syms));
+            if (!syms) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        syms[nsyms].addr = addr & ~TRACE_EXIT; /* Thumb bit */
+        syms[nsyms].name = strdup(name);
+        nsyms++;
+    }
+    if (pclose(p) || !nsyms) {
+        fprintf(stderr, "%s: no symbols from %s\n", image, nm);
+        return 1;
+    }
+    qsort(syms, nsyms, sizeof(*syms), sym_cmp);
+    return 0;
+}
+
+static const char *sym_name(uint32_t addr)
+{
+    static char unknown[16];
+    size_t lo = 0, hi = nsyms;
+
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (syms[mid].addr <= addr)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if (syms[lo].addr == addr)
+        return syms[lo].name;
+    snprintf(unknown, sizeof(unknown), "0x%08x", addr);
+    return unknown;
+}
+
+static uint32_t hash(const char *s)
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+    while (*s)
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+static void add(const char *stack, uint32_t cycles)
+{
+    uint32_t i = hash(stack) & (MAX_STACKS - 1);
+
+    while (stacks[i].stack && strcmp(stacks[i].stack, stack))
+        i = (i + 1) & (MAX_STACKS - 1);
+    if (!stacks[i].stack) {
+        if (nstacks == MAX_STACKS - 1) {
+            fprintf(stderr, "too many distinct stacks\n");
+            exit(1);
+        }
+        stacks[i].stack = strdup(stack);
+        nstacks++;
+    }
+    stacks[i].cycles += cycles;
+}
+
+int main(int argc, char **argv)
+{
+    const char *nm = "arm-none-eabi-nm";
+    static uint32_t stack[MAX_DEPTH];
+    char line[MAX_LINE], folded[MAX_DEPTH * 64];
+    unsigned depth = 0, events = 0, dropped = 0, d;
+    uint32_t fn, ts, prev_ts = 0;
+    FILE *in = stdin;
+    char kind;
+    int i, started = 0;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            nm = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-n nm] image.axf [capture]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (i >= argc) {
+        fprintf(stderr, "usage: %s [-n nm] image.axf [capture]\n", argv[0]);
+        return 1;
+    }
+    if (load_syms(nm, argv[i++]))
+        return 1;
+    if (i < argc) {
+        in = fopen(argv[i], "r");
+        if (!in) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        if (!strncmp(line, "TR begin", 8)) {
+            depth = 0;
+            started = 0;
+            continue;
+        }
+        if (sscanf(line, "TR %c %x %x", &kind, &fn, &ts) != 3 || (kind != 'E' && kind != 'X'))
+            continue;
+        events++;
+
+        /* The cycles since the previous event belong to the current stack */
+        if (started && depth) {
+            size_t len = 0;
+            for (d = 0; d < depth && d < MAX_DEPTH && len < sizeof(folded) - 64; ++d)
+                len += snprintf(folded + len, sizeof(folded) - len, "%s%s",
+                                d ? ";" : "", sym_name(stack[d]));
+            add(folded, ts - prev_ts);
+        }
+        prev_ts = ts;
+        started = 1;
+
+        if (kind == 'E') {
+            if (depth < MAX_DEPTH)
+                stack[depth] = fn;
+            depth++;
+            continue;
+        }
+        /* Unwind to the function that exits, if we saw it enter */
+        for (d = depth; d > 0 && (d > MAX_DEPTH || stack[d - 1] != fn); --d)
+            ;
+        if (d)
+            depth = d - 1;
+        else
+            dropped++;
+    }
+
+    for (i = 0; i < MAX_STACKS; ++i)
+        if (stacks[i].stack)
+            printf("%s %llu\n", stacks[i].stack, stacks[i].cycles);
+    fprintf(stderr, "%u events, %zu stacks, %u exits without entry\n",
+            events, nstacks, dropped);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "printf.h"
+#include "pmu.h"
+#include "intr.h"
+#include "trace.h"
+
+// The hooks and everything they call must not be instrumented themselves:
+// see -finstrument-functions-exclude-file-list in the Makefile for the
+// inline helpers (pmu.h, intr.h)
+#define NO_TRACE __attribute__((no_instrument_function))
+
+#ifdef TRACE
+
+#define TRACE_STORAGE __attribute__((section(".tcm_b.trace"), aligned(8)))
+
+static struct trace_event trace_ring[TRACE_EVENTS] TRACE_STORAGE;
+
+// Must not be in .bss: mpu_init() is instrumented and runs before .bss is
+// zeroed (see startup.s)
+static volatile bool trace_on __attribute__((section(".data"))) = false;
+static uint32_t trace_head; // events recorded since trace_start()
+
+void __cyg_profile_func_enter(void *fn, void *call_site) NO_TRACE;
+void __cyg_profile_func_exit(void *fn, void *call_site) NO_TRACE;
+
+static inline void NO_TRACE trace_record(uint32_t fn)
+{
+    struct trace_event *ev;
+    uint32_t irq;
+
+    if (!trace_on)
+        return;
+    irq = intr_save();
+    ev = &trace_ring[trace_head++ & (TRACE_EVENTS - 1)];
+    ev->ts = pmu_cycles();
+    ev->fn = fn;
+    intr_restore(irq);
+}
+
+// The Thumb bit of the address is dropped, TRACE_EXIT takes its place
+void __cyg_profile_func_enter(void *fn, void *call_site)
+{
+    trace_record((uint32_t)(uintptr_t)fn & ~TRACE_EXIT);
+}
+
+void __cyg_profile_func_exit(void *fn, void *call_site)
+{
+    trace_record((uint32_t)(uintptr_t)fn | TRACE_EXIT);
+}
+
+void NO_TRACE trace_start(void)
+{
+    trace_on = false;
+    trace_head = 0;
+    trace_on = true;
+}
+
+void NO_TRACE trace_stop(void)
+{
+    trace_on = false;
+}
+
+unsigned NO_TRACE trace_count(void)
+{
+    return trace_head < TRACE_EVENTS ? trace_head : TRACE_EVENTS;
+}
+
+unsigned NO_TRACE trace_lost(void)
+{
+    return trace_head - trace_count();
+}
+
+unsigned NO_TRACE trace_read(unsigned index, struct trace_event *ev, unsigned n)
+{
+    unsigned count = trace_count();
+    uint32_t oldest = trace_head - count;
+    unsigned i;
+
+    for (i = 0; i < n && index + i < count; ++i)
+        ev[i] = trace_ring[(oldest + index + i) & (TRACE_EVENTS - 1)];
+    return i;
+}
+
+// Stops the trace, or the dump would trace itself
+void NO_TRACE trace_dump(void)
+{
+    unsigned count, i;
+    struct trace_event ev;
+
+    trace_stop();
+    count = trace_count();
+    printf("TR begin %u %u\r\n", count, trace_lost());
+    for (i = 0; i < count; ++i) {
+        trace_read(i, &ev, 1);
+        printf("TR %c %08x %08x\r\n", ev.fn & TRACE_EXIT ? 'X' : 'E',
+               ev.fn & ~TRACE_EXIT, ev.ts);
+    }
+    printf("TR end\r\n");
+}
+
+#else // !TRACE
+
+void trace_start(void)
+{
+}
+
+void trace_stop(void)
+{
+}
+
+unsigned trace_count(void)
+{
+    return 0;
+}
+
+unsigned trace_lost(void)
+{
+    return 0;
+}
+
+unsigned trace_read(unsigned index, struct trace_event *ev, unsigned n)
+{
+    (void)index; (void)ev; (void)n;
+    return 0;
+}
+
+void trace_dump(void)
+{
+    printf("trace: not built in, see make TRACE=1\r\n");
+}
+
+#endif // !TRACE
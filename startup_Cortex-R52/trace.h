@@ -0,0 +1,42 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Function entry/exit trace (make TRACE=1): the compiler instruments every
+// function (-finstrument-functions) and the hooks record an event with the
+// PMU cycle counter into a ring in TCM B, which keeps the latest
+// TRACE_EVENTS events. The ring is read out over the UART (trace_dump())
+// or the mailbox (CMD_TRACE, see msg_schema.h); tools/tracefold
+// symbolizes the dump against the image and emits folded stacks for
+// flame graphs. Without TRACE the functions are stubs, no ring.
+//
+// UART dump, one line each:
+//
+//     TR begin <events> <lost>
+//     TR <E|X> <function address, hex> <cycles, hex>
+//     TR end
+
+#define TRACE_EVENTS    2048 // power of 2, 8 bytes each
+#define TRACE_EXIT      0x1  // in trace_event.fn: function addresses are 2-byte aligned
+
+struct trace_event {
+    uint32_t ts;
+    uint32_t fn; // function address | TRACE_EXIT
+};
+
+// Clears the ring and starts recording
+void trace_start(void);
+void trace_stop(void);
+
+// Copies up to n events from index on, index 0 being the oldest in the
+// ring; returns the number copied. Meant for a stopped trace.
+unsigned trace_read(unsigned index, struct trace_event *ev, unsigned n);
+
+// Events in the ring, and events overwritten since trace_start()
+unsigned trace_count(void);
+unsigned trace_lost(void);
+
+void trace_dump(void);
+
+#endif // TRACE_H
@@ -1,4 +1,9 @@
 #include <stdint.h>
+#include <stddef.h>
+
+#include "mmio.h"
+#include "spinlock.h"
+#include "uart.h"
 
 #define BASEADDR 0x30001000
 
@@ -115,8 +120,21 @@
 #define CDNS_UART_BDIV_MAX	255
 #define CDNS_UART_CD_MAX	65535
 
-#define cdns_uart_readl(offset)		(*((volatile uint32_t *)BASEADDR + (offset/4)))
-#define cdns_uart_writel(val, offset)	do { *((volatile uint32_t *)BASEADDR + (offset/4)) = val; } while (0)
+#define cdns_uart_readl(offset)		mmio_read32((volatile uint32_t *)BASEADDR + (offset/4))
+#define cdns_uart_writel(val, offset)	mmio_write32((volatile uint32_t *)BASEADDR + (offset/4), val)
+
+#define CDNS_UART_TX_FIFO_SIZE	64
+
+/* TX ring in front of the FIFO, under uart_lock: a run of bytes is queued
+ * whole, so runs from different contexts do not interleave, while the lock
+ * is never held waiting for the UART. A power of 2, larger than the longest
+ * run (a printf chunk, a telemetry frame). */
+#define UART_TX_RING_SIZE	512
+
+struct spinlock uart_lock = SPINLOCK_INIT;
+
+static char uart_tx_ring[UART_TX_RING_SIZE];
+static volatile uint32_t uart_tx_head, uart_tx_tail; /* written, sent */
 
 /**
  * cdns_uart_startup - Called when an application opens a cdns_uart port
@@ -227,3 +245,61 @@ void _putchar(char c)
 
 	return;
 }
+
+/* Sends what fits from the TX ring: a burst of up to a FIFO-full once the
+ * FIFO is empty, nothing while it is not. Called with uart_lock held. */
+static void uart_tx_kick(void)
+{
+	uint32_t tail = uart_tx_tail;
+	unsigned n;
+
+	if (tail == uart_tx_head ||
+	    !(cdns_uart_readl(CDNS_UART_SR_OFFSET) & CDNS_UART_SR_TXEMPTY))
+		return;
+	for (n = 0; n < CDNS_UART_TX_FIFO_SIZE && tail != uart_tx_head; ++n, ++tail)
+		cdns_uart_writel(uart_tx_ring[tail & (UART_TX_RING_SIZE - 1)],
+				 CDNS_UART_FIFO_OFFSET);
+	uart_tx_tail = tail;
+}
+
+uint32_t uart_lock_room(size_t len)
+{
+	uint32_t flags;
+
+	for (;;) {
+		flags = spin_lock_irqsave(&uart_lock);
+		if (UART_TX_RING_SIZE - (uart_tx_head - uart_tx_tail) >= len)
+			return flags;
+		spin_unlock_irqrestore(&uart_lock, flags);
+		uart_drain();
+	}
+}
+
+/* Queue a run of characters and start sending it: no waiting, the caller
+ * got the room with uart_lock_room(). */
+void _putbuf(const char *buf, size_t len)
+{
+	uint32_t head = uart_tx_head;
+	size_t i;
+
+	for (i = 0; i < len; ++i, ++head)
+		uart_tx_ring[head & (UART_TX_RING_SIZE - 1)] = buf[i];
+	uart_tx_head = head;
+	uart_tx_kick();
+}
+
+/* Wait for the FIFO to empty without the lock, then refill it under the
+ * lock, until the ring is empty and the FIFO too, like _putchar. */
+void uart_drain(void)
+{
+	uint32_t flags;
+
+	for (;;) {
+		while (!(cdns_uart_readl(CDNS_UART_SR_OFFSET) & CDNS_UART_SR_TXEMPTY));
+		if (uart_tx_tail == uart_tx_head)
+			return;
+		flags = spin_lock_irqsave(&uart_lock);
+		uart_tx_kick();
+		spin_unlock_irqrestore(&uart_lock, flags);
+	}
+}
@@ -1,3 +1,8 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "spinlock.h"
+
 #define putc cdns_uart_poll_put_char
 #define puts cdns_uart_poll_puts
 
@@ -5,3 +10,19 @@ int cdns_uart_startup();
 void cdns_uart_poll_put_char(unsigned char c);
 void cdns_uart_poll_puts(const char *c);
 
+
+// TX of a run of bytes, whole, through a ring in front of the FIFO:
+//
+//     flags = uart_lock_room(len);   // uart_lock, room in the ring for len
+//     _putbuf(buf, len);             // queued, the FIFO filled if empty
+//     spin_unlock_irqrestore(&uart_lock, flags);
+//     uart_drain();                  // the rest, waiting without the lock
+//
+// uart_lock is held, IRQs masked, only to queue and to fill the FIFO: never
+// while waiting for the UART. len is at most the ring size (uart.c).
+uint32_t uart_lock_room(size_t len);
+void _putbuf(const char *buf, size_t len);
+void uart_drain(void);
+
+// Serializes the TX ring and the FIFO between cores and ISRs, see above
+extern struct spinlock uart_lock;